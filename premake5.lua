@@ -69,4 +69,48 @@ links { "glfw", "glad", "imgui", "imguizmo", "lua" }
 
 filter { "system:windows", "configurations:release" }
 kind "WindowedApp"
-defines "RVO_USE_WINMAIN"
\ No newline at end of file
+defines "RVO_USE_WINMAIN"
+
+filter {}
+
+project "rvo-cook"
+location "tools/cook"
+kind "ConsoleApp"
+
+-- Conversion code is shared with the game, everything listed here must stay free of gl
+files {
+    "%{prj.location}/**.cpp",
+    "%{wks.location}/source/rvo_utility.*",
+    "%{wks.location}/source/rvo_vfs.*",
+    "%{wks.location}/source/rvo_lua.*",
+    "%{wks.location}/source/rvo_pak.*",
+    "%{wks.location}/source/rvo_lz4.*",
+    "%{wks.location}/source/gfx/rvo_block_compression.*",
+    "%{wks.location}/source/gfx/rvo_ktx2.*",
+    "%{wks.location}/source/gfx/rvo_texture_cook.*",
+    "%{wks.location}/source/gfx/rvo_virtual_texture_cook.*",
+    "%{wks.location}/source/gfx/rvo_mesh_data.*",
+    "%{wks.location}/source/gfx/rvo_mesh_optimizer.*",
+    "%{wks.location}/source/gfx/rvo_mesh_cook.*",
+    "%{wks.location}/source/gfx/rvo_shader_cook.*",
+}
+
+includedirs {
+    "%{wks.location}/source",
+    "%{wks.location}/vendor/glm",
+    "%{wks.location}/vendor/spdlog/include",
+    "%{wks.location}/vendor/lua/src",
+}
+
+debugdir "%{wks.location}/working"
+
+links "lua"
+
+project "tests"
+location "tests"
+kind "ConsoleApp"
+
+-- Header only pieces of the game that can be checked without a window or gl context, run from the repository root
+files "%{prj.location}/**.cpp"
+
+includedirs "%{wks.location}/source"
\ No newline at end of file
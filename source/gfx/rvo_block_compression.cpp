@@ -0,0 +1,413 @@
+#include "rvo_block_compression.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace rvo {
+	namespace {
+		using Block = std::span<std::uint8_t const, 64>;
+
+		// BC7 4 bit index interpolation weights, out of 64
+		constexpr std::array<int, 16> kBc7Weights = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		glm::vec4 pixel(Block aPixels, int aIndex) {
+			return glm::vec4(aPixels[aIndex * 4 + 0], aPixels[aIndex * 4 + 1], aPixels[aIndex * 4 + 2], aPixels[aIndex * 4 + 3]);
+		}
+
+		float distance_squared(glm::vec4 aLeft, glm::vec4 aRight) {
+			glm::vec4 const delta = aLeft - aRight;
+			return glm::dot(delta, delta);
+		}
+
+		// Line through the block colors with the least squared distance, aChannels is 3 for rgb and 4 for rgba
+		// Returns the projected extremes as endpoints, both are the mean for flat blocks
+		std::pair<glm::vec4, glm::vec4> principal_endpoints(Block aPixels, int aChannels) {
+			glm::vec4 const mask = aChannels == 4 ? glm::vec4(1.0f) : glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+
+			glm::vec4 mean = glm::vec4(0.0f);
+			for (int i = 0; i < 16; ++i) mean += pixel(aPixels, i) * mask;
+			mean /= 16.0f;
+
+			glm::mat4 covariance = glm::mat4(0.0f);
+			for (int i = 0; i < 16; ++i) {
+				glm::vec4 const delta = (pixel(aPixels, i) - mean) * mask;
+				covariance += glm::outerProduct(delta, delta);
+			}
+
+			// Power iteration, seeded with the column of the channel with the most variance
+			int seed = 0;
+			for (int c = 1; c < aChannels; ++c) {
+				if (covariance[c][c] > covariance[seed][seed]) seed = c;
+			}
+
+			glm::vec4 axis = covariance[seed];
+			for (int i = 0; i < 8; ++i) {
+				axis = covariance * axis;
+				float const largest = glm::max(glm::max(glm::abs(axis.x), glm::abs(axis.y)), glm::max(glm::abs(axis.z), glm::abs(axis.w)));
+				if (largest < 1e-6f) return { mean, mean };
+				axis /= largest;
+			}
+
+			axis = glm::normalize(axis);
+
+			float low = std::numeric_limits<float>::max();
+			float high = std::numeric_limits<float>::lowest();
+			for (int i = 0; i < 16; ++i) {
+				float const t = glm::dot((pixel(aPixels, i) - mean) * mask, axis);
+				low = glm::min(low, t);
+				high = glm::max(high, t);
+			}
+
+			return { mean + axis * high, mean + axis * low };
+		}
+
+		// Least squares endpoints for fixed interpolation weights, aWeights[i] is how much of aFirst pixel i gets
+		// Returns false when the system is singular, ie. every pixel picked the same weight
+		bool solve_endpoints(Block aPixels, std::span<float const, 16> aWeights, glm::vec4& aFirst, glm::vec4& aSecond) {
+			float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+			glm::vec4 ax = glm::vec4(0.0f), bx = glm::vec4(0.0f);
+
+			for (int i = 0; i < 16; ++i) {
+				float const a = aWeights[i];
+				float const b = 1.0f - a;
+				aa += a * a;
+				ab += a * b;
+				bb += b * b;
+				ax += a * pixel(aPixels, i);
+				bx += b * pixel(aPixels, i);
+			}
+
+			float const determinant = aa * bb - ab * ab;
+			if (glm::abs(determinant) < 1e-6f) return false;
+
+			aFirst = glm::clamp((bb * ax - ab * bx) / determinant, 0.0f, 255.0f);
+			aSecond = glm::clamp((aa * bx - ab * ax) / determinant, 0.0f, 255.0f);
+			return true;
+		}
+
+		std::uint16_t pack_565(glm::vec4 aColor) {
+			glm::vec4 const clamped = glm::clamp(aColor, 0.0f, 255.0f);
+			auto const r = static_cast<std::uint16_t>(glm::round(clamped.r * 31.0f / 255.0f));
+			auto const g = static_cast<std::uint16_t>(glm::round(clamped.g * 63.0f / 255.0f));
+			auto const b = static_cast<std::uint16_t>(glm::round(clamped.b * 31.0f / 255.0f));
+			return static_cast<std::uint16_t>(r << 11 | g << 5 | b);
+		}
+
+		glm::vec4 unpack_565(std::uint16_t aColor) {
+			int const r = aColor >> 11 & 31;
+			int const g = aColor >> 5 & 63;
+			int const b = aColor & 31;
+			return glm::vec4(r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2, 0.0f);
+		}
+
+		struct ColorFit final {
+			std::uint16_t color0 = 0;
+			std::uint16_t color1 = 0;
+			std::uint32_t indices = 0;
+			float error = std::numeric_limits<float>::max();
+		};
+
+		// Always four color mode, BC3 ignores the endpoint order and BC1 would otherwise punch holes
+		ColorFit fit_color(Block aPixels, glm::vec4 aFirst, glm::vec4 aSecond) {
+			ColorFit fit;
+			fit.color0 = pack_565(aFirst);
+			fit.color1 = pack_565(aSecond);
+			if (fit.color0 < fit.color1) std::swap(fit.color0, fit.color1);
+
+			glm::vec4 const first = unpack_565(fit.color0);
+			glm::vec4 const second = unpack_565(fit.color1);
+			std::array<glm::vec4, 4> const palette = { first, second, (2.0f * first + second) / 3.0f, (first + 2.0f * second) / 3.0f };
+			int const paletteSize = fit.color0 == fit.color1 ? 1 : 4;
+
+			fit.error = 0.0f;
+			for (int i = 0; i < 16; ++i) {
+				glm::vec4 const color = pixel(aPixels, i) * glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+				int best = 0;
+				float bestError = distance_squared(color, palette[0]);
+
+				for (int p = 1; p < paletteSize; ++p) {
+					float const error = distance_squared(color, palette[p]);
+					if (error < bestError) {
+						best = p;
+						bestError = error;
+					}
+				}
+
+				fit.indices |= static_cast<std::uint32_t>(best) << (i * 2);
+				fit.error += bestError;
+			}
+
+			return fit;
+		}
+
+		void encode_color_block(Block aPixels, std::byte* aDestination) {
+			auto const [first, second] = principal_endpoints(aPixels, 3);
+			ColorFit fit = fit_color(aPixels, first, second);
+
+			// One least squares pass with the indices fixed usually recovers what the bounding line lost
+			std::array<float, 16> weights;
+			for (int i = 0; i < 16; ++i) {
+				constexpr std::array<float, 4> kWeights = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+				weights[i] = kWeights[fit.indices >> (i * 2) & 3];
+			}
+
+			glm::vec4 refinedFirst, refinedSecond;
+			if (solve_endpoints(aPixels, weights, refinedFirst, refinedSecond)) {
+				ColorFit const refined = fit_color(aPixels, refinedFirst, refinedSecond);
+				if (refined.error < fit.error) fit = refined;
+			}
+
+			std::memcpy(aDestination + 0, &fit.color0, 2);
+			std::memcpy(aDestination + 2, &fit.color1, 2);
+			std::memcpy(aDestination + 4, &fit.indices, 4);
+		}
+
+		// BC4 style, eight interpolated values between the extremes
+		void encode_alpha_block(Block aPixels, std::byte* aDestination) {
+			int low = 255, high = 0;
+			for (int i = 0; i < 16; ++i) {
+				low = glm::min<int>(low, aPixels[i * 4 + 3]);
+				high = glm::max<int>(high, aPixels[i * 4 + 3]);
+			}
+
+			std::array<int, 8> palette = { high, low };
+			for (int k = 1; k < 7; ++k) palette[k + 1] = ((7 - k) * high + k * low) / 7;
+
+			std::uint64_t bits = static_cast<std::uint64_t>(high) | static_cast<std::uint64_t>(low) << 8;
+
+			if (high != low) {
+				for (int i = 0; i < 16; ++i) {
+					int const alpha = aPixels[i * 4 + 3];
+					int best = 0;
+
+					for (int p = 1; p < 8; ++p) {
+						if (glm::abs(alpha - palette[p]) < glm::abs(alpha - palette[best])) best = p;
+					}
+
+					bits |= static_cast<std::uint64_t>(best) << (16 + i * 3);
+				}
+			}
+
+			std::memcpy(aDestination, &bits, 8);
+		}
+
+		// 7 bits per channel plus a shared low bit
+		struct Bc7Endpoint final {
+			std::array<int, 4> color;
+			int pbit;
+
+			glm::vec4 value() const { return glm::vec4(color[0], color[1], color[2], color[3]) * 2.0f + float(pbit); }
+		};
+
+		Bc7Endpoint quantize_bc7_endpoint(glm::vec4 aColor) {
+			Bc7Endpoint best;
+			float bestError = std::numeric_limits<float>::max();
+
+			for (int pbit = 0; pbit < 2; ++pbit) {
+				Bc7Endpoint candidate;
+				candidate.pbit = pbit;
+				for (int c = 0; c < 4; ++c) {
+					candidate.color[c] = static_cast<int>(glm::clamp(glm::round((aColor[c] - pbit) * 0.5f), 0.0f, 127.0f));
+				}
+
+				float const error = distance_squared(candidate.value(), aColor);
+				if (error < bestError) {
+					best = candidate;
+					bestError = error;
+				}
+			}
+
+			return best;
+		}
+
+		struct Bc7Fit final {
+			Bc7Endpoint first;
+			Bc7Endpoint second;
+			std::array<int, 16> indices;
+			float error = std::numeric_limits<float>::max();
+		};
+
+		Bc7Fit fit_bc7(Block aPixels, glm::vec4 aFirst, glm::vec4 aSecond) {
+			Bc7Fit fit;
+			fit.first = quantize_bc7_endpoint(aFirst);
+			fit.second = quantize_bc7_endpoint(aSecond);
+
+			std::array<glm::vec4, 16> palette;
+			for (int k = 0; k < 16; ++k) {
+				// Matches the decoder, ((64 - w) * e0 + w * e1 + 32) >> 6 per channel
+				glm::vec4 const mixed = (float(64 - kBc7Weights[k]) * fit.first.value() + float(kBc7Weights[k]) * fit.second.value() + 32.0f) / 64.0f;
+				palette[k] = glm::floor(mixed);
+			}
+
+			fit.error = 0.0f;
+			for (int i = 0; i < 16; ++i) {
+				glm::vec4 const color = pixel(aPixels, i);
+				int best = 0;
+				float bestError = distance_squared(color, palette[0]);
+
+				for (int k = 1; k < 16; ++k) {
+					float const error = distance_squared(color, palette[k]);
+					if (error < bestError) {
+						best = k;
+						bestError = error;
+					}
+				}
+
+				fit.indices[i] = best;
+				fit.error += bestError;
+			}
+
+			return fit;
+		}
+
+		class BitWriter final {
+		public:
+			explicit BitWriter(std::byte* aDestination) noexcept : mDestination(aDestination) {}
+
+			void write(std::uint32_t aValue, int aBits) noexcept {
+				for (int i = 0; i < aBits; ++i, ++mPosition) {
+					if (aValue >> i & 1) mDestination[mPosition / 8] |= std::byte(1 << (mPosition % 8));
+				}
+			}
+		private:
+			std::byte* mDestination;
+			int mPosition = 0;
+		};
+	}
+
+	bool has_alpha(Image const& aImage) noexcept {
+		for (std::size_t i = 3; i < aImage.pixels.size(); i += 4) {
+			if (aImage.pixels[i] != 255) return true;
+		}
+
+		return false;
+	}
+
+	std::vector<Image> build_mip_chain(Image aBase, bool aSrgb) {
+		std::array<float, 256> toLinear;
+		for (int i = 0; i < 256; ++i) {
+			float const value = i / 255.0f;
+			toLinear[i] = aSrgb ? (value <= 0.04045f ? value / 12.92f : glm::pow((value + 0.055f) / 1.055f, 2.4f)) : value;
+		}
+
+		auto const fromLinear = [aSrgb](float aValue) {
+			if (aSrgb) aValue = aValue <= 0.0031308f ? aValue * 12.92f : 1.055f * glm::pow(aValue, 1.0f / 2.4f) - 0.055f;
+			return static_cast<std::uint8_t>(glm::round(glm::clamp(aValue, 0.0f, 1.0f) * 255.0f));
+		};
+
+		std::vector<Image> chain;
+		chain.push_back(std::move(aBase));
+
+		while (chain.back().width > 1 || chain.back().height > 1) {
+			Image const& source = chain.back();
+
+			Image level;
+			level.width = glm::max(source.width / 2, 1u);
+			level.height = glm::max(source.height / 2, 1u);
+			level.pixels.resize(static_cast<std::size_t>(level.width) * level.height * 4);
+
+			for (std::uint32_t y = 0; y < level.height; ++y) {
+				for (std::uint32_t x = 0; x < level.width; ++x) {
+					std::uint32_t const xs[2] = { glm::min(x * 2, source.width - 1), glm::min(x * 2 + 1, source.width - 1) };
+					std::uint32_t const ys[2] = { glm::min(y * 2, source.height - 1), glm::min(y * 2 + 1, source.height - 1) };
+
+					glm::vec4 sum = glm::vec4(0.0f);
+					for (std::uint32_t sy : ys) {
+						for (std::uint32_t sx : xs) {
+							std::uint8_t const* texel = source.pixels.data() + (static_cast<std::size_t>(sy) * source.width + sx) * 4;
+							sum += glm::vec4(toLinear[texel[0]], toLinear[texel[1]], toLinear[texel[2]], texel[3] / 255.0f);
+						}
+					}
+
+					sum *= 0.25f;
+					std::uint8_t* destination = level.pixels.data() + (static_cast<std::size_t>(y) * level.width + x) * 4;
+					destination[0] = fromLinear(sum.r);
+					destination[1] = fromLinear(sum.g);
+					destination[2] = fromLinear(sum.b);
+					destination[3] = static_cast<std::uint8_t>(glm::round(sum.a * 255.0f));
+				}
+			}
+
+			chain.push_back(std::move(level));
+		}
+
+		return chain;
+	}
+
+	std::vector<std::byte> compress_image(Image const& aImage, BlockFormat aFormat) {
+		std::uint32_t const blocksX = (aImage.width + 3) / 4;
+		std::uint32_t const blocksY = (aImage.height + 3) / 4;
+		std::size_t const blockSize = block_bytes(aFormat);
+
+		std::vector<std::byte> blocks(static_cast<std::size_t>(blocksX) * blocksY * blockSize);
+		std::array<std::uint8_t, 64> block;
+
+		for (std::uint32_t by = 0; by < blocksY; ++by) {
+			for (std::uint32_t bx = 0; bx < blocksX; ++bx) {
+				for (std::uint32_t i = 0; i < 16; ++i) {
+					std::uint32_t const x = glm::min(bx * 4 + i % 4, aImage.width - 1);
+					std::uint32_t const y = glm::min(by * 4 + i / 4, aImage.height - 1);
+					std::memcpy(block.data() + i * 4, aImage.pixels.data() + (static_cast<std::size_t>(y) * aImage.width + x) * 4, 4);
+				}
+
+				std::byte* destination = blocks.data() + (static_cast<std::size_t>(by) * blocksX + bx) * blockSize;
+
+				switch (aFormat) {
+				case BlockFormat::BC1: encode_bc1_block(block, destination); break;
+				case BlockFormat::BC3: encode_bc3_block(block, destination); break;
+				case BlockFormat::BC7: encode_bc7_block(block, destination); break;
+				}
+			}
+		}
+
+		return blocks;
+	}
+
+	void encode_bc1_block(std::span<std::uint8_t const, 64> aPixels, std::byte* aDestination) {
+		encode_color_block(aPixels, aDestination);
+	}
+
+	void encode_bc3_block(std::span<std::uint8_t const, 64> aPixels, std::byte* aDestination) {
+		encode_alpha_block(aPixels, aDestination);
+		encode_color_block(aPixels, aDestination + 8);
+	}
+
+	void encode_bc7_block(std::span<std::uint8_t const, 64> aPixels, std::byte* aDestination) {
+		auto const [first, second] = principal_endpoints(aPixels, 4);
+		Bc7Fit fit = fit_bc7(aPixels, first, second);
+
+		std::array<float, 16> weights;
+		for (int i = 0; i < 16; ++i) weights[i] = 1.0f - kBc7Weights[fit.indices[i]] / 64.0f;
+
+		glm::vec4 refinedFirst, refinedSecond;
+		if (solve_endpoints(aPixels, weights, refinedFirst, refinedSecond)) {
+			Bc7Fit const refined = fit_bc7(aPixels, refinedFirst, refinedSecond);
+			if (refined.error < fit.error) fit = refined;
+		}
+
+		// The anchor index is stored without its high bit, flip the endpoints so it is clear
+		if (fit.indices[0] >= 8) {
+			std::swap(fit.first, fit.second);
+			for (int& index : fit.indices) index = 15 - index;
+		}
+
+		std::memset(aDestination, 0, 16);
+		BitWriter writer(aDestination);
+		writer.write(1 << 6, 7); // Mode 6
+
+		for (int c = 0; c < 4; ++c) {
+			writer.write(fit.first.color[c], 7);
+			writer.write(fit.second.color[c], 7);
+		}
+
+		writer.write(fit.first.pbit, 1);
+		writer.write(fit.second.pbit, 1);
+
+		writer.write(fit.indices[0], 3);
+		for (int i = 1; i < 16; ++i) writer.write(fit.indices[i], 4);
+	}
+}
\ No newline at end of file
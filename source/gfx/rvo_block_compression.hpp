@@ -0,0 +1,37 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <cstddef>
+#include <cstdint>
+
+namespace rvo {
+	enum class BlockFormat : std::uint8_t {
+		BC1, // Opaque rgb, 4bpp
+		BC3, // BC1 color with a separate interpolated alpha block, 8bpp
+		BC7, // Mode 6 only, rgba with shared endpoints, 8bpp
+	};
+
+	constexpr std::size_t block_bytes(BlockFormat aFormat) noexcept { return aFormat == BlockFormat::BC1 ? 8 : 16; }
+
+	// Tightly packed rgba8
+	struct Image final {
+		std::uint32_t width = 0;
+		std::uint32_t height = 0;
+		std::vector<std::uint8_t> pixels;
+	};
+
+	bool has_alpha(Image const& aImage) noexcept;
+
+	// Full chain down to 1x1 with a box filter, aBase is level 0
+	// Color channels are filtered in linear space when aSrgb is set, alpha always is
+	std::vector<Image> build_mip_chain(Image aBase, bool aSrgb);
+
+	// Blocks in row major order, edges are padded by clamping
+	std::vector<std::byte> compress_image(Image const& aImage, BlockFormat aFormat);
+
+	// aPixels is a 4x4 rgba8 block in row major order
+	void encode_bc1_block(std::span<std::uint8_t const, 64> aPixels, std::byte* aDestination);
+	void encode_bc3_block(std::span<std::uint8_t const, 64> aPixels, std::byte* aDestination);
+	void encode_bc7_block(std::span<std::uint8_t const, 64> aPixels, std::byte* aDestination);
+}
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include "rvo_ktx2.hpp"
+
+#include "../rvo_vfs.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstring>
+#include <fstream>
+
+namespace rvo {
+	namespace {
+		constexpr std::array<std::uint8_t, 12> kIdentifier = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+		constexpr std::size_t kHeaderSize = 80;
+		constexpr std::size_t kLevelIndexEntrySize = 24;
+
+		// Data format descriptor enums, see the Khronos Data Format Specification
+		constexpr std::uint32_t kDfdModelBc1a = 128;
+		constexpr std::uint32_t kDfdModelBc3 = 130;
+		constexpr std::uint32_t kDfdModelBc7 = 134;
+		constexpr std::uint32_t kDfdPrimariesBt709 = 1;
+		constexpr std::uint32_t kDfdTransferLinear = 1;
+		constexpr std::uint32_t kDfdTransferSrgb = 2;
+		constexpr std::uint32_t kDfdChannelColor = 0;
+		constexpr std::uint32_t kDfdChannelAlpha = 15;
+
+		struct FormatInfo final {
+			BlockFormat format;
+			std::uint32_t vkFormat;
+			std::uint32_t vkFormatSrgb;
+		};
+
+		constexpr std::array<FormatInfo, 3> kFormats = { {
+			{ BlockFormat::BC1, 131, 132 }, // VK_FORMAT_BC1_RGB_UNORM_BLOCK, VK_FORMAT_BC1_RGB_SRGB_BLOCK
+			{ BlockFormat::BC3, 137, 138 }, // VK_FORMAT_BC3_UNORM_BLOCK, VK_FORMAT_BC3_SRGB_BLOCK
+			{ BlockFormat::BC7, 145, 146 }, // VK_FORMAT_BC7_UNORM_BLOCK, VK_FORMAT_BC7_SRGB_BLOCK
+		} };
+
+		std::size_t align(std::size_t aValue, std::size_t aAlignment) {
+			return (aValue + aAlignment - 1) / aAlignment * aAlignment;
+		}
+
+		template<typename T>
+		void write(std::vector<std::byte>& aBytes, std::size_t aOffset, T aValue) {
+			std::memcpy(aBytes.data() + aOffset, &aValue, sizeof(T));
+		}
+
+		template<typename T>
+		T read(std::span<std::byte const> aBytes, std::size_t aOffset) {
+			T value;
+			std::memcpy(&value, aBytes.data() + aOffset, sizeof(T));
+			return value;
+		}
+
+		// Basic descriptor block, one sample per 64 bit half of the block
+		std::vector<std::uint32_t> make_dfd(BlockFormat aFormat, bool aSrgb) {
+			struct Sample final {
+				std::uint32_t bitOffset;
+				std::uint32_t channel;
+			};
+
+			std::uint32_t model = kDfdModelBc1a;
+			std::vector<Sample> samples = { { 0, kDfdChannelColor } };
+
+			if (aFormat == BlockFormat::BC3) {
+				model = kDfdModelBc3;
+				samples = { { 0, kDfdChannelAlpha }, { 64, kDfdChannelColor } };
+			}
+			else if (aFormat == BlockFormat::BC7) {
+				model = kDfdModelBc7;
+				samples = { { 0, kDfdChannelColor } };
+			}
+
+			std::uint32_t const blockSize = 24 + 16 * static_cast<std::uint32_t>(samples.size());
+			std::uint32_t const transfer = aSrgb ? kDfdTransferSrgb : kDfdTransferLinear;
+			std::uint32_t const bitLength = aFormat == BlockFormat::BC7 ? 127 : 63;
+
+			std::vector<std::uint32_t> words = {
+				4 + blockSize, // dfdTotalSize
+				0, // vendorId, descriptorType
+				2 | blockSize << 16, // versionNumber, descriptorBlockSize
+				model | kDfdPrimariesBt709 << 8 | transfer << 16, // flags are zero, straight alpha
+				3 | 3 << 8, // 4x4 texel blocks, stored as dimension - 1
+				static_cast<std::uint32_t>(block_bytes(aFormat)),
+				0,
+			};
+
+			for (Sample const& sample : samples) {
+				words.push_back(sample.bitOffset | bitLength << 16 | sample.channel << 24);
+				words.push_back(0); // samplePosition
+				words.push_back(0); // sampleLower
+				words.push_back(0xFFFFFFFF); // sampleUpper
+			}
+
+			return words;
+		}
+	}
+
+	bool write_ktx2(std::filesystem::path const& aPath, Ktx2Texture const& aTexture) {
+		FormatInfo const& info = kFormats[static_cast<std::size_t>(aTexture.format)];
+		std::vector<std::uint32_t> const dfd = make_dfd(aTexture.format, aTexture.srgb);
+		std::size_t const levelCount = aTexture.levels.size();
+
+		std::size_t const dfdOffset = kHeaderSize + kLevelIndexEntrySize * levelCount;
+		std::size_t const dfdSize = dfd.size() * sizeof(std::uint32_t);
+
+		// Mip data is stored smallest first, each level aligned to the block size
+		std::vector<std::size_t> levelOffsets(levelCount);
+		std::size_t size = dfdOffset + dfdSize;
+		for (std::size_t i = levelCount; i-- > 0;) {
+			size = align(size, block_bytes(aTexture.format));
+			levelOffsets[i] = size;
+			size += aTexture.levels[i].size;
+		}
+
+		std::vector<std::byte> bytes(size);
+		std::memcpy(bytes.data(), kIdentifier.data(), kIdentifier.size());
+		write<std::uint32_t>(bytes, 12, aTexture.srgb ? info.vkFormatSrgb : info.vkFormat);
+		write<std::uint32_t>(bytes, 16, 1); // typeSize
+		write<std::uint32_t>(bytes, 20, aTexture.width);
+		write<std::uint32_t>(bytes, 24, aTexture.height);
+		write<std::uint32_t>(bytes, 28, 0); // pixelDepth
+		write<std::uint32_t>(bytes, 32, 0); // layerCount
+		write<std::uint32_t>(bytes, 36, 1); // faceCount
+		write<std::uint32_t>(bytes, 40, static_cast<std::uint32_t>(levelCount));
+		write<std::uint32_t>(bytes, 44, 0); // supercompressionScheme
+		write<std::uint32_t>(bytes, 48, static_cast<std::uint32_t>(dfdOffset));
+		write<std::uint32_t>(bytes, 52, static_cast<std::uint32_t>(dfdSize));
+		// No key/value or supercompression data, the rest of the header stays zero
+
+		for (std::size_t i = 0; i < levelCount; ++i) {
+			std::size_t const entry = kHeaderSize + kLevelIndexEntrySize * i;
+			write<std::uint64_t>(bytes, entry + 0, levelOffsets[i]);
+			write<std::uint64_t>(bytes, entry + 8, aTexture.levels[i].size);
+			write<std::uint64_t>(bytes, entry + 16, aTexture.levels[i].size);
+
+			std::span<std::byte const> const level = aTexture.level(i);
+			std::memcpy(bytes.data() + levelOffsets[i], level.data(), level.size());
+		}
+
+		std::memcpy(bytes.data() + dfdOffset, dfd.data(), dfdSize);
+
+		std::error_code error;
+		std::filesystem::create_directories(aPath.parent_path(), error);
+
+		std::ofstream stream(aPath, std::ios::binary);
+		if (!stream) {
+			spdlog::error("Failed to open `{}` for writing", aPath.string());
+			return false;
+		}
+
+		stream.write(reinterpret_cast<char const*>(bytes.data()), bytes.size());
+		return static_cast<bool>(stream);
+	}
+
+	std::optional<Ktx2Texture> read_ktx2(std::filesystem::path const& aPath, std::size_t aFirstLevel) {
+		auto const optFileSize = vfs::file_size(aPath);
+		if (!optFileSize) return std::nullopt;
+
+		std::size_t const fileSize = *optFileSize;
+
+		std::vector<std::byte> header(kHeaderSize);
+		if (!vfs::read_range(aPath, 0, header) || std::memcmp(header.data(), kIdentifier.data(), kIdentifier.size()) != 0) {
+			spdlog::error("`{}` is not a ktx2 file", aPath.string());
+			return std::nullopt;
+		}
+
+		std::uint32_t const vkFormat = read<std::uint32_t>(header, 12);
+		std::uint32_t const levelCount = read<std::uint32_t>(header, 40);
+
+		Ktx2Texture texture;
+		texture.width = read<std::uint32_t>(header, 20);
+		texture.height = read<std::uint32_t>(header, 24);
+
+		bool knownFormat = false;
+		for (FormatInfo const& info : kFormats) {
+			if (vkFormat != info.vkFormat && vkFormat != info.vkFormatSrgb) continue;
+			texture.format = info.format;
+			texture.srgb = vkFormat == info.vkFormatSrgb;
+			knownFormat = true;
+		}
+
+		bool const supported = knownFormat
+			&& read<std::uint32_t>(header, 28) == 0 // pixelDepth
+			&& read<std::uint32_t>(header, 32) == 0 // layerCount
+			&& read<std::uint32_t>(header, 36) == 1 // faceCount
+			&& read<std::uint32_t>(header, 44) == 0 // supercompressionScheme
+			&& levelCount > 0
+			&& fileSize >= kHeaderSize + kLevelIndexEntrySize * levelCount;
+
+		if (!supported) {
+			spdlog::error("`{}` uses unsupported ktx2 features", aPath.string());
+			return std::nullopt;
+		}
+
+		std::vector<std::byte> levelIndex(kLevelIndexEntrySize * levelCount);
+		if (!vfs::read_range(aPath, kHeaderSize, levelIndex)) {
+			spdlog::error("`{}` is truncated", aPath.string());
+			return std::nullopt;
+		}
+
+		for (std::uint32_t i = 0; i < levelCount; ++i) {
+			std::uint64_t const offset = read<std::uint64_t>(levelIndex, kLevelIndexEntrySize * i + 0);
+			std::uint64_t const size = read<std::uint64_t>(levelIndex, kLevelIndexEntrySize * i + 8);
+
+			if (offset > fileSize || size > fileSize - offset) {
+				spdlog::error("`{}` is truncated", aPath.string());
+				return std::nullopt;
+			}
+
+			texture.levels.push_back({ static_cast<std::size_t>(offset), static_cast<std::size_t>(size) });
+		}
+
+		// Only read the byte range covering the requested levels
+		aFirstLevel = glm::min<std::size_t>(aFirstLevel, levelCount);
+		std::size_t begin = fileSize, end = 0;
+		for (std::size_t i = aFirstLevel; i < levelCount; ++i) {
+			begin = glm::min(begin, texture.levels[i].offset);
+			end = glm::max(end, texture.levels[i].offset + texture.levels[i].size);
+		}
+
+		if (begin < end) {
+			texture.dataOffset = begin;
+			texture.data.resize(end - begin);
+
+			if (!vfs::read_range(aPath, begin, texture.data)) {
+				spdlog::error("Failed to read `{}`", aPath.string());
+				return std::nullopt;
+			}
+		}
+
+		return texture;
+	}
+}
\ No newline at end of file
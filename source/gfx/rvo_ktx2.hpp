@@ -0,0 +1,40 @@
+#pragma once
+
+#include "rvo_block_compression.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <vector>
+#include <span>
+#include <cstddef>
+#include <cstdint>
+
+namespace rvo {
+	// Subset of KTX 2.0, single 2d image with a full mip chain of one of our block formats, no supercompression
+	struct Ktx2Texture final {
+		struct Level final {
+			std::size_t offset; // In the file
+			std::size_t size;
+		};
+
+		BlockFormat format = BlockFormat::BC1;
+		bool srgb = true;
+		std::uint32_t width = 0;
+		std::uint32_t height = 0;
+		std::vector<Level> levels; // Level 0 is the largest
+		std::vector<std::byte> data; // May only hold some of the levels, see `read_ktx2`
+		std::size_t dataOffset = 0; // File offset of the first byte in data
+
+		bool has_level(std::size_t aIndex) const noexcept { return levels[aIndex].offset >= dataOffset && levels[aIndex].offset + levels[aIndex].size <= dataOffset + data.size(); }
+		std::span<std::byte const> level(std::size_t aIndex) const noexcept { return { data.data() + (levels[aIndex].offset - dataOffset), levels[aIndex].size }; }
+
+		std::uint32_t level_width(std::size_t aIndex) const noexcept { return width >> aIndex ? width >> aIndex : 1; }
+		std::uint32_t level_height(std::size_t aIndex) const noexcept { return height >> aIndex ? height >> aIndex : 1; }
+	};
+
+	bool write_ktx2(std::filesystem::path const& aPath, Ktx2Texture const& aTexture);
+
+	// Only accepts files we could have written ourselves
+	// Levels above aFirstLevel are indexed but their data is not read, used by the streamer to load just the tail of the chain
+	std::optional<Ktx2Texture> read_ktx2(std::filesystem::path const& aPath, std::size_t aFirstLevel = 0);
+}
\ No newline at end of file
@@ -1,7 +1,5 @@
 #include "rvo_mesh.hpp"
 
-#include "../happly.h"
-
 #include "../rvo_utility.hpp"
 
 #include <vector>
@@ -9,101 +7,240 @@
 
 namespace rvo {
 	namespace {
-		std::pair<std::vector<StandardVertex>, std::vector<std::uint32_t>> read_mesh(const char* aPath) {
-			happly::PLYData plyIn(aPath);
-
-			auto x = plyIn.getElement("vertex").getProperty<float>("x");
-			auto y = plyIn.getElement("vertex").getProperty<float>("y");
-			auto z = plyIn.getElement("vertex").getProperty<float>("z");
-			auto nx = plyIn.getElement("vertex").getProperty<float>("nx");
-			auto ny = plyIn.getElement("vertex").getProperty<float>("ny");
-			auto nz = plyIn.getElement("vertex").getProperty<float>("nz");
-			auto s = plyIn.getElement("vertex").getProperty<float>("s"); // UV are also possible options for this, blender exports ST so we use that
-			auto t = plyIn.getElement("vertex").getProperty<float>("t");
-
-			auto elements = plyIn.getElement("face").getListPropertyAnySign<std::size_t>("vertex_indices");
-
-			std::vector<StandardVertex> vertices(x.size());
-			for (size_t i = 0; i < x.size(); ++i) {
-				vertices[i].position = glm::vec3(x[i], y[i], z[i]);
-				vertices[i].normal = glm::vec3(nx[i], ny[i], nz[i]);
-
-				// Flip uv on y axis so we dont need to flip images on load
-				vertices[i].textureCoord = glm::vec2(s[i], 1.0f - t[i]);
+		GLintptr align_up(GLintptr aValue, GLint aAlignment) {
+			if (aAlignment <= 1) return aValue;
+			return (aValue + aAlignment - 1) / aAlignment * aAlignment;
+		}
+
+		void setup_instancing(GLuint aVao) {
+			glVertexArrayVertexBuffer(aVao, 1, get_instanced_buffer(), 0, sizeof(glm::mat4));
+			glVertexArrayBindingDivisor(aVao, 1, 1);
+
+			for (int i = 12; i < 16; ++i) {
+				glEnableVertexArrayAttrib(aVao, i);
+				glVertexArrayAttribBinding(aVao, i, 1);
+				glVertexArrayAttribFormat(aVao, i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4) * (i - 12));
 			}
+		}
+
+		void setup_position(GLuint aVao, PositionFormat aFormat, GLuint aOffset) {
+			glEnableVertexArrayAttrib(aVao, 0);
 
-			std::vector<std::uint32_t> indices;
-			// Preallocate the index buffer, assume all faces will have the same number of vertices
-			// This guess is likely correct, but it's possible to be wrong, it's not a big deal if its wrong
-			indices.reserve(elements.size() * (elements[0].size() - 2) * 3);
-
-			for (auto& element : elements) {
-				for (size_t j = 1; j + 1 < element.size(); j++) {
-					indices.push_back(static_cast<std::uint32_t>(element[0]));
-					indices.push_back(static_cast<std::uint32_t>(element[j]));
-					indices.push_back(static_cast<std::uint32_t>(element[j + 1]));
-				}
+			if (aFormat == PositionFormat::Float3) {
+				glVertexArrayAttribFormat(aVao, 0, 3, GL_FLOAT, GL_FALSE, aOffset);
+			}
+			else {
+				glVertexArrayAttribFormat(aVao, 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, aOffset);
 			}
 
-			return { vertices, indices };
+			glVertexArrayAttribBinding(aVao, 0, 0);
 		}
-	}
 
-	Mesh::Mesh(char const* aPath) {
-		auto [vertices, elements] = read_mesh(aPath);
+		GLuint make_vao(GLuint aVbo, GLuint aEbo, VertexFormat const& aFormat) {
+			GLuint vao;
+			glCreateVertexArrays(1, &vao);
+			glVertexArrayVertexBuffer(vao, 0, aVbo, 0, static_cast<GLsizei>(aFormat.stride()));
+			glVertexArrayElementBuffer(vao, aEbo);
+
+			setup_position(vao, aFormat.position, aFormat.position_offset());
+
+			glEnableVertexArrayAttrib(vao, 1);
+			glVertexArrayAttribFormat(vao, 1, 2, GL_SHORT, GL_TRUE, aFormat.normal_offset());
+			glVertexArrayAttribBinding(vao, 1, 0);
+
+			glEnableVertexArrayAttrib(vao, 2);
+
+			if (aFormat.textureCoord == TextureCoordFormat::Float2) {
+				glVertexArrayAttribFormat(vao, 2, 2, GL_FLOAT, GL_FALSE, aFormat.texture_coord_offset());
+			}
+			else {
+				glVertexArrayAttribFormat(vao, 2, 2, GL_HALF_FLOAT, GL_FALSE, aFormat.texture_coord_offset());
+			}
+
+			glVertexArrayAttribBinding(vao, 2, 0);
+
+			setup_instancing(vao);
+			return vao;
+		}
 
+		GLuint make_depth_vao(GLuint aPositionVbo, GLuint aEbo, VertexFormat const& aFormat) {
+			GLuint vao;
+			glCreateVertexArrays(1, &vao);
+			glVertexArrayVertexBuffer(vao, 0, aPositionVbo, 0, static_cast<GLsizei>(aFormat.position_stride()));
+			glVertexArrayElementBuffer(vao, aEbo);
+
+			setup_position(vao, aFormat.position, 0);
+			setup_instancing(vao);
+			return vao;
+		}
+	}
+
+	Mesh::Mesh(MeshData const& aData) {
 		mVbo = { {
-				.data = std::as_bytes(std::span(vertices)),
+				.data = std::span(aData.vertices),
 				.flags = GL_NONE,
 			} };
 
 		mEbo = { {
-				.data = std::as_bytes(std::span(elements)),
+				.data = std::span(aData.indices),
 				.flags = GL_NONE,
 			} };
 
-		glCreateVertexArrays(1, &mVao);
-		glVertexArrayVertexBuffer(mVao, 0, mVbo.handle(), 0, sizeof(StandardVertex));
-		glVertexArrayElementBuffer(mVao, mEbo.handle());
-		glEnableVertexArrayAttrib(mVao, 0);
-		glEnableVertexArrayAttrib(mVao, 1);
-		glEnableVertexArrayAttrib(mVao, 2);
-		glVertexArrayAttribFormat(mVao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(StandardVertex, position));
-		glVertexArrayAttribFormat(mVao, 1, 3, GL_FLOAT, GL_FALSE, offsetof(StandardVertex, normal));
-		glVertexArrayAttribFormat(mVao, 2, 2, GL_FLOAT, GL_FALSE, offsetof(StandardVertex, textureCoord));
-		glVertexArrayAttribBinding(mVao, 0, 0);
-		glVertexArrayAttribBinding(mVao, 1, 0);
-		glVertexArrayAttribBinding(mVao, 2, 0);
-		mCount = static_cast<GLsizei>(elements.size());
-
-		glVertexArrayVertexBuffer(mVao, 1, get_instanced_buffer(), 0, sizeof(glm::mat4));
-		glVertexArrayBindingDivisor(mVao, 1, 1);
-
-		for (int i = 12; i < 16; ++i) {
-			glEnableVertexArrayAttrib(mVao, i);
-			glVertexArrayAttribBinding(mVao, i, 1);
-			glVertexArrayAttribFormat(mVao, i, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4) * (i - 12));
+		mVao = make_vao(mVbo.handle(), mEbo.handle(), aData.format);
+		mCount = static_cast<GLsizei>(aData.indexCount);
+		mIndexType = aData.indexSize == sizeof(std::uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		mDequantizeTransform = aData.dequantize_transform();
+		mBoundingSphere = aData.boundingSphere;
+
+		if (!aData.positions.empty()) {
+			mPositionVbo = { {
+					.data = std::span(aData.positions),
+					.flags = GL_NONE,
+				} };
+
+			mDepthVao = make_depth_vao(mPositionVbo.handle(), mEbo.handle(), aData.format);
+		}
+
+		if (!aData.meshlets.empty()) {
+			mMeshletCount = static_cast<GLsizei>(aData.meshlets.size());
+
+			mMeshletBuffer = { {
+					.data = std::as_bytes(std::span(aData.meshlets)),
+					.flags = GL_NONE,
+				} };
+
+			GLint alignment = 0;
+			glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+			// Worst case every meshlet is visible
+			mCulledIndexStride = align_up(static_cast<GLintptr>(mCount) * GLintptr(sizeof(std::uint32_t)), alignment);
+			mCulledCommandStride = align_up(GLintptr(sizeof(DrawElementsIndirectCommand)), alignment);
+			reserve_cull_slots(1);
+
+			mCulledVao = make_vao(mVbo.handle(), mCulledEbo.handle(), aData.format);
+
+			if (mDepthVao) {
+				mCulledDepthVao = make_depth_vao(mPositionVbo.handle(), mCulledEbo.handle(), aData.format);
+			}
 		}
 	}
 
 	Mesh& Mesh::operator=(Mesh&& aOther) noexcept {
 		std::swap(mVao, aOther.mVao);
+		std::swap(mDepthVao, aOther.mDepthVao);
 		std::swap(mVbo, aOther.mVbo);
 		std::swap(mEbo, aOther.mEbo);
+		std::swap(mPositionVbo, aOther.mPositionVbo);
+		std::swap(mCulledVao, aOther.mCulledVao);
+		std::swap(mCulledDepthVao, aOther.mCulledDepthVao);
+		std::swap(mMeshletBuffer, aOther.mMeshletBuffer);
+		std::swap(mCulledEbo, aOther.mCulledEbo);
+		std::swap(mCulledCommand, aOther.mCulledCommand);
+		std::swap(mCullSlots, aOther.mCullSlots);
+		std::swap(mCulledIndexStride, aOther.mCulledIndexStride);
+		std::swap(mCulledCommandStride, aOther.mCulledCommandStride);
+		std::swap(mMeshletCount, aOther.mMeshletCount);
 		std::swap(mCount, aOther.mCount);
+		std::swap(mIndexType, aOther.mIndexType);
+		std::swap(mDequantizeTransform, aOther.mDequantizeTransform);
+		std::swap(mBoundingSphere, aOther.mBoundingSphere);
 		return *this;
 	}
 
 	Mesh::~Mesh() noexcept {
 		if (mVao) glDeleteVertexArrays(1, &mVao);
+		if (mDepthVao) glDeleteVertexArrays(1, &mDepthVao);
+		if (mCulledVao) glDeleteVertexArrays(1, &mCulledVao);
+		if (mCulledDepthVao) glDeleteVertexArrays(1, &mCulledDepthVao);
+	}
+
+	void Mesh::bind(bool aCulled) const {
+		glBindVertexArray(aCulled && mCulledVao ? mCulledVao : mVao);
+	}
+
+	void Mesh::bind_depth(bool aCulled) const {
+		if (aCulled && mCulledVao) {
+			glBindVertexArray(mCulledDepthVao ? mCulledDepthVao : mCulledVao);
+		}
+		else {
+			glBindVertexArray(mDepthVao ? mDepthVao : mVao);
+		}
+	}
+
+	void Mesh::reserve_cull_slots(std::uint32_t aCount) const {
+		if (aCount <= mCullSlots) return;
+
+		// Doubling keeps the reallocations rare when many batches share a mesh
+		std::uint32_t const count = glm::max(aCount, mCullSlots * 2);
+
+		Buffer indices = { {
+				.data = std::span(static_cast<std::byte const*>(nullptr), static_cast<std::size_t>(mCulledIndexStride) * count),
+				.flags = GL_NONE,
+			} };
+
+		Buffer commands = { {
+				.data = std::span(static_cast<std::byte const*>(nullptr), static_cast<std::size_t>(mCulledCommandStride) * count),
+				.flags = GL_DYNAMIC_STORAGE_BIT,
+			} };
+
+		// Batches culled earlier this frame are drawn from the new buffers
+		if (mCullSlots > 0) {
+			glCopyNamedBufferSubData(mCulledEbo.handle(), indices.handle(), 0, 0, mCulledIndexStride * mCullSlots);
+			glCopyNamedBufferSubData(mCulledCommand.handle(), commands.handle(), 0, 0, mCulledCommandStride * mCullSlots);
+		}
+
+		mCulledEbo = std::move(indices);
+		mCulledCommand = std::move(commands);
+		mCullSlots = count;
+
+		if (mCulledVao) glVertexArrayElementBuffer(mCulledVao, mCulledEbo.handle());
+		if (mCulledDepthVao) glVertexArrayElementBuffer(mCulledDepthVao, mCulledEbo.handle());
+	}
+
+	void Mesh::cull_meshlets(ShaderProgram& aProgram, glm::mat4 const& aModel, std::span<glm::vec4 const, 6> aFrustum, glm::vec3 const& aCameraPosition, bool aConeCulling, std::uint32_t aSlot) const {
+		reserve_cull_slots(aSlot + 1);
+
+		GLintptr const indexOffset = mCulledIndexStride * aSlot;
+		GLintptr const commandOffset = mCulledCommandStride * aSlot;
+
+		// The shader writes from the start of the bound range, the draw reads the slot through firstIndex
+		DrawElementsIndirectCommand const command = {
+			.count = 0,
+			.instanceCount = 1,
+			.firstIndex = static_cast<GLuint>(indexOffset / GLintptr(sizeof(std::uint32_t))),
+			.baseVertex = 0,
+			.baseInstance = 0,
+		};
+
+		glNamedBufferSubData(mCulledCommand.handle(), commandOffset, sizeof(command), &command);
+
+		aProgram.bind();
+		aProgram.push_mat4f("uModel"_u, aModel);
+		aProgram.push_4fv("uFrustum[0]"_u, aFrustum);
+		aProgram.push_3f("uCameraPosition"_u, aCameraPosition);
+		aProgram.push_1i("uConeCulling"_u, aConeCulling);
+		aProgram.push_1i("uIndexSize16"_u, mIndexType == GL_UNSIGNED_SHORT);
+		aProgram.push_1i("uMeshletCount"_u, mMeshletCount);
+
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mMeshletBuffer.handle());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mEbo.handle());
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 2, mCulledEbo.handle(), indexOffset, mCulledIndexStride);
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 3, mCulledCommand.handle(), commandOffset, sizeof(DrawElementsIndirectCommand));
+
+		// One workgroup per meshlet, spill into y past the dispatch limit
+		GLuint const groupsX = glm::min(static_cast<GLuint>(mMeshletCount), 65535u);
+		GLuint const groupsY = (static_cast<GLuint>(mMeshletCount) + groupsX - 1) / groupsX;
+		glDispatchCompute(groupsX, groupsY, 1);
 	}
 
-	void Mesh::bind() const {
-		glBindVertexArray(mVao);
+	void Mesh::draw_culled(std::uint32_t aSlot) const {
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCulledCommand.handle());
+		glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, reinterpret_cast<void const*>(mCulledCommandStride * aSlot));
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 	}
 
 	void Mesh::draw(GLsizei instanceCount) const {
-		glDrawElementsInstanced(GL_TRIANGLES, mCount, GL_UNSIGNED_INT, nullptr, instanceCount);
+		glDrawElementsInstanced(GL_TRIANGLES, mCount, mIndexType, nullptr, instanceCount);
 	}
 
 	void Mesh::render() const {
@@ -1,41 +1,75 @@
 #pragma once
 
 #include "rvo_buffer.hpp"
+#include "rvo_mesh_data.hpp"
+#include "rvo_shader.hpp"
 
 #include <glm/glm.hpp>
 #include <glad/gl.h>
 
+#include <cstdint>
 #include <utility>
+#include <span>
 
 namespace rvo {
 	GLuint get_instanced_buffer();
 
-	struct StandardVertex final {
-		glm::vec3 position;
-		glm::vec3 normal;
-		glm::vec2 textureCoord;
+	struct DrawElementsIndirectCommand final {
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+		GLuint baseInstance;
 	};
 
 	class Mesh final {
 	public:
 		constexpr Mesh() noexcept = default;
 
-		Mesh(char const* aPath);
+		Mesh(MeshData const& aData);
 		Mesh(Mesh const&) = delete;
 		Mesh& operator=(Mesh const&) = delete;
 		Mesh(Mesh&& aOther) noexcept { *this = std::move(aOther); }
 		Mesh& operator=(Mesh&& aOther) noexcept;
 		~Mesh() noexcept;
 
-		void bind() const;
+		// When aCulled is set the vao sources indices from `cull_meshlets`, `draw_culled` picks the slot
+		void bind(bool aCulled = false) const;
+		// Binds the position only vao, meshes without a position stream bind the full vao instead
+		void bind_depth(bool aCulled = false) const;
 		void draw(GLsizei aInstanceCount = 1) const;
+
+		// Writes the indices of the visible meshlets for a single instance into aSlot, see shaders/meshlet_cull.glsl
+		// Every batch culled in a frame needs a slot of its own, a slot keeps its result until it is culled again
+		// Issue a GL_COMMAND_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT memory barrier before `draw_culled`
+		void cull_meshlets(ShaderProgram& aProgram, glm::mat4 const& aModel, std::span<glm::vec4 const, 6> aFrustum, glm::vec3 const& aCameraPosition, bool aConeCulling, std::uint32_t aSlot) const;
+		void draw_culled(std::uint32_t aSlot) const;
 		[[deprecated]] void render() const;
 
 		GLuint vao() const noexcept { return mVao; }
+		bool has_position_stream() const noexcept { return mDepthVao != 0; }
+		bool has_meshlets() const noexcept { return mMeshletCount > 0; }
+		glm::mat4 const& dequantize_transform() const noexcept { return mDequantizeTransform; }
+		glm::vec4 const& bounding_sphere() const noexcept { return mBoundingSphere; }
 
 	private:
+		// Grows the culled buffers to aCount slots, slots already written are kept
+		void reserve_cull_slots(std::uint32_t aCount) const;
+
 		GLuint mVao = 0;
-		Buffer mVbo, mEbo;
+		GLuint mDepthVao = 0;
+		GLuint mCulledVao = 0;
+		GLuint mCulledDepthVao = 0;
+		Buffer mVbo, mEbo, mPositionVbo;
+		Buffer mMeshletBuffer;
+		mutable Buffer mCulledEbo, mCulledCommand;
+		mutable std::uint32_t mCullSlots = 0;
+		GLintptr mCulledIndexStride = 0; // Slots are aligned for binding as storage buffer ranges
+		GLintptr mCulledCommandStride = 0;
+		GLsizei mMeshletCount = 0;
 		GLsizei mCount = 0;
+		GLenum mIndexType = GL_UNSIGNED_INT;
+		glm::mat4 mDequantizeTransform = glm::mat4(1.0f);
+		glm::vec4 mBoundingSphere = glm::vec4(0.0f);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include "rvo_mesh_cook.hpp"
+
+#include "rvo_mesh_optimizer.hpp"
+
+#include "../happly.h"
+#include "../rvo_vfs.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <cstring>
+#include <fstream>
+#include <spanstream>
+#include <stdexcept>
+#include <vector>
+
+namespace rvo {
+	namespace {
+		// Bump the magic whenever the layout changes, cooked files are only checked by time
+		struct MeshFileHeader final {
+			char magic[4] = { 'R', 'V', 'M', '1' };
+			std::uint8_t positionFormat;
+			std::uint8_t textureCoordFormat;
+			std::uint16_t _padding = 0;
+			float dequantizeOffset[3];
+			float dequantizeScale;
+			float boundingSphere[4];
+			std::uint32_t vertexCount;
+			std::uint32_t indexCount;
+			std::uint32_t indexSize;
+			std::uint32_t vertexBytes;
+			std::uint32_t indexBytes;
+			std::uint32_t positionBytes;
+			std::uint32_t meshletCount;
+		};
+
+		static_assert(sizeof(MeshFileHeader) == 68);
+
+		std::pair<std::vector<StandardVertex>, std::vector<std::uint32_t>> read_ply(std::filesystem::path const& aPath, std::string_view aBytes) {
+			std::ispanstream stream(std::span(aBytes.data(), aBytes.size()));
+			happly::PLYData plyIn(stream);
+
+			auto x = plyIn.getElement("vertex").getProperty<float>("x");
+			auto y = plyIn.getElement("vertex").getProperty<float>("y");
+			auto z = plyIn.getElement("vertex").getProperty<float>("z");
+			auto nx = plyIn.getElement("vertex").getProperty<float>("nx");
+			auto ny = plyIn.getElement("vertex").getProperty<float>("ny");
+			auto nz = plyIn.getElement("vertex").getProperty<float>("nz");
+			auto s = plyIn.getElement("vertex").getProperty<float>("s"); // UV are also possible options for this, blender exports ST so we use that
+			auto t = plyIn.getElement("vertex").getProperty<float>("t");
+
+			auto elements = plyIn.getElement("face").getListPropertyAnySign<std::size_t>("vertex_indices");
+
+			std::vector<StandardVertex> vertices(x.size());
+			for (size_t i = 0; i < x.size(); ++i) {
+				vertices[i].position = glm::vec3(x[i], y[i], z[i]);
+				vertices[i].normal = glm::vec3(nx[i], ny[i], nz[i]);
+
+				// Flip uv on y axis so we dont need to flip images on load
+				vertices[i].textureCoord = glm::vec2(s[i], 1.0f - t[i]);
+			}
+
+			std::vector<std::uint32_t> indices;
+			// Preallocate the index buffer, assume all faces will have the same number of vertices
+			// This guess is likely correct, but it's possible to be wrong, it's not a big deal if its wrong
+			indices.reserve(elements.size() * (elements[0].size() - 2) * 3);
+
+			for (auto& element : elements) {
+				for (size_t j = 1; j + 1 < element.size(); j++) {
+					indices.push_back(static_cast<std::uint32_t>(element[0]));
+					indices.push_back(static_cast<std::uint32_t>(element[j]));
+					indices.push_back(static_cast<std::uint32_t>(element[j + 1]));
+				}
+			}
+
+			// Blender exports faces in whatever order it likes, fix that up for the gpu
+			auto const stats = optimize_mesh(vertices, indices);
+			spdlog::debug("Optimized mesh `{}`: {} -> {} vertices, ACMR {:.3f} -> {:.3f}", aPath.string(), stats.verticesBefore, stats.verticesAfter, stats.acmrBefore, stats.acmrAfter);
+
+			return { vertices, indices };
+		}
+
+	}
+
+	std::optional<MeshData> import_mesh(std::filesystem::path const& aSource) {
+		auto optBytes = vfs::view(aSource);
+		if (!optBytes) {
+			spdlog::error("Failed to read mesh `{}`", aSource.string());
+			return std::nullopt;
+		}
+
+		std::vector<StandardVertex> vertices;
+		std::vector<std::uint32_t> elements;
+
+		// happly reports malformed files with exceptions
+		try {
+			std::tie(vertices, elements) = read_ply(aSource, optBytes->text());
+		}
+		catch (std::exception const& e) {
+			spdlog::error("Failed to import mesh `{}`: {}", aSource.string(), e.what());
+			return std::nullopt;
+		}
+
+		MeshData data = encode_mesh(vertices, elements);
+
+		if (elements.size() / 3 >= kMeshletMinTriangles) {
+			data.meshlets = build_meshlets(vertices, elements);
+		}
+
+		spdlog::debug("Encoded mesh `{}`: {} byte vertices, {} byte indices, {} meshlets", aSource.string(), data.format.stride(), data.indexSize, data.meshlets.size());
+		return data;
+	}
+
+	bool write_mesh_data(std::filesystem::path const& aPath, MeshData const& aData) {
+		MeshFileHeader header;
+		header.positionFormat = static_cast<std::uint8_t>(aData.format.position);
+		header.textureCoordFormat = static_cast<std::uint8_t>(aData.format.textureCoord);
+		std::memcpy(header.dequantizeOffset, &aData.dequantizeOffset, sizeof(header.dequantizeOffset));
+		header.dequantizeScale = aData.dequantizeScale;
+		std::memcpy(header.boundingSphere, &aData.boundingSphere, sizeof(header.boundingSphere));
+		header.vertexCount = aData.vertexCount;
+		header.indexCount = aData.indexCount;
+		header.indexSize = aData.indexSize;
+		header.vertexBytes = static_cast<std::uint32_t>(aData.vertices.size());
+		header.indexBytes = static_cast<std::uint32_t>(aData.indices.size());
+		header.positionBytes = static_cast<std::uint32_t>(aData.positions.size());
+		header.meshletCount = static_cast<std::uint32_t>(aData.meshlets.size());
+
+		std::error_code error;
+		std::filesystem::create_directories(aPath.parent_path(), error);
+
+		std::ofstream stream(aPath, std::ios::binary);
+		if (!stream) {
+			spdlog::error("Failed to open `{}` for writing", aPath.string());
+			return false;
+		}
+
+		stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+		stream.write(reinterpret_cast<char const*>(aData.vertices.data()), aData.vertices.size());
+		stream.write(reinterpret_cast<char const*>(aData.indices.data()), aData.indices.size());
+		stream.write(reinterpret_cast<char const*>(aData.positions.data()), aData.positions.size());
+		stream.write(reinterpret_cast<char const*>(aData.meshlets.data()), aData.meshlets.size() * sizeof(Meshlet));
+
+		return static_cast<bool>(stream);
+	}
+
+	std::optional<MeshData> read_mesh_data(std::filesystem::path const& aPath) {
+		auto optFile = vfs::view(aPath);
+		if (!optFile) return std::nullopt;
+
+		std::span<std::byte const> const bytes = optFile->bytes();
+
+		MeshFileHeader header;
+		if (bytes.size() < sizeof(header)) return std::nullopt;
+		std::memcpy(&header, bytes.data(), sizeof(header));
+
+		std::size_t const expected = sizeof(header) + std::size_t(header.vertexBytes) + header.indexBytes + header.positionBytes + std::size_t(header.meshletCount) * sizeof(Meshlet);
+
+		// Everything `Mesh` hands to the gpu unchecked, the counts size draws and the meshlets index the cull shader's buffers
+		bool valid = std::memcmp(header.magic, MeshFileHeader().magic, sizeof(header.magic)) == 0 && bytes.size() == expected;
+		valid = valid && header.positionFormat <= std::uint8_t(PositionFormat::Unorm16x4) && header.textureCoordFormat <= std::uint8_t(TextureCoordFormat::Half2);
+		valid = valid && (header.indexSize == 2 || header.indexSize == 4) && std::uint64_t(header.indexCount) * header.indexSize <= header.indexBytes;
+
+		MeshData data;
+		data.format.position = static_cast<PositionFormat>(header.positionFormat);
+		data.format.textureCoord = static_cast<TextureCoordFormat>(header.textureCoordFormat);
+
+		valid = valid && std::uint64_t(header.vertexCount) * data.format.stride() == header.vertexBytes;
+		valid = valid && (header.positionBytes == 0 || std::uint64_t(header.vertexCount) * data.format.position_stride() == header.positionBytes);
+
+		if (valid) {
+			std::byte const* meshlets = bytes.data() + sizeof(header) + header.vertexBytes + header.indexBytes + header.positionBytes;
+			for (std::size_t i = 0; valid && i < header.meshletCount; ++i) {
+				Meshlet meshlet;
+				std::memcpy(&meshlet, meshlets + i * sizeof(Meshlet), sizeof(Meshlet));
+				valid = meshlet.triangleCount <= kMeshletMaxTriangles && std::uint64_t(meshlet.firstIndex) + std::uint64_t(meshlet.triangleCount) * 3 <= header.indexCount;
+			}
+		}
+
+		if (!valid) {
+			spdlog::error("`{}` is not a mesh", aPath.string());
+			return std::nullopt;
+		}
+		std::memcpy(&data.dequantizeOffset, header.dequantizeOffset, sizeof(header.dequantizeOffset));
+		data.dequantizeScale = header.dequantizeScale;
+		std::memcpy(&data.boundingSphere, header.boundingSphere, sizeof(header.boundingSphere));
+		data.vertexCount = header.vertexCount;
+		data.indexCount = header.indexCount;
+		data.indexSize = header.indexSize;
+
+		std::byte const* cursor = bytes.data() + sizeof(header);
+		auto take = [&](std::size_t aSize) {
+			std::vector<std::byte> bytes(cursor, cursor + aSize);
+			cursor += aSize;
+			return bytes;
+		};
+
+		data.vertices = take(header.vertexBytes);
+		data.indices = take(header.indexBytes);
+		data.positions = take(header.positionBytes);
+		data.meshlets.resize(header.meshletCount);
+		std::memcpy(data.meshlets.data(), cursor, data.meshlets.size() * sizeof(Meshlet));
+
+		return data;
+	}
+
+	bool cook_mesh(std::filesystem::path const& aSource, std::filesystem::path const& aDestination) {
+		auto optData = import_mesh(aSource);
+		return optData && write_mesh_data(aDestination, *optData);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "rvo_mesh_data.hpp"
+
+#include <filesystem>
+#include <optional>
+
+namespace rvo {
+	// Imports a ply, optimizes it and encodes it the way `Mesh` uploads it, meshlets included for large meshes
+	std::optional<MeshData> import_mesh(std::filesystem::path const& aSource);
+
+	// `.rvomesh` is a header followed by the MeshData arrays, loading it is a few reads and no processing
+	bool write_mesh_data(std::filesystem::path const& aPath, MeshData const& aData);
+	std::optional<MeshData> read_mesh_data(std::filesystem::path const& aPath);
+
+	bool cook_mesh(std::filesystem::path const& aSource, std::filesystem::path const& aDestination);
+}
\ No newline at end of file
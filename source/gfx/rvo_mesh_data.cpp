@@ -0,0 +1,152 @@
+#include "rvo_mesh_data.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <cstring>
+#include <limits>
+
+namespace rvo {
+	namespace {
+		// Quantization must never move a vertex further than this, in mesh units
+		constexpr float kMaxPositionError = 0.002f;
+		// Half of a texel on a 1024 texture
+		constexpr float kMaxTextureCoordError = 1.0f / 2048.0f;
+
+		template<typename T>
+		void write(std::byte* aDestination, T const& aValue) {
+			std::memcpy(aDestination, &aValue, sizeof(T));
+		}
+
+		std::int16_t pack_snorm16(float aValue) {
+			return static_cast<std::int16_t>(glm::round(glm::clamp(aValue, -1.0f, 1.0f) * 32767.0f));
+		}
+
+		std::uint16_t pack_unorm16(float aValue) {
+			return static_cast<std::uint16_t>(glm::round(glm::clamp(aValue, 0.0f, 1.0f) * 65535.0f));
+		}
+	}
+
+	glm::mat4 MeshData::dequantize_transform() const {
+		if (format.position == PositionFormat::Float3) return glm::mat4(1.0f);
+		return glm::scale(glm::translate(glm::mat4(1.0f), dequantizeOffset), glm::vec3(dequantizeScale));
+	}
+
+	glm::vec2 oct_encode(glm::vec3 aNormal) {
+		aNormal /= glm::abs(aNormal.x) + glm::abs(aNormal.y) + glm::abs(aNormal.z);
+		glm::vec2 result = glm::vec2(aNormal.x, aNormal.y);
+
+		if (aNormal.z < 0.0f) {
+			result.x = (1.0f - glm::abs(aNormal.y)) * (aNormal.x >= 0.0f ? 1.0f : -1.0f);
+			result.y = (1.0f - glm::abs(aNormal.x)) * (aNormal.y >= 0.0f ? 1.0f : -1.0f);
+		}
+
+		return result;
+	}
+
+	glm::vec3 oct_decode(glm::vec2 aEncoded) {
+		glm::vec3 normal = glm::vec3(aEncoded.x, aEncoded.y, 1.0f - glm::abs(aEncoded.x) - glm::abs(aEncoded.y));
+		float const t = glm::max(-normal.z, 0.0f);
+		normal.x += normal.x >= 0.0f ? -t : t;
+		normal.y += normal.y >= 0.0f ? -t : t;
+		return glm::normalize(normal);
+	}
+
+	MeshData encode_mesh(std::span<StandardVertex const> aVertices, std::span<std::uint32_t const> aIndices, bool aPositionStream) {
+		MeshData data;
+		data.vertexCount = static_cast<std::uint32_t>(aVertices.size());
+		data.indexCount = static_cast<std::uint32_t>(aIndices.size());
+
+		// Pick the smallest formats which stay within the error bounds
+		glm::vec3 minimum = glm::vec3(std::numeric_limits<float>::max());
+		glm::vec3 maximum = glm::vec3(std::numeric_limits<float>::lowest());
+		bool halfTextureCoords = true;
+
+		for (auto const& vertex : aVertices) {
+			minimum = glm::min(minimum, vertex.position);
+			maximum = glm::max(maximum, vertex.position);
+
+			for (int i = 0; i < 2; ++i) {
+				float const roundTrip = glm::unpackHalf1x16(glm::packHalf1x16(vertex.textureCoord[i]));
+				if (glm::abs(roundTrip - vertex.textureCoord[i]) > kMaxTextureCoordError) halfTextureCoords = false;
+			}
+		}
+
+		if (!aVertices.empty()) {
+			glm::vec3 const center = (minimum + maximum) * 0.5f;
+			float radius = 0.0f;
+			for (auto const& vertex : aVertices) radius = glm::max(radius, glm::distance(center, vertex.position));
+			data.boundingSphere = glm::vec4(center, radius);
+
+			glm::vec3 const extent = maximum - minimum;
+			float const scale = glm::max(extent.x, glm::max(extent.y, extent.z));
+
+			if (scale / 65535.0f * 0.5f <= kMaxPositionError) {
+				data.format.position = PositionFormat::Unorm16x4;
+				data.dequantizeOffset = minimum;
+				data.dequantizeScale = scale > 0.0f ? scale : 1.0f;
+			}
+		}
+
+		if (halfTextureCoords) {
+			data.format.textureCoord = TextureCoordFormat::Half2;
+		}
+
+		std::uint32_t const stride = data.format.stride();
+		data.vertices.resize(static_cast<std::size_t>(stride) * aVertices.size());
+
+		for (std::size_t i = 0; i < aVertices.size(); ++i) {
+			auto const& vertex = aVertices[i];
+			std::byte* destination = data.vertices.data() + i * stride;
+
+			if (data.format.position == PositionFormat::Float3) {
+				write(destination + data.format.position_offset(), vertex.position);
+			}
+			else {
+				glm::vec3 const normalized = (vertex.position - data.dequantizeOffset) / data.dequantizeScale;
+				std::uint16_t const packed[4] = { pack_unorm16(normalized.x), pack_unorm16(normalized.y), pack_unorm16(normalized.z), 0 };
+				write(destination + data.format.position_offset(), packed);
+			}
+
+			glm::vec2 const octahedral = oct_encode(vertex.normal);
+			std::int16_t const normal[2] = { pack_snorm16(octahedral.x), pack_snorm16(octahedral.y) };
+			write(destination + data.format.normal_offset(), normal);
+
+			if (data.format.textureCoord == TextureCoordFormat::Float2) {
+				write(destination + data.format.texture_coord_offset(), vertex.textureCoord);
+			}
+			else {
+				std::uint16_t const packed[2] = { glm::packHalf1x16(vertex.textureCoord.x), glm::packHalf1x16(vertex.textureCoord.y) };
+				write(destination + data.format.texture_coord_offset(), packed);
+			}
+		}
+
+		if (aPositionStream) {
+			std::uint32_t const positionStride = data.format.position_stride();
+			data.positions.resize(static_cast<std::size_t>(positionStride) * aVertices.size());
+
+			for (std::size_t i = 0; i < aVertices.size(); ++i) {
+				std::memcpy(data.positions.data() + i * positionStride, data.vertices.data() + i * stride + data.format.position_offset(), positionStride);
+			}
+		}
+
+		if (aVertices.size() <= std::numeric_limits<std::uint16_t>::max() + std::size_t(1)) {
+			data.indexSize = sizeof(std::uint16_t);
+			data.indices.resize(aIndices.size() * sizeof(std::uint16_t));
+
+			for (std::size_t i = 0; i < aIndices.size(); ++i) {
+				write(data.indices.data() + i * sizeof(std::uint16_t), static_cast<std::uint16_t>(aIndices[i]));
+			}
+		}
+		else {
+			data.indexSize = sizeof(std::uint32_t);
+			data.indices.resize(aIndices.size_bytes());
+			std::memcpy(data.indices.data(), aIndices.data(), aIndices.size_bytes());
+		}
+
+		// Keep the buffer a whole number of words, meshlet culling reads it as a uint array
+		data.indices.resize((data.indices.size() + 3) & ~std::size_t(3));
+
+		return data;
+	}
+}
\ No newline at end of file
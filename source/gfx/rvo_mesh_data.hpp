@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <span>
+#include <cstddef>
+#include <cstdint>
+
+namespace rvo {
+	// Import format, see `MeshData` for what ends up on the gpu
+	struct StandardVertex final {
+		glm::vec3 position;
+		glm::vec3 normal;
+		glm::vec2 textureCoord;
+	};
+
+	enum class PositionFormat : std::uint8_t {
+		Float3,
+		Unorm16x4, // Relative to the mesh bounds, w is padding. See `MeshData::dequantize_transform`
+	};
+
+	enum class TextureCoordFormat : std::uint8_t {
+		Float2,
+		Half2,
+	};
+
+	// Normals are always octahedral encoded into snorm16x2
+	struct VertexFormat final {
+		PositionFormat position = PositionFormat::Float3;
+		TextureCoordFormat textureCoord = TextureCoordFormat::Float2;
+
+		std::uint32_t position_offset() const noexcept { return 0; }
+		std::uint32_t normal_offset() const noexcept { return position == PositionFormat::Float3 ? 12 : 8; }
+		std::uint32_t texture_coord_offset() const noexcept { return normal_offset() + 4; }
+		std::uint32_t stride() const noexcept { return texture_coord_offset() + (textureCoord == TextureCoordFormat::Float2 ? 8 : 4); }
+		std::uint32_t position_stride() const noexcept { return normal_offset(); }
+	};
+
+	// Contiguous run of triangles in the index buffer, layout matches shaders/meshlet_cull.glsl (std430)
+	struct Meshlet final {
+		glm::vec4 sphere; // xyz center, w radius
+		glm::vec4 cone; // xyz axis, w cutoff. Backfacing when `dot(center - eye, axis) >= cutoff * length(center - eye) + radius`
+		std::uint32_t firstIndex;
+		std::uint32_t triangleCount;
+		std::uint32_t _padding[2];
+	};
+
+	static_assert(sizeof(Meshlet) == 48);
+
+	// Gpu ready mesh, the format is picked per mesh based on how much precision it needs
+	struct MeshData final {
+		VertexFormat format;
+		glm::vec3 dequantizeOffset = glm::vec3(0.0f);
+		float dequantizeScale = 1.0f;
+		glm::vec4 boundingSphere = glm::vec4(0.0f); // xyz center, w radius, in mesh space
+
+		std::uint32_t vertexCount = 0;
+		std::uint32_t indexCount = 0;
+		std::uint32_t indexSize = sizeof(std::uint32_t);
+		std::vector<std::byte> vertices;
+		std::vector<std::byte> indices;
+		std::vector<std::byte> positions; // Optional de-interleaved copy of the positions for depth only passes
+		std::vector<Meshlet> meshlets; // Optional, see `build_meshlets`
+
+		// Maps quantized positions back into mesh space, identity for float positions
+		// The scale is uniform so `mat3(transform)` can still be used on normals
+		glm::mat4 dequantize_transform() const;
+	};
+
+	glm::vec2 oct_encode(glm::vec3 aNormal);
+	glm::vec3 oct_decode(glm::vec2 aEncoded);
+
+	MeshData encode_mesh(std::span<StandardVertex const> aVertices, std::span<std::uint32_t const> aIndices, bool aPositionStream = true);
+}
\ No newline at end of file
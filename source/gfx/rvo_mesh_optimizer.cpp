@@ -0,0 +1,414 @@
+#include "rvo_mesh_optimizer.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+
+namespace rvo {
+	namespace {
+		// Clusters are split further once their local ACMR drops to this, splitting costs at most one cache refill
+		constexpr float kOverdrawSplitAcmr = 0.75f;
+		constexpr std::size_t kOverdrawMinClusterTriangles = 64;
+
+		struct VertexBitsHash final {
+			std::size_t operator()(StandardVertex const& aVertex) const noexcept {
+				// FNV-1a over the raw bytes, StandardVertex has no padding
+				auto const* bytes = reinterpret_cast<unsigned char const*>(&aVertex);
+				std::size_t hash = 14695981039346656037ull;
+				for (std::size_t i = 0; i < sizeof(StandardVertex); ++i) {
+					hash ^= bytes[i];
+					hash *= 1099511628211ull;
+				}
+				return hash;
+			}
+		};
+
+		struct VertexBitsEqual final {
+			bool operator()(StandardVertex const& aLhs, StandardVertex const& aRhs) const noexcept {
+				return std::memcmp(&aLhs, &aRhs, sizeof(StandardVertex)) == 0;
+			}
+		};
+	}
+
+	float analyze_acmr(std::span<std::uint32_t const> aIndices, std::size_t aVertexCount, unsigned aCacheSize) {
+		if (aIndices.size() < 3) return 0.0f;
+
+		std::vector<std::uint32_t> cacheTime(aVertexCount, 0);
+		std::uint32_t time = aCacheSize + 1;
+		std::size_t misses = 0;
+
+		for (std::uint32_t index : aIndices) {
+			if (time - cacheTime[index] > aCacheSize) {
+				cacheTime[index] = time++;
+				++misses;
+			}
+		}
+
+		return static_cast<float>(misses) / static_cast<float>(aIndices.size() / 3);
+	}
+
+	void weld_vertices(std::vector<StandardVertex>& aVertices, std::span<std::uint32_t> aIndices) {
+		std::unordered_map<StandardVertex, std::uint32_t, VertexBitsHash, VertexBitsEqual> unique;
+		unique.reserve(aVertices.size());
+
+		std::vector<std::uint32_t> remap(aVertices.size());
+		std::vector<StandardVertex> welded;
+		welded.reserve(aVertices.size());
+
+		for (std::size_t i = 0; i < aVertices.size(); ++i) {
+			auto [it, inserted] = unique.try_emplace(aVertices[i], static_cast<std::uint32_t>(welded.size()));
+			if (inserted) welded.push_back(aVertices[i]);
+			remap[i] = it->second;
+		}
+
+		for (auto& index : aIndices) {
+			index = remap[index];
+		}
+
+		aVertices = std::move(welded);
+	}
+
+	std::vector<std::uint32_t> optimize_vertex_cache(std::span<std::uint32_t const> aIndices, std::size_t aVertexCount, unsigned aCacheSize, std::vector<std::size_t>* aClusters) {
+		std::vector<std::uint32_t> result;
+		result.reserve(aIndices.size());
+
+		if (aClusters) aClusters->assign(1, 0);
+		if (aIndices.empty() || aVertexCount == 0) return result;
+
+		// Vertex to triangle adjacency, stored compressed
+		std::vector<std::uint32_t> liveCount(aVertexCount, 0);
+		for (std::uint32_t index : aIndices) ++liveCount[index];
+
+		std::vector<std::uint32_t> offsets(aVertexCount + 1, 0);
+		for (std::size_t v = 0; v < aVertexCount; ++v) offsets[v + 1] = offsets[v] + liveCount[v];
+
+		std::vector<std::uint32_t> adjacency(aIndices.size());
+		{
+			std::vector<std::uint32_t> cursor(offsets.begin(), offsets.end() - 1);
+			for (std::size_t i = 0; i < aIndices.size(); ++i) {
+				adjacency[cursor[aIndices[i]]++] = static_cast<std::uint32_t>(i / 3);
+			}
+		}
+
+		std::vector<std::uint32_t> cacheTime(aVertexCount, 0);
+		std::vector<bool> emitted(aIndices.size() / 3, false);
+		std::vector<std::uint32_t> deadEnd;
+		std::vector<std::uint32_t> candidates;
+		deadEnd.reserve(aIndices.size());
+
+		std::uint32_t time = aCacheSize + 1;
+		std::size_t scanCursor = 0;
+		std::int64_t fanning = 0;
+
+		while (fanning >= 0) {
+			std::uint32_t const f = static_cast<std::uint32_t>(fanning);
+			candidates.clear();
+
+			// Emit every remaining triangle around the fanning vertex
+			for (std::uint32_t a = offsets[f]; a < offsets[f + 1]; ++a) {
+				std::uint32_t const triangle = adjacency[a];
+				if (emitted[triangle]) continue;
+
+				for (std::uint32_t k = 0; k < 3; ++k) {
+					std::uint32_t const v = aIndices[triangle * 3 + k];
+					result.push_back(v);
+					deadEnd.push_back(v);
+					candidates.push_back(v);
+					--liveCount[v];
+
+					if (time - cacheTime[v] > aCacheSize) {
+						cacheTime[v] = time++;
+					}
+				}
+
+				emitted[triangle] = true;
+			}
+
+			// Prefer a candidate which will still be in the cache once its fan is emitted, oldest first
+			std::int64_t next = -1;
+			std::int64_t bestPriority = -1;
+
+			for (std::uint32_t v : candidates) {
+				if (liveCount[v] == 0) continue;
+
+				std::int64_t priority = 0;
+				if (time - cacheTime[v] + 2 * liveCount[v] <= aCacheSize) {
+					priority = time - cacheTime[v];
+				}
+
+				if (priority > bestPriority) {
+					bestPriority = priority;
+					next = v;
+				}
+			}
+
+			if (next == -1) {
+				// Dead end, try recently emitted vertices first
+				while (!deadEnd.empty()) {
+					std::uint32_t const v = deadEnd.back();
+					deadEnd.pop_back();
+
+					if (liveCount[v] > 0) {
+						next = v;
+						break;
+					}
+				}
+			}
+
+			if (next == -1) {
+				// Nothing local remains, jump elsewhere in the mesh. The cache is effectively cold so this is a cluster boundary
+				while (scanCursor < aVertexCount && liveCount[scanCursor] == 0) ++scanCursor;
+
+				if (scanCursor < aVertexCount) {
+					next = static_cast<std::int64_t>(scanCursor);
+					if (aClusters && aClusters->back() != result.size() / 3) aClusters->push_back(result.size() / 3);
+				}
+			}
+
+			fanning = next;
+		}
+
+		return result;
+	}
+
+	void optimize_overdraw(std::span<std::uint32_t> aIndices, std::span<StandardVertex const> aVertices, std::span<std::size_t const> aClusters) {
+		std::size_t const triangleCount = aIndices.size() / 3;
+		if (triangleCount == 0) return;
+
+		// Split the hard clusters wherever the cache is warm enough that a restart costs little
+		std::vector<std::size_t> clusters;
+		{
+			std::vector<std::uint32_t> cacheTime(aVertices.size(), 0);
+			std::uint32_t time = kVertexCacheSize + 1;
+
+			for (std::size_t c = 0; c < aClusters.size(); ++c) {
+				std::size_t const end = c + 1 < aClusters.size() ? aClusters[c + 1] : triangleCount;
+				std::size_t start = aClusters[c];
+				std::size_t misses = 0;
+
+				clusters.push_back(start);
+				time += kVertexCacheSize + 1; // Flush
+
+				for (std::size_t t = start; t < end; ++t) {
+					for (std::size_t k = 0; k < 3; ++k) {
+						std::uint32_t const v = aIndices[t * 3 + k];
+						if (time - cacheTime[v] > kVertexCacheSize) {
+							cacheTime[v] = time++;
+							++misses;
+						}
+					}
+
+					std::size_t const length = t + 1 - start;
+					if (t + 1 < end && length >= kOverdrawMinClusterTriangles && static_cast<float>(misses) <= kOverdrawSplitAcmr * static_cast<float>(length)) {
+						start = t + 1;
+						misses = 0;
+						clusters.push_back(start);
+						time += kVertexCacheSize + 1;
+					}
+				}
+			}
+		}
+
+		struct Cluster final {
+			std::size_t start;
+			std::size_t end;
+			glm::vec3 centroid;
+			glm::vec3 normal;
+			float sortKey;
+		};
+
+		std::vector<Cluster> sorted;
+		sorted.reserve(clusters.size());
+
+		glm::vec3 meshCentroid = glm::vec3(0.0f);
+		float meshArea = 0.0f;
+
+		for (std::size_t i = 0; i < clusters.size(); ++i) {
+			Cluster cluster{};
+			cluster.start = clusters[i];
+			cluster.end = i + 1 < clusters.size() ? clusters[i + 1] : triangleCount;
+			cluster.centroid = glm::vec3(0.0f);
+			cluster.normal = glm::vec3(0.0f);
+
+			float area = 0.0f;
+
+			for (std::size_t t = cluster.start; t < cluster.end; ++t) {
+				glm::vec3 const& a = aVertices[aIndices[t * 3 + 0]].position;
+				glm::vec3 const& b = aVertices[aIndices[t * 3 + 1]].position;
+				glm::vec3 const& c = aVertices[aIndices[t * 3 + 2]].position;
+
+				// Length of the cross product is twice the area, the factor cancels out
+				glm::vec3 const normal = glm::cross(b - a, c - a);
+				float const triangleArea = glm::length(normal);
+
+				cluster.centroid += (a + b + c) * (triangleArea / 3.0f);
+				cluster.normal += normal;
+				area += triangleArea;
+			}
+
+			meshCentroid += cluster.centroid;
+			meshArea += area;
+
+			cluster.centroid = area > 0.0f ? cluster.centroid / area : aVertices[aIndices[cluster.start * 3]].position;
+			sorted.push_back(cluster);
+		}
+
+		if (meshArea > 0.0f) meshCentroid /= meshArea;
+
+		// Clusters facing away from the center are likely occluders, draw those first
+		for (auto& cluster : sorted) {
+			float const normalLength = glm::length(cluster.normal);
+			cluster.sortKey = normalLength > 0.0f ? glm::dot(cluster.centroid - meshCentroid, cluster.normal / normalLength) : 0.0f;
+		}
+
+		std::stable_sort(sorted.begin(), sorted.end(), [](Cluster const& aLhs, Cluster const& aRhs) { return aLhs.sortKey > aRhs.sortKey; });
+
+		std::vector<std::uint32_t> result;
+		result.reserve(aIndices.size());
+
+		for (auto const& cluster : sorted) {
+			result.insert(result.end(), aIndices.begin() + cluster.start * 3, aIndices.begin() + cluster.end * 3);
+		}
+
+		std::copy(result.begin(), result.end(), aIndices.begin());
+	}
+
+	void optimize_vertex_fetch(std::vector<StandardVertex>& aVertices, std::span<std::uint32_t> aIndices) {
+		constexpr std::uint32_t kUnassigned = ~std::uint32_t(0);
+
+		std::vector<std::uint32_t> remap(aVertices.size(), kUnassigned);
+		std::vector<StandardVertex> reordered;
+		reordered.reserve(aVertices.size());
+
+		for (auto& index : aIndices) {
+			if (remap[index] == kUnassigned) {
+				remap[index] = static_cast<std::uint32_t>(reordered.size());
+				reordered.push_back(aVertices[index]);
+			}
+
+			index = remap[index];
+		}
+
+		aVertices = std::move(reordered);
+	}
+
+	MeshOptimizationStats optimize_mesh(std::vector<StandardVertex>& aVertices, std::vector<std::uint32_t>& aIndices) {
+		MeshOptimizationStats stats;
+		stats.verticesBefore = aVertices.size();
+		stats.acmrBefore = analyze_acmr(aIndices, aVertices.size());
+
+		weld_vertices(aVertices, aIndices);
+
+		std::vector<std::size_t> clusters;
+		aIndices = optimize_vertex_cache(aIndices, aVertices.size(), kVertexCacheSize, &clusters);
+		optimize_overdraw(aIndices, aVertices, clusters);
+		optimize_vertex_fetch(aVertices, aIndices);
+
+		stats.verticesAfter = aVertices.size();
+		stats.acmrAfter = analyze_acmr(aIndices, aVertices.size());
+		return stats;
+	}
+
+	std::vector<Meshlet> build_meshlets(std::span<StandardVertex const> aVertices, std::span<std::uint32_t const> aIndices) {
+		std::vector<Meshlet> meshlets;
+		std::size_t const triangleCount = aIndices.size() / 3;
+
+		auto emit = [&](std::size_t aStart, std::size_t aEnd) {
+			Meshlet meshlet{};
+			meshlet.firstIndex = static_cast<std::uint32_t>(aStart * 3);
+			meshlet.triangleCount = static_cast<std::uint32_t>(aEnd - aStart);
+
+			glm::vec3 minimum = aVertices[aIndices[aStart * 3]].position;
+			glm::vec3 maximum = minimum;
+
+			for (std::size_t i = aStart * 3; i < aEnd * 3; ++i) {
+				minimum = glm::min(minimum, aVertices[aIndices[i]].position);
+				maximum = glm::max(maximum, aVertices[aIndices[i]].position);
+			}
+
+			glm::vec3 const center = (minimum + maximum) * 0.5f;
+			float radius = 0.0f;
+
+			for (std::size_t i = aStart * 3; i < aEnd * 3; ++i) {
+				radius = glm::max(radius, glm::length(aVertices[aIndices[i]].position - center));
+			}
+
+			// Normal cone, the axis is the average facing and the cutoff the widest deviation from it
+			glm::vec3 axis = glm::vec3(0.0f);
+			std::vector<glm::vec3> normals;
+			normals.reserve(aEnd - aStart);
+
+			for (std::size_t t = aStart; t < aEnd; ++t) {
+				glm::vec3 const& a = aVertices[aIndices[t * 3 + 0]].position;
+				glm::vec3 const& b = aVertices[aIndices[t * 3 + 1]].position;
+				glm::vec3 const& c = aVertices[aIndices[t * 3 + 2]].position;
+
+				glm::vec3 const normal = glm::cross(b - a, c - a);
+				float const length = glm::length(normal);
+				if (length <= 0.0f) continue;
+
+				normals.push_back(normal / length);
+				axis += normals.back();
+			}
+
+			float const axisLength = glm::length(axis);
+			float cutoff = 1.0f; // Never culled
+
+			if (axisLength > 0.0f) {
+				axis /= axisLength;
+
+				float minimumDot = 1.0f;
+				for (auto const& normal : normals) minimumDot = glm::min(minimumDot, glm::dot(axis, normal));
+
+				// Too wide to ever be fully backfacing
+				if (minimumDot > 0.1f) {
+					cutoff = glm::sqrt(1.0f - minimumDot * minimumDot);
+				}
+			}
+
+			meshlet.sphere = glm::vec4(center, radius);
+			meshlet.cone = glm::vec4(axis, cutoff);
+			meshlets.push_back(meshlet);
+		};
+
+		// Greedy, a new meshlet starts whenever the next triangle would overflow the limits
+		std::vector<std::size_t> lastMeshlet(aVertices.size(), ~std::size_t(0));
+		std::size_t start = 0;
+		std::size_t vertexCount = 0;
+
+		for (std::size_t t = 0; t < triangleCount; ++t) {
+			auto count_new = [&]() {
+				std::size_t count = 0;
+				for (std::size_t k = 0; k < 3; ++k) {
+					std::uint32_t const v = aIndices[t * 3 + k];
+					bool const repeated = (k > 0 && aIndices[t * 3] == v) || (k > 1 && aIndices[t * 3 + 1] == v);
+					if (lastMeshlet[v] != meshlets.size() && !repeated) ++count;
+				}
+				return count;
+			};
+
+			std::size_t newVertices = count_new();
+
+			if (vertexCount + newVertices > kMeshletMaxVertices || t - start >= kMeshletMaxTriangles) {
+				emit(start, t);
+				start = t;
+				vertexCount = 0;
+				newVertices = count_new();
+			}
+
+			for (std::size_t k = 0; k < 3; ++k) {
+				lastMeshlet[aIndices[t * 3 + k]] = meshlets.size();
+			}
+
+			vertexCount += newVertices;
+		}
+
+		if (start < triangleCount) {
+			emit(start, triangleCount);
+		}
+
+		return meshlets;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "rvo_mesh_data.hpp"
+
+#include <vector>
+#include <span>
+#include <cstddef>
+#include <cstdint>
+
+namespace rvo {
+	// Size of the simulated FIFO post-transform cache, used both for optimization and ACMR reports
+	inline constexpr unsigned kVertexCacheSize = 16;
+
+	inline constexpr std::size_t kMeshletMaxVertices = 64;
+	inline constexpr std::size_t kMeshletMaxTriangles = 124;
+	// Smaller meshes are culled per object, meshlets would only add overhead
+	inline constexpr std::size_t kMeshletMinTriangles = kMeshletMaxTriangles * 16;
+
+	struct MeshOptimizationStats final {
+		std::size_t verticesBefore = 0;
+		std::size_t verticesAfter = 0;
+		float acmrBefore = 0.0f;
+		float acmrAfter = 0.0f;
+	};
+
+	// Average cache miss ratio, transformed vertices per triangle. 0.5 is ideal for large grids, 3.0 is the worst case
+	float analyze_acmr(std::span<std::uint32_t const> aIndices, std::size_t aVertexCount, unsigned aCacheSize = kVertexCacheSize);
+
+	// Merges bitwise identical vertices, indices are rewritten to reference the surviving vertex
+	void weld_vertices(std::vector<StandardVertex>& aVertices, std::span<std::uint32_t> aIndices);
+
+	// Tipsify (Sander et al. 2007), returns the reordered indices
+	// When aClusters is provided it receives the starting triangle of each cluster, clusters break wherever the cache had to be flushed
+	std::vector<std::uint32_t> optimize_vertex_cache(std::span<std::uint32_t const> aIndices, std::size_t aVertexCount, unsigned aCacheSize = kVertexCacheSize, std::vector<std::size_t>* aClusters = nullptr);
+
+	// Sorts the clusters produced by `optimize_vertex_cache` so outward facing clusters are drawn first
+	void optimize_overdraw(std::span<std::uint32_t> aIndices, std::span<StandardVertex const> aVertices, std::span<std::size_t const> aClusters);
+
+	// Reorders vertices by first use in the index buffer, unreferenced vertices are dropped
+	void optimize_vertex_fetch(std::vector<StandardVertex>& aVertices, std::span<std::uint32_t> aIndices);
+
+	// Splits the index buffer into runs of at most kMeshletMaxVertices unique vertices and kMeshletMaxTriangles triangles
+	// Run this after `optimize_mesh`, the cache order keeps the runs compact
+	std::vector<Meshlet> build_meshlets(std::span<StandardVertex const> aVertices, std::span<std::uint32_t const> aIndices);
+
+	// Runs all of the above in order, except meshlets
+	MeshOptimizationStats optimize_mesh(std::vector<StandardVertex>& aVertices, std::vector<std::uint32_t>& aIndices);
+}
\ No newline at end of file
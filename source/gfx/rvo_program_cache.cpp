@@ -0,0 +1,81 @@
+#include "rvo_program_cache.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <cstring>
+#include <fstream>
+#include <string_view>
+
+namespace rvo {
+	namespace {
+		struct ProgramCacheHeader final {
+			char magic[4] = { 'R', 'V', 'P', '1' };
+			std::uint32_t format = 0;
+			std::uint64_t key = 0;
+		};
+
+		static_assert(sizeof(ProgramCacheHeader) == 16);
+
+		// Between the hashed strings so moving text from one stage to the next changes the key
+		constexpr std::string_view kSeparator("\0", 1);
+
+		std::string_view gl_string(GLenum aName) {
+			auto const string = reinterpret_cast<char const*>(glGetString(aName));
+			return string ? string : "";
+		}
+	}
+
+	std::uint64_t program_cache_key(ShaderSource const& aSource) {
+		std::uint64_t hash = fnv1a(gl_string(GL_RENDERER));
+		hash = fnv1a(gl_string(GL_VERSION), fnv1a(kSeparator, hash));
+		hash = fnv1a(aSource.vertex, fnv1a(kSeparator, hash));
+		hash = fnv1a(aSource.fragment, fnv1a(kSeparator, hash));
+		hash = fnv1a(aSource.compute, fnv1a(kSeparator, hash));
+		return hash;
+	}
+
+	std::filesystem::path program_cache_path(std::filesystem::path const& aSource, std::uint64_t aKeywords) {
+		std::filesystem::path path = "cache/programs" / aSource.relative_path();
+		if (aKeywords) path += fmt::format(".{:x}", aKeywords);
+		path += ".rvoprogram";
+		return path;
+	}
+
+	std::optional<ShaderProgram> load_cached_program(std::filesystem::path const& aPath, std::uint64_t aKey) {
+		MappedFile const file(aPath);
+		if (!file) return std::nullopt;
+
+		std::span<std::byte const> const bytes = file.bytes();
+
+		ProgramCacheHeader header;
+		if (bytes.size() <= sizeof(header)) return std::nullopt;
+		std::memcpy(&header, bytes.data(), sizeof(header));
+
+		if (std::memcmp(header.magic, ProgramCacheHeader().magic, sizeof(header.magic)) != 0 || header.key != aKey) return std::nullopt;
+
+		auto program = ShaderProgram::from_binary(header.format, bytes.subspan(sizeof(header)));
+		if (!program) spdlog::info("Driver rejected cached program `{}`, recompiling", aPath.generic_string());
+		return program;
+	}
+
+	void store_cached_program(std::filesystem::path const& aPath, std::uint64_t aKey, ShaderProgram const& aProgram) {
+		auto optBinary = aProgram.binary();
+		if (!optBinary) return;
+
+		std::error_code error;
+		std::filesystem::create_directories(aPath.parent_path(), error);
+
+		std::ofstream stream(aPath, std::ios::binary);
+		if (!stream) {
+			spdlog::warn("Failed to open `{}` for writing", aPath.generic_string());
+			return;
+		}
+
+		ProgramCacheHeader header;
+		header.format = optBinary->format;
+		header.key = aKey;
+
+		stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+		stream.write(reinterpret_cast<char const*>(optBinary->data.data()), optBinary->data.size());
+	}
+}
\ No newline at end of file
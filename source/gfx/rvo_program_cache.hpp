@@ -0,0 +1,23 @@
+#pragma once
+
+#include "rvo_shader.hpp"
+#include "rvo_shader_cook.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+
+namespace rvo {
+	// Linked programs saved with `glGetProgramBinary` so warm starts skip compiling and linking
+	// Binaries only load on the driver that made them, so they live in `cache/` and are never cooked or packed
+
+	// Hash of every preprocessed stage together with GL_RENDERER and GL_VERSION, requires a current context
+	std::uint64_t program_cache_key(ShaderSource const& aSource);
+
+	// `cache/programs/<aSource>.rvoprogram`, permutations add their keyword mask in hex before the extension
+	std::filesystem::path program_cache_path(std::filesystem::path const& aSource, std::uint64_t aKeywords = 0);
+
+	// nullopt when the entry is missing, was made for another key or is rejected by the driver
+	std::optional<ShaderProgram> load_cached_program(std::filesystem::path const& aPath, std::uint64_t aKey);
+	void store_cached_program(std::filesystem::path const& aPath, std::uint64_t aKey, ShaderProgram const& aProgram);
+}
\ No newline at end of file
@@ -3,34 +3,79 @@
 #include <spdlog/spdlog.h>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
+
 #ifdef _WIN32
 #	include <Windows.h>
 #endif
 
 namespace rvo {
-	Shader::Shader(GLenum aType, std::string_view aSource) {
-		char const* cString = aSource.data();
-		GLint cLength = static_cast<GLint>(aSource.size());
+	namespace {
+		// From `GL_KHR_parallel_shader_compile`, the glad loader is generated without extensions
+		constexpr GLenum kCompletionStatus = 0x91B1;
 
-		mHandle = glCreateShader(aType);
-		glShaderSource(mHandle, 1, &cString, &cLength);
-		glCompileShader(mHandle);
+		bool gParallelShaderCompile = false;
+
+		bool has_extension(std::string_view aName) {
+			GLint count = 0;
+			glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+			for (GLint i = 0; i < count; ++i) {
+				if (reinterpret_cast<char const*>(glGetStringi(GL_EXTENSIONS, i)) == aName) return true;
+			}
+
+			return false;
+		}
 
-		GLint logLength;
-		glGetShaderiv(mHandle, GL_INFO_LOG_LENGTH, &logLength);
+		// Logs and returns false when aHandle failed, aStatus is GL_COMPILE_STATUS for shaders and GL_LINK_STATUS for programs
+		bool report_errors(GLuint aHandle, GLenum aStatus, PFNGLGETSHADERIVPROC aGetIv, PFNGLGETSHADERINFOLOGPROC aGetLog) {
+			GLint status = GL_FALSE;
+			aGetIv(aHandle, aStatus, &status);
 
-		if (logLength > 0) {
-			std::vector<GLchar> data(logLength);
+			GLint logLength;
+			aGetIv(aHandle, GL_INFO_LOG_LENGTH, &logLength);
 
-			glGetShaderInfoLog(mHandle, static_cast<GLsizei>(data.size()), nullptr, data.data());
-			spdlog::error("{}", data.data());
+			if (logLength > 0) {
+				std::vector<GLchar> data(logLength);
+
+				aGetLog(aHandle, static_cast<GLsizei>(data.size()), nullptr, data.data());
+				spdlog::error("{}", data.data());
 
 #ifdef _WIN32
-			if (IsDebuggerPresent()) __debugbreak();
+				if (IsDebuggerPresent()) __debugbreak();
 #endif
+			}
+
+			return status == GL_TRUE;
 		}
 	}
 
+	bool load_parallel_shader_compile(GLADloadfunc aLoad) {
+		char const* function = nullptr;
+		if (has_extension("GL_KHR_parallel_shader_compile")) function = "glMaxShaderCompilerThreadsKHR";
+		else if (has_extension("GL_ARB_parallel_shader_compile")) function = "glMaxShaderCompilerThreadsARB";
+		if (!function) return false;
+
+		auto const maxShaderCompilerThreads = reinterpret_cast<void (GLAD_API_PTR*)(GLuint)>(aLoad(function));
+		if (!maxShaderCompilerThreads) return false;
+
+		// The implementation picks the thread count
+		maxShaderCompilerThreads(0xFFFFFFFF);
+		gParallelShaderCompile = true;
+		return true;
+	}
+
+	Shader::Shader(GLenum aType, std::string_view aSource) {
+		char const* cString = aSource.data();
+		GLint cLength = static_cast<GLint>(aSource.size());
+
+		mHandle = glCreateShader(aType);
+		glShaderSource(mHandle, 1, &cString, &cLength);
+		glCompileShader(mHandle);
+
+		report_errors(mHandle, GL_COMPILE_STATUS, glGetShaderiv, glGetShaderInfoLog);
+	}
+
 	Shader& Shader::operator=(Shader&& aOther) noexcept {
 		std::swap(mHandle, aOther.mHandle);
 		return *this;
@@ -44,6 +89,7 @@ namespace rvo {
 
 	ShaderProgram::ShaderProgram(std::span<std::reference_wrapper<Shader const> const> aShaders) {
 		mHandle = glCreateProgram();
+		glProgramParameteri(mHandle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
 		for (auto const& shader : aShaders) {
 			glAttachShader(mHandle, shader.get().handle());
@@ -55,21 +101,46 @@ namespace rvo {
 			glDetachShader(mHandle, shader.get().handle());
 		}
 
-		GLint logLength;
-		glGetProgramiv(mHandle, GL_INFO_LOG_LENGTH, &logLength);
+		report_errors(mHandle, GL_LINK_STATUS, glGetProgramiv, glGetProgramInfoLog);
+		fetch_uniforms();
+	}
 
-		if (logLength > 0) {
-			std::vector<GLchar> data(logLength);
+	std::optional<ShaderProgram> ShaderProgram::from_binary(GLenum aFormat, std::span<std::byte const> aBinary) {
+		ShaderProgram program;
+		program.mHandle = glCreateProgram();
+		glProgramBinary(program.mHandle, aFormat, aBinary.data(), static_cast<GLsizei>(aBinary.size()));
 
-			glGetProgramInfoLog(mHandle, static_cast<GLsizei>(data.size()), nullptr, data.data());
-			spdlog::error("{}", data.data());
+		// Fails whenever the driver changed since the binary was made
+		GLint status = GL_FALSE;
+		glGetProgramiv(program.mHandle, GL_LINK_STATUS, &status);
+		if (status != GL_TRUE) return std::nullopt;
 
-#ifdef _WIN32
-			if (IsDebuggerPresent()) __debugbreak();
-#endif
-		}
+		program.fetch_uniforms();
+		return program;
+	}
+
+	std::optional<ProgramBinary> ShaderProgram::binary() const {
+		GLint status = GL_FALSE;
+		glGetProgramiv(mHandle, GL_LINK_STATUS, &status);
+		if (status != GL_TRUE) return std::nullopt;
 
-		// Fetch uniforms, avoid constantly looking up uniform locations
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		if (formats == 0) return std::nullopt;
+
+		GLint length = 0;
+		glGetProgramiv(mHandle, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0) return std::nullopt;
+
+		ProgramBinary binary;
+		binary.data.resize(static_cast<std::size_t>(length));
+		glGetProgramBinary(mHandle, length, nullptr, &binary.format, binary.data.data());
+		return binary;
+	}
+
+	void ShaderProgram::fetch_uniforms() {
+		// Avoid constantly looking up uniform locations
+		mUniformLocations.clear();
 
 		GLint uniformCount = 0;
 		glGetProgramiv(mHandle, GL_ACTIVE_UNIFORMS, &uniformCount);
@@ -79,6 +150,7 @@ namespace rvo {
 			glGetProgramiv(mHandle, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
 
 			auto uniformName = std::make_unique<GLchar[]>(maxNameLength);
+			mUniformLocations.reserve(uniformCount);
 
 			for (GLint i = 0; i < uniformCount; ++i) {
 				GLsizei length;
@@ -86,14 +158,22 @@ namespace rvo {
 				GLenum type;
 
 				glGetActiveUniform(mHandle, i, maxNameLength, &length, &count, &type, uniformName.get());
-				mUniformLocations[std::string(uniformName.get())] = glGetUniformLocation(mHandle, uniformName.get());
+				mUniformLocations.push_back({ UniformId(std::string_view(uniformName.get(), length)), glGetUniformLocation(mHandle, uniformName.get()) });
 			}
 		}
+
+		std::ranges::sort(mUniformLocations, {}, &UniformLocation::id);
+
+		if (std::ranges::adjacent_find(mUniformLocations, {}, &UniformLocation::id) != mUniformLocations.end()) {
+			spdlog::error("Two uniforms of program {} share a hash, rename one of them", mHandle);
+		}
 	}
-		
+
 	ShaderProgram& ShaderProgram::operator=(ShaderProgram&& aOther) noexcept {
 		std::swap(mHandle, aOther.mHandle);
 		std::swap(mBackfaceCull, aOther.mBackfaceCull);
+		std::swap(mDepthPrepass, aOther.mDepthPrepass);
+		std::swap(mCompute, aOther.mCompute);
 		std::swap(mUniformLocations, aOther.mUniformLocations);
 		return *this;
 	}
@@ -108,29 +188,95 @@ namespace rvo {
 		glUseProgram(mHandle);
 	}
 
-	void ShaderProgram::push_1f(std::string_view aName, float aValue) {
-		glProgramUniform1f(mHandle, get_uniform_location(aName), aValue);
+	void ShaderProgram::push_1f(UniformId aId, float aValue) {
+		glProgramUniform1f(mHandle, get_uniform_location(aId), aValue);
+	}
+
+	void ShaderProgram::push_1i(UniformId aId, int aValue) {
+		glProgramUniform1i(mHandle, get_uniform_location(aId), aValue);
+	}
+
+	void ShaderProgram::push_2f(UniformId aId, glm::vec2 const& aValue) {
+		glProgramUniform2fv(mHandle, get_uniform_location(aId), 1, glm::value_ptr(aValue));
 	}
 
-	void ShaderProgram::push_1i(std::string_view aName, int aValue) {
-		glProgramUniform1i(mHandle, get_uniform_location(aName), aValue);
+	void ShaderProgram::push_3f(UniformId aId, glm::vec3 const& aValue) {
+		glProgramUniform3fv(mHandle, get_uniform_location(aId), 1, glm::value_ptr(aValue));
 	}
 
-	void ShaderProgram::push_2f(std::string_view aName, glm::vec2 const& aValue) {
-		glProgramUniform2fv(mHandle, get_uniform_location(aName), 1, glm::value_ptr(aValue));
+	void ShaderProgram::push_mat4f(UniformId aId, glm::mat4 const& aValue) {
+		glProgramUniformMatrix4fv(mHandle, get_uniform_location(aId), 1, GL_FALSE, glm::value_ptr(aValue));
 	}
 
-	void ShaderProgram::push_3f(std::string_view aName, glm::vec3 const& aValue) {
-		glProgramUniform3fv(mHandle, get_uniform_location(aName), 1, glm::value_ptr(aValue));
+	void ShaderProgram::push_4fv(UniformId aId, std::span<glm::vec4 const> aValues) {
+		glProgramUniform4fv(mHandle, get_uniform_location(aId), static_cast<GLsizei>(aValues.size()), glm::value_ptr(aValues[0]));
 	}
 
-	void ShaderProgram::push_mat4f(std::string_view aName, glm::mat4 const& aValue) {
-		glProgramUniformMatrix4fv(mHandle, get_uniform_location(aName), 1, GL_FALSE, glm::value_ptr(aValue));
+	GLint ShaderProgram::get_uniform_location(UniformId aId) const {
+		auto it = std::ranges::lower_bound(mUniformLocations, aId, {}, &UniformLocation::id);
+		if (it == mUniformLocations.end() || it->id != aId) return -1;
+		return it->location;
 	}
 
-	GLint ShaderProgram::get_uniform_location(std::string_view aName) const {
-		auto it = mUniformLocations.find(aName);
-		if (it == mUniformLocations.end()) return -1;
-		return it->second;
+
+	ProgramBuild::ProgramBuild(std::span<Stage const> aStages) {
+		mProgram = glCreateProgram();
+		glProgramParameteri(mProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+		mShaders.reserve(aStages.size());
+
+		for (auto const& stage : aStages) {
+			Shader shader;
+			shader.mHandle = glCreateShader(stage.type);
+
+			char const* cString = stage.source.data();
+			GLint cLength = static_cast<GLint>(stage.source.size());
+			glShaderSource(shader.mHandle, 1, &cString, &cLength);
+			glCompileShader(shader.mHandle);
+
+			glAttachShader(mProgram, shader.mHandle);
+			mShaders.push_back(std::move(shader));
+		}
+
+		glLinkProgram(mProgram);
+	}
+
+	ProgramBuild& ProgramBuild::operator=(ProgramBuild&& aOther) noexcept {
+		std::swap(mShaders, aOther.mShaders);
+		std::swap(mProgram, aOther.mProgram);
+		return *this;
+	}
+
+	ProgramBuild::~ProgramBuild() noexcept {
+		if (mProgram) {
+			glDeleteProgram(mProgram);
+		}
+	}
+
+	bool ProgramBuild::ready() const {
+		if (!gParallelShaderCompile) return true;
+
+		GLint status = GL_FALSE;
+		glGetProgramiv(mProgram, kCompletionStatus, &status);
+		return status == GL_TRUE;
+	}
+
+	std::optional<ShaderProgram> ProgramBuild::finish() {
+		bool success = true;
+
+		for (auto const& shader : mShaders) {
+			success &= report_errors(shader.mHandle, GL_COMPILE_STATUS, glGetShaderiv, glGetShaderInfoLog);
+			glDetachShader(mProgram, shader.mHandle);
+		}
+
+		mShaders.clear();
+
+		success = report_errors(mProgram, GL_LINK_STATUS, glGetProgramiv, glGetProgramInfoLog) && success;
+		if (!success) return std::nullopt;
+
+		ShaderProgram program;
+		std::swap(program.mHandle, mProgram);
+		program.fetch_uniforms();
+		return program;
 	}
 }
\ No newline at end of file
@@ -6,6 +6,8 @@
 #include <glad/gl.h>
 
 #include <vector>
+#include <optional>
+#include <cstdint>
 #include <cstddef>
 #include <utility>
 #include <span>
@@ -14,6 +16,10 @@
 #include <string>
 
 namespace rvo {
+	// Lets the driver compile and link on its own threads when it has `GL_KHR_parallel_shader_compile` or the ARB variant
+	// Call once after loading gl, false when neither is available and `ProgramBuild` ends up blocking
+	bool load_parallel_shader_compile(GLADloadfunc aLoad);
+
 	class Shader final {
 	public:
 		constexpr Shader() noexcept = default;
@@ -33,9 +39,30 @@ namespace rvo {
 		GLuint handle() const noexcept { return mHandle; }
 
 	private:
+		friend class ProgramBuild;
+
 		GLuint mHandle = 0;
 	};
 	
+	// Driver specific image of a linked program, see `glGetProgramBinary`
+	struct ProgramBinary final {
+		GLenum format = 0;
+		std::vector<std::byte> data;
+	};
+
+	// Uniform name hashed at compile time, write `"uName"_u` so nothing is hashed while drawing
+	class UniformId final {
+	public:
+		constexpr explicit UniformId(std::string_view aName) noexcept : mHash(fnv1a(aName)) {}
+
+		constexpr std::uint64_t hash() const noexcept { return mHash; }
+		constexpr auto operator<=>(UniformId const&) const noexcept = default;
+	private:
+		std::uint64_t mHash;
+	};
+
+	consteval UniformId operator""_u(char const* aName, std::size_t aLength) noexcept { return UniformId(std::string_view(aName, aLength)); }
+
 	class ShaderProgram final {
 	public:
 		ShaderProgram() = default;
@@ -52,20 +79,66 @@ namespace rvo {
 
 		~ShaderProgram() noexcept;
 
-		void push_1f(std::string_view aName, float aValue);
-		void push_1i(std::string_view aName, int aValue);
-		void push_2f(std::string_view aName, glm::vec2 const& aValue);
-		void push_3f(std::string_view aName, glm::vec3 const& aValue);
-		void push_mat4f(std::string_view aName, glm::mat4 const& aValue);
+		// Relinks a program retrieved with `binary`, nullopt when the driver rejects it
+		static std::optional<ShaderProgram> from_binary(GLenum aFormat, std::span<std::byte const> aBinary);
+		// Empty when the driver does not support program binaries
+		std::optional<ProgramBinary> binary() const;
+
+		void push_1f(UniformId aId, float aValue);
+		void push_1i(UniformId aId, int aValue);
+		void push_2f(UniformId aId, glm::vec2 const& aValue);
+		void push_3f(UniformId aId, glm::vec3 const& aValue);
+		void push_mat4f(UniformId aId, glm::mat4 const& aValue);
+		// Arrays are looked up by their first element, eg: `"uArray[0]"_u`
+		void push_4fv(UniformId aId, std::span<glm::vec4 const> aValues);
 
 		void bind() const;
-		GLint get_uniform_location(std::string_view aName) const;
+		// -1 when the program has no such active uniform
+		GLint get_uniform_location(UniformId aId) const;
 
 		GLuint handle() const noexcept { return mHandle; }
+	private:
+		friend class ProgramBuild;
+
+		void fetch_uniforms();
 	public:
 		bool mBackfaceCull = true;
+		bool mDepthPrepass = true; // False for shaders which move vertices or discard
+		bool mCompute = false;
 	private:
+		struct UniformLocation final {
+			UniformId id;
+			GLint location;
+		};
+
 		GLuint mHandle = 0;
-		rvo::UnorderedStringMap<GLint> mUniformLocations;
+		std::vector<UniformLocation> mUniformLocations; // Sorted by id
+
+	};
+
+	// A program compiling and linking in the background, poll `ready` and `finish` once it is
+	// Nothing is queried from the driver until then since any query waits for the compile to complete
+	class ProgramBuild final {
+	public:
+		struct Stage final {
+			GLenum type;
+			std::string_view source;
+		};
+
+		ProgramBuild() = default;
+		explicit ProgramBuild(std::span<Stage const> aStages);
+		ProgramBuild(ProgramBuild const&) = delete;
+		ProgramBuild& operator=(ProgramBuild const&) = delete;
+		ProgramBuild(ProgramBuild&& aOther) noexcept { *this = std::move(aOther); }
+		ProgramBuild& operator=(ProgramBuild&& aOther) noexcept;
+		~ProgramBuild() noexcept;
+
+		// Always true without parallel compile support, `finish` then does the work
+		bool ready() const;
+		// Waits when not ready, logs compile and link errors and returns nullopt on failure
+		std::optional<ShaderProgram> finish();
+	private:
+		std::vector<Shader> mShaders;
+		GLuint mProgram = 0;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,382 @@
+#include "rvo_shader_cook.hpp"
+
+#include "../rvo_utility.hpp"
+#include "../rvo_vfs.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+
+namespace rvo {
+	namespace {
+		constexpr char const* kIncludeDirectory = "shaders/include";
+
+		// A source file split at its `#include` and `#inject` directives, RVO pragmas are already commented out
+		struct ParsedShaderFile final {
+			struct Segment final {
+				enum class Kind { kText, kInclude, kInject };
+
+				Kind kind;
+				std::string text; // Path relative to kIncludeDirectory for kInclude
+				int nextLine = 0; // Line following the directive, for `#line`
+			};
+
+			std::vector<Segment> segments;
+			bool noBackfaceCull = false;
+			bool noDepthPrepass = false;
+			bool compute = false;
+			std::vector<std::string> keywords;
+		};
+
+		// Skips spaces and tabs, then matches aWord followed by whitespace or the end of the line
+		bool consume_word(std::string_view& aLine, std::string_view aWord) {
+			std::size_t const start = aLine.find_first_not_of(" \t");
+			if (start == std::string_view::npos || aLine.size() - start < aWord.size()) return false;
+
+			std::string_view const candidate = aLine.substr(start, aWord.size());
+			bool const matches = std::ranges::equal(candidate, aWord, [](char a, char b) { return std::toupper(static_cast<unsigned char>(a)) == std::toupper(static_cast<unsigned char>(b)); });
+			if (!matches) return false;
+
+			std::string_view const rest = aLine.substr(start + aWord.size());
+			if (!rest.empty() && rest.front() != ' ' && rest.front() != '\t' && rest.front() != '\r') return false;
+
+			aLine = rest;
+			return true;
+		}
+
+		ParsedShaderFile parse_shader_file(std::string_view aText) {
+			ParsedShaderFile file;
+
+			auto append_text = [&](std::string_view aText) {
+				if (file.segments.empty() || file.segments.back().kind != ParsedShaderFile::Segment::Kind::kText) {
+					file.segments.push_back({ ParsedShaderFile::Segment::Kind::kText });
+				}
+
+				file.segments.back().text += aText;
+			};
+
+			int lineNumber = 1;
+
+			for (std::size_t position = 0; position < aText.size(); ++lineNumber) {
+				std::size_t end = aText.find('\n', position);
+				end = end == std::string_view::npos ? aText.size() : end + 1;
+
+				std::string_view const line = aText.substr(position, end - position);
+				std::string_view const content = line.substr(0, line.find_first_of("\r\n"));
+				position = end;
+
+				std::string_view directive = content;
+				std::size_t const hash = directive.find_first_not_of(" \t");
+
+				if (hash == std::string_view::npos || directive[hash] != '#') {
+					append_text(line);
+					continue;
+				}
+
+				directive.remove_prefix(hash + 1);
+
+				// The newline of the directive stays in the text so line numbers after it still match
+				if (std::string_view name = directive; consume_word(name, "include")) {
+					std::size_t const begin = name.find_first_not_of(" \t");
+					std::size_t const close = begin == std::string_view::npos || name[begin] != '"' ? std::string_view::npos : name.find('"', begin + 1);
+
+					if (close != std::string_view::npos) {
+						file.segments.push_back({ ParsedShaderFile::Segment::Kind::kInclude, std::string(name.substr(begin + 1, close - begin - 1)), lineNumber + 1 });
+						append_text(line.substr(content.size()));
+						continue;
+					}
+				}
+				else if (consume_word(name = directive, "inject")) {
+					file.segments.push_back({ ParsedShaderFile::Segment::Kind::kInject, {}, lineNumber + 1 });
+					append_text(line.substr(content.size()));
+					continue;
+				}
+				else if (consume_word(name = directive, "pragma")) {
+					bool* flag = nullptr;
+					if (std::string_view pragma = name; consume_word(pragma, "RVO_NO_BACKFACE_CULL")) flag = &file.noBackfaceCull;
+					else if (consume_word(pragma = name, "RVO_NO_DEPTH_PREPASS")) flag = &file.noDepthPrepass;
+					else if (consume_word(pragma = name, "RVO_COMPUTE")) flag = &file.compute;
+
+					if (flag) {
+						*flag = true;
+						append_text("// ");
+					}
+					else if (std::string_view list = name; consume_word(list, "RVO_KEYWORDS")) {
+						for (std::size_t begin; (begin = list.find_first_not_of(" \t")) != std::string_view::npos;) {
+							std::size_t const end = std::min(list.find_first_of(" \t", begin), list.size());
+							file.keywords.emplace_back(list.substr(begin, end - begin));
+							list.remove_prefix(end);
+						}
+
+						append_text("// ");
+					}
+				}
+
+				append_text(line);
+			}
+
+			return file;
+		}
+
+		// Parsed files by path, reparsed when their write time changes, shared by every shader and thread
+		std::mutex gParsedMutex;
+		std::unordered_map<std::string, std::pair<std::filesystem::file_time_type, std::shared_ptr<ParsedShaderFile const>>> gParsedFiles;
+
+		std::shared_ptr<ParsedShaderFile const> load_shader_file(std::filesystem::path const& aPath) {
+			auto const time = vfs::last_write_time(aPath);
+			if (!time) return nullptr;
+
+			std::string const key = aPath.generic_string();
+
+			{
+				std::scoped_lock lock(gParsedMutex);
+				if (auto it = gParsedFiles.find(key); it != gParsedFiles.end() && it->second.first == *time) return it->second.second;
+			}
+
+			auto optFile = vfs::view(aPath);
+			if (!optFile) return nullptr;
+
+			auto parsed = std::make_shared<ParsedShaderFile const>(parse_shader_file(optFile->text()));
+
+			std::scoped_lock lock(gParsedMutex);
+			gParsedFiles[key] = { *time, parsed };
+			return parsed;
+		}
+
+		// Expands one file into every stage at once, the stages only differ in what `#inject` inserts
+		// `#line` source string n is the nth dependency, 0 is the shader itself
+		struct ShaderExpansion final {
+			std::span<std::string> outputs;
+			std::span<std::string_view const> injects;
+			std::vector<std::filesystem::path>& dependencies;
+			std::vector<std::string> stack; // Open includes, to catch cycles
+			std::string error;
+
+			void append(std::string_view aText) {
+				for (auto& output : outputs) output += aText;
+			}
+
+			int source_index(std::filesystem::path const& aPath) {
+				auto it = std::ranges::find(dependencies, aPath);
+				if (it != dependencies.end()) return static_cast<int>(it - dependencies.begin()) + 1;
+
+				dependencies.push_back(aPath);
+				return static_cast<int>(dependencies.size());
+			}
+
+			bool expand(ParsedShaderFile const& aFile, int aSourceIndex) {
+				using Kind = ParsedShaderFile::Segment::Kind;
+
+				for (auto const& segment : aFile.segments) {
+					if (segment.kind == Kind::kText) {
+						append(segment.text);
+						continue;
+					}
+
+					if (segment.kind == Kind::kInject) {
+						for (std::size_t i = 0; i < outputs.size(); ++i) outputs[i] += injects[i];
+					}
+					else {
+						std::filesystem::path const path = std::filesystem::path(kIncludeDirectory) / segment.text;
+						std::string const key = path.generic_string();
+
+						if (std::ranges::find(stack, key) != stack.end()) {
+							error = fmt::format("`{}` includes itself", key);
+							return false;
+						}
+
+						auto const included = load_shader_file(path);
+						if (!included) {
+							error = fmt::format("couldn't load `{}`", key);
+							return false;
+						}
+
+						int const index = source_index(path);
+						append(fmt::format("#line 1 {}\n", index));
+
+						stack.push_back(key);
+						if (!expand(*included, index)) return false;
+						stack.pop_back();
+					}
+
+					append(fmt::format("\n#line {} {}", segment.nextLine, aSourceIndex));
+				}
+
+				return true;
+			}
+		};
+
+		void write_string(std::ofstream& aStream, std::string_view aString) {
+			std::uint32_t const size = static_cast<std::uint32_t>(aString.size());
+			aStream.write(reinterpret_cast<char const*>(&size), sizeof(size));
+			aStream.write(aString.data(), aString.size());
+		}
+
+		bool read_string(std::span<std::byte const>& aBytes, std::string& aString) {
+			std::uint32_t size;
+			if (aBytes.size() < sizeof(size)) return false;
+			std::memcpy(&size, aBytes.data(), sizeof(size));
+			aBytes = aBytes.subspan(sizeof(size));
+
+			if (aBytes.size() < size) return false;
+			aString.assign(reinterpret_cast<char const*>(aBytes.data()), size);
+			aBytes = aBytes.subspan(size);
+			return true;
+		}
+	}
+
+	std::optional<ShaderSource> preprocess_shader(std::filesystem::path const& aSource) {
+		auto const file = load_shader_file(aSource);
+		if (!file) return std::nullopt;
+
+		// Pragmas only count in the shader itself, includes cannot change how it is drawn
+		ShaderSource source;
+		source.backfaceCull = !file->noBackfaceCull;
+		source.depthPrepass = !file->noDepthPrepass;
+		source.keywords = file->keywords;
+
+		if (source.keywords.size() > kMaxShaderKeywords) {
+			spdlog::error("`{}` declares {} keywords, at most {} are supported", aSource.string(), source.keywords.size(), kMaxShaderKeywords);
+			return std::nullopt;
+		}
+
+		std::string_view const computeInject[] = { "#version 460 core\n#define RVO_COMP\n" };
+		std::string_view const graphicsInject[] = { "#version 460 core\n#define RVO_VERT\n", "#version 460 core\n#define RVO_FRAG\n" };
+
+		std::string graphics[2];
+
+		ShaderExpansion expansion{
+			.outputs = file->compute ? std::span<std::string>(&source.compute, 1) : std::span<std::string>(graphics),
+			.injects = file->compute ? std::span<std::string_view const>(computeInject) : std::span<std::string_view const>(graphicsInject),
+			.dependencies = source.dependencies,
+		};
+
+		expansion.stack.push_back(aSource.generic_string());
+
+		if (!expansion.expand(*file, 0)) {
+			spdlog::error("Failed to preprocess `{}`: {}", aSource.string(), expansion.error);
+			return std::nullopt;
+		}
+
+		source.vertex = std::move(graphics[0]);
+		source.fragment = std::move(graphics[1]);
+		return source;
+	}
+
+	bool write_shader_source(std::filesystem::path const& aPath, ShaderSource const& aSource) {
+		std::error_code error;
+		std::filesystem::create_directories(aPath.parent_path(), error);
+
+		std::ofstream stream(aPath, std::ios::binary);
+		if (!stream) {
+			spdlog::error("Failed to open `{}` for writing", aPath.string());
+			return false;
+		}
+
+		std::uint8_t const flags = (aSource.backfaceCull ? 1 : 0) | (aSource.depthPrepass ? 2 : 0);
+		stream.write("RVS2", 4);
+		stream.write(reinterpret_cast<char const*>(&flags), sizeof(flags));
+
+		write_string(stream, aSource.vertex);
+		write_string(stream, aSource.fragment);
+		write_string(stream, aSource.compute);
+
+		std::uint32_t const dependencyCount = static_cast<std::uint32_t>(aSource.dependencies.size());
+		stream.write(reinterpret_cast<char const*>(&dependencyCount), sizeof(dependencyCount));
+		for (auto const& dependency : aSource.dependencies) write_string(stream, dependency.generic_string());
+
+		std::uint32_t const keywordCount = static_cast<std::uint32_t>(aSource.keywords.size());
+		stream.write(reinterpret_cast<char const*>(&keywordCount), sizeof(keywordCount));
+		for (auto const& keyword : aSource.keywords) write_string(stream, keyword);
+
+		return static_cast<bool>(stream);
+	}
+
+	std::optional<ShaderSource> read_shader_source(std::filesystem::path const& aPath) {
+		auto optFile = vfs::view(aPath);
+		if (!optFile) return std::nullopt;
+
+		std::span<std::byte const> bytes = optFile->bytes();
+		if (bytes.size() < 5 || std::memcmp(bytes.data(), "RVS2", 4) != 0) return std::nullopt;
+
+		std::uint8_t const flags = static_cast<std::uint8_t>(bytes[4]);
+		bytes = bytes.subspan(5);
+
+		ShaderSource source;
+		source.backfaceCull = flags & 1;
+		source.depthPrepass = flags & 2;
+
+		std::uint32_t dependencyCount;
+		if (!read_string(bytes, source.vertex) || !read_string(bytes, source.fragment) || !read_string(bytes, source.compute) || bytes.size() < sizeof(dependencyCount)) {
+			spdlog::error("`{}` is not a cooked shader", aPath.string());
+			return std::nullopt;
+		}
+
+		std::memcpy(&dependencyCount, bytes.data(), sizeof(dependencyCount));
+		bytes = bytes.subspan(sizeof(dependencyCount));
+
+		for (std::uint32_t i = 0; i < dependencyCount; ++i) {
+			std::string dependency;
+			if (!read_string(bytes, dependency)) return std::nullopt;
+			source.dependencies.emplace_back(std::move(dependency));
+		}
+
+		std::uint32_t keywordCount;
+		if (bytes.size() < sizeof(keywordCount)) return std::nullopt;
+		std::memcpy(&keywordCount, bytes.data(), sizeof(keywordCount));
+		bytes = bytes.subspan(sizeof(keywordCount));
+
+		source.keywords.resize(keywordCount);
+		for (auto& keyword : source.keywords) {
+			if (!read_string(bytes, keyword)) return std::nullopt;
+		}
+
+		return source;
+	}
+
+	ShaderSource ShaderSource::permutation(std::uint64_t aMask) const {
+		ShaderSource source = *this;
+		if (aMask == 0) return source;
+
+		std::string defines;
+		for (std::size_t i = 0; i < keywords.size(); ++i) {
+			if (aMask & std::uint64_t(1) << i) defines += fmt::format("#define {}\n", keywords[i]);
+		}
+
+		// After `#version`, which the inject puts on the first line, and before the `#line` that follows the inject
+		for (std::string* stage : { &source.vertex, &source.fragment, &source.compute }) {
+			if (stage->empty()) continue;
+
+			std::size_t const firstLine = stage->starts_with("#version") ? stage->find('\n') : std::string::npos;
+			stage->insert(firstLine == std::string::npos ? 0 : firstLine + 1, defines);
+		}
+
+		return source;
+	}
+
+	bool cook_shader(std::filesystem::path const& aSource, std::filesystem::path const& aDestination) {
+		auto optSource = preprocess_shader(aSource);
+		return optSource && write_shader_source(aDestination, *optSource);
+	}
+
+	std::optional<ShaderSource> read_cooked_shader(std::filesystem::path const& aSource, std::filesystem::path const& aCooked) {
+		if (!is_cooked_up_to_date(aSource, aCooked)) return std::nullopt;
+
+		auto optSource = read_shader_source(aCooked);
+		if (!optSource) return std::nullopt;
+
+		for (auto const& dependency : optSource->dependencies) {
+			if (!is_cooked_up_to_date(dependency, aCooked)) return std::nullopt;
+		}
+
+		return optSource;
+	}
+}
\ No newline at end of file
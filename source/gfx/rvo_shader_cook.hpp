@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace rvo {
+	// Keywords are bits of a std::uint64_t mask
+	inline constexpr std::size_t kMaxShaderKeywords = 64;
+
+	// A `.glsl` with its includes resolved and split into stages, ready for `Shader`
+	struct ShaderSource final {
+		std::string vertex;
+		std::string fragment;
+		std::string compute; // Set instead of the other stages for `#pragma RVO_COMPUTE`
+		bool backfaceCull = true;
+		bool depthPrepass = true;
+		std::vector<std::filesystem::path> dependencies; // Every include the stages pulled in
+		std::vector<std::string> keywords; // From `#pragma RVO_KEYWORDS A B`, bit n of a mask enables the nth
+
+		bool is_compute() const noexcept { return !compute.empty(); }
+
+		// Copy with `#define` lines for the keywords in aMask, disabled paths are left to the compiler's preprocessor to drop
+		ShaderSource permutation(std::uint64_t aMask) const;
+	};
+
+	// Expands `#include "x"` from shaders/include and `#inject`, and consumes the RVO pragmas, in one pass for every stage
+	// Parsed files stay cached in memory by path and write time, so shared includes are read once
+	std::optional<ShaderSource> preprocess_shader(std::filesystem::path const& aSource);
+
+	// `.rvoshader` stores the preprocessed stages along with their dependencies
+	bool write_shader_source(std::filesystem::path const& aPath, ShaderSource const& aSource);
+	std::optional<ShaderSource> read_shader_source(std::filesystem::path const& aPath);
+
+	bool cook_shader(std::filesystem::path const& aSource, std::filesystem::path const& aDestination);
+
+	// Reads aCooked when it is newer than aSource and every dependency it recorded
+	std::optional<ShaderSource> read_cooked_shader(std::filesystem::path const& aSource, std::filesystem::path const& aCooked);
+}
\ No newline at end of file
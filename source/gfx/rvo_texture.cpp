@@ -1,43 +1,68 @@
 #include "rvo_texture.hpp"
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "../stb_image.h"
+#include "rvo_ktx2.hpp"
+#include "rvo_texture_cook.hpp"
+#include "../rvo_utility.hpp"
 
 #include <spdlog/spdlog.h>
 
-#include <cassert>
 #include <limits>
 
 #include <glm/glm.hpp>
-#include <glm/gtc/integer.hpp>
 
 namespace rvo {
 	namespace {
 		GLfloat gMaxAnisotropy = -1.0f;
+
+		// EXT_texture_compression_s3tc and EXT_texture_sRGB, glad only carries the core enums
+		constexpr GLenum kCompressedRgbS3tcDxt1 = 0x83F0;
+		constexpr GLenum kCompressedRgbaS3tcDxt5 = 0x83F3;
+		constexpr GLenum kCompressedSrgbS3tcDxt1 = 0x8C4C;
+		constexpr GLenum kCompressedSrgbAlphaS3tcDxt5 = 0x8C4F;
+
+	}
+
+	GLenum block_internal_format(BlockFormat aFormat, bool aSrgb) {
+		switch (aFormat) {
+		case BlockFormat::BC1: return aSrgb ? kCompressedSrgbS3tcDxt1 : kCompressedRgbS3tcDxt1;
+		case BlockFormat::BC3: return aSrgb ? kCompressedSrgbAlphaS3tcDxt5 : kCompressedRgbaS3tcDxt5;
+		case BlockFormat::BC7: return aSrgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+		}
+
+		return GL_NONE;
 	}
 
 	Texture Texture::make_from_path(char const* aPath, bool aSrgb) {
-		int x, y;
-		stbi_uc* pixels = stbi_load(aPath, &x, &y, nullptr, 4);
-		assert(pixels);
+		auto const cooked = rvo::cooked_path(aPath, aSrgb ? ".ktx2" : ".linear.ktx2");
 
-		int const numLevels = glm::log2(glm::max(x, y)) + 1;
+		if (!rvo::is_cooked_up_to_date(aPath, cooked) && !rvo::cook_texture(aPath, cooked, aSrgb)) {
+			return {};
+		}
 
-		GLenum const internalFormat = aSrgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+		auto optTexture = rvo::read_ktx2(cooked);
+		if (!optTexture) return {};
+
+		return make_from_ktx2(*optTexture);
+	}
+
+	Texture Texture::make_from_ktx2(Ktx2Texture const& aTexture, std::size_t aFirstLevel) {
+		GLenum const internalFormat = block_internal_format(aTexture.format, aTexture.srgb);
 
 		Texture texture = { {
-				.levels = numLevels,
+				.levels = static_cast<GLsizei>(aTexture.levels.size() - aFirstLevel),
 				.internalFormat = internalFormat,
-				.width = x,
-				.height = y,
+				.width = static_cast<GLsizei>(aTexture.level_width(aFirstLevel)),
+				.height = static_cast<GLsizei>(aTexture.level_height(aFirstLevel)),
 				.minFilter = GL_LINEAR_MIPMAP_LINEAR,
 				.magFilter = GL_LINEAR,
 				.wrap = GL_REPEAT,
 				.anisotropy = std::numeric_limits<float>::infinity(), // Use max supported anisotropy
 			} };
 
-		texture.upload(x, y, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-		texture.generate_mipmaps();
+		for (std::size_t i = aFirstLevel; i < aTexture.levels.size(); ++i) {
+			if (!aTexture.has_level(i)) continue;
+			texture.upload_compressed(static_cast<GLint>(i - aFirstLevel), aTexture.level_width(i), aTexture.level_height(i), internalFormat, aTexture.level(i));
+		}
 
 		return texture;
 	}
@@ -62,6 +87,10 @@ namespace rvo {
 		glTextureSubImage2D(mHandle, 0, 0, 0, width, height, format, type, pixels);
 	}
 
+	void Texture::upload_compressed(GLint aLevel, GLsizei aWidth, GLsizei aHeight, GLenum aFormat, std::span<std::byte const> aData) const {
+		glCompressedTextureSubImage2D(mHandle, aLevel, 0, 0, aWidth, aHeight, aFormat, static_cast<GLsizei>(aData.size()), aData.data());
+	}
+
 	void Texture::generate_mipmaps() const {
 		glGenerateTextureMipmap(mHandle);
 	}
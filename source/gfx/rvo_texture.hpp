@@ -1,10 +1,18 @@
 #pragma once
 
+#include "rvo_block_compression.hpp"
+
 #include <glad/gl.h>
 
 #include <utility>
+#include <span>
+#include <cstddef>
 
 namespace rvo {
+	struct Ktx2Texture;
+
+	GLenum block_internal_format(BlockFormat aFormat, bool aSrgb);
+
 	class Texture final {
 	public:
 		struct CreateInfo final {
@@ -18,7 +26,10 @@ namespace rvo {
 			GLfloat anisotropy;
 		};
 
+		// Loads the block compressed copy under `cooked/`, cooking it first when missing or older than aPath
 		static Texture make_from_path(char const* aPath, bool aSrgb = true);
+		// Allocates aFirstLevel and smaller and uploads the ones present in aTexture, aFirstLevel becomes level 0 of the texture
+		static Texture make_from_ktx2(Ktx2Texture const& aTexture, std::size_t aFirstLevel = 0);
 
 		constexpr Texture() noexcept = default;
 		Texture(CreateInfo const& aInfo);
@@ -29,6 +40,7 @@ namespace rvo {
 		~Texture() noexcept;
 
 		void upload(GLsizei width, GLsizei height, GLenum format, GLenum type, void const* pixels) const;
+		void upload_compressed(GLint aLevel, GLsizei aWidth, GLsizei aHeight, GLenum aFormat, std::span<std::byte const> aData) const;
 		void generate_mipmaps() const;
 
 		void bind(GLuint aUnit) const;
@@ -0,0 +1,54 @@
+#include "rvo_texture_cook.hpp"
+
+#include "rvo_ktx2.hpp"
+
+#include "../rvo_vfs.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+#include <spdlog/spdlog.h>
+
+#include <cstring>
+#include <memory>
+
+namespace rvo {
+	bool cook_texture(std::filesystem::path const& aSource, std::filesystem::path const& aDestination, bool aSrgb, std::optional<BlockFormat> aFormat) {
+		auto optBytes = vfs::view(aSource);
+		if (!optBytes) {
+			spdlog::error("Failed to read texture `{}`", aSource.string());
+			return false;
+		}
+
+		int x, y;
+		std::unique_ptr<stbi_uc, decltype(&stbi_image_free)> pixels(stbi_load_from_memory(reinterpret_cast<stbi_uc const*>(optBytes->bytes().data()), static_cast<int>(optBytes->bytes().size()), &x, &y, nullptr, 4), &stbi_image_free);
+		optBytes.reset();
+
+		if (!pixels) {
+			spdlog::error("Failed to load texture `{}`: {}", aSource.string(), stbi_failure_reason());
+			return false;
+		}
+
+		Image base;
+		base.width = static_cast<std::uint32_t>(x);
+		base.height = static_cast<std::uint32_t>(y);
+		base.pixels.resize(static_cast<std::size_t>(x) * y * 4);
+		std::memcpy(base.pixels.data(), pixels.get(), base.pixels.size());
+		pixels.reset();
+
+		Ktx2Texture texture;
+		texture.format = aFormat.value_or(has_alpha(base) ? BlockFormat::BC7 : BlockFormat::BC1);
+		texture.srgb = aSrgb;
+		texture.width = base.width;
+		texture.height = base.height;
+
+		for (Image const& level : build_mip_chain(std::move(base), aSrgb)) {
+			std::vector<std::byte> const blocks = compress_image(level, texture.format);
+			texture.levels.push_back({ texture.data.size(), blocks.size() });
+			texture.data.insert(texture.data.end(), blocks.begin(), blocks.end());
+		}
+
+		spdlog::info("Cooked `{}` ({}x{}, {} levels)", aSource.string(), texture.width, texture.height, texture.levels.size());
+		return write_ktx2(aDestination, texture);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "rvo_block_compression.hpp"
+
+#include <filesystem>
+#include <optional>
+
+namespace rvo {
+	// Decodes aSource, builds its mip chain and writes it block compressed as ktx2 to aDestination
+	// Without aFormat opaque images get BC1 and anything with alpha gets BC7
+	bool cook_texture(std::filesystem::path const& aSource, std::filesystem::path const& aDestination, bool aSrgb, std::optional<BlockFormat> aFormat = std::nullopt);
+}
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "rvo_virtual_texture_cook.hpp"
+
+#include "../stb_image.h"
+#include "../rvo_vfs.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <glm/glm.hpp>
+
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace rvo {
+	namespace {
+		std::int64_t wrap(std::int64_t aValue, std::int64_t aSize) {
+			return ((aValue % aSize) + aSize) % aSize;
+		}
+	}
+
+	std::size_t VirtualTextureHeader::tile_offset(std::uint32_t aLevel, std::uint32_t aX, std::uint32_t aY) const noexcept {
+		std::size_t tile = 0;
+		for (std::uint32_t i = 0; i < aLevel; ++i) tile += static_cast<std::size_t>(pages_at(i)) * pages_at(i);
+		tile += static_cast<std::size_t>(aY) * pages_at(aLevel) + aX;
+
+		return sizeof(VirtualTextureHeader) + tile * tileBytes;
+	}
+
+	bool cook_virtual_texture(std::filesystem::path const& aSource, std::filesystem::path const& aDestination, std::uint32_t aRepeat, bool aSrgb) {
+		auto optBytes = vfs::view(aSource);
+		if (!optBytes) {
+			spdlog::error("Failed to read texture `{}`", aSource.string());
+			return false;
+		}
+
+		int x, y;
+		std::unique_ptr<stbi_uc, decltype(&stbi_image_free)> pixels(stbi_load_from_memory(reinterpret_cast<stbi_uc const*>(optBytes->bytes().data()), static_cast<int>(optBytes->bytes().size()), &x, &y, nullptr, 4), &stbi_image_free);
+		optBytes.reset();
+
+		if (!pixels) {
+			spdlog::error("Failed to load texture `{}`: {}", aSource.string(), stbi_failure_reason());
+			return false;
+		}
+
+		std::uint32_t const size = static_cast<std::uint32_t>(x) * aRepeat;
+		if (x != y || size % kVirtualPageSize != 0 || !std::has_single_bit(size / kVirtualPageSize)) {
+			spdlog::error("`{}` must be square and cover a power of two number of {} texel pages when repeated {} times", aSource.string(), kVirtualPageSize, aRepeat);
+			return false;
+		}
+
+		Image base;
+		base.width = static_cast<std::uint32_t>(x);
+		base.height = static_cast<std::uint32_t>(y);
+		base.pixels.resize(static_cast<std::size_t>(x) * y * 4);
+		std::memcpy(base.pixels.data(), pixels.get(), base.pixels.size());
+		pixels.reset();
+
+		// Level n of the repeated image is level n of the source repeated, so only the source chain is kept in memory
+		std::vector<Image> const chain = build_mip_chain(std::move(base), aSrgb);
+
+		VirtualTextureHeader header;
+		header.pages = size / kVirtualPageSize;
+		header.levels = static_cast<std::uint32_t>(std::countr_zero(header.pages)) + 1;
+		header.tileBytes = static_cast<std::uint32_t>((kVirtualTileSize / 4) * (kVirtualTileSize / 4) * block_bytes(BlockFormat::BC1));
+		header.srgb = aSrgb;
+
+		std::error_code error;
+		std::filesystem::create_directories(aDestination.parent_path(), error);
+
+		std::ofstream stream(aDestination, std::ios::binary);
+		if (!stream) {
+			spdlog::error("Failed to open `{}` for writing", aDestination.string());
+			return false;
+		}
+
+		stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+		unsigned const threadCount = glm::max(std::thread::hardware_concurrency(), 1u);
+
+		for (std::uint32_t level = 0; level < header.levels; ++level) {
+			Image const& source = chain[glm::min<std::size_t>(level, chain.size() - 1)];
+			std::int64_t const levelSize = size >> level;
+			std::uint32_t const pages = header.pages_at(level);
+
+			// One row of pages at a time, the tiles of a row are compressed in parallel
+			std::vector<std::byte> row(static_cast<std::size_t>(pages) * header.tileBytes);
+
+			for (std::uint32_t py = 0; py < pages; ++py) {
+				auto compress_tiles = [&](std::uint32_t aFirst, std::uint32_t aStride) {
+					Image tile;
+					tile.width = kVirtualTileSize;
+					tile.height = kVirtualTileSize;
+					tile.pixels.resize(static_cast<std::size_t>(kVirtualTileSize) * kVirtualTileSize * 4);
+
+					for (std::uint32_t px = aFirst; px < pages; px += aStride) {
+						// The virtual texture repeats, borders wrap around to the opposite edge
+						for (std::uint32_t ty = 0; ty < kVirtualTileSize; ++ty) {
+							for (std::uint32_t tx = 0; tx < kVirtualTileSize; ++tx) {
+								std::int64_t const vx = wrap(static_cast<std::int64_t>(px * kVirtualPageSize + tx) - kVirtualPageBorder, levelSize);
+								std::int64_t const vy = wrap(static_cast<std::int64_t>(py * kVirtualPageSize + ty) - kVirtualPageBorder, levelSize);
+								std::size_t const sx = static_cast<std::size_t>(vx % source.width);
+								std::size_t const sy = static_cast<std::size_t>(vy % source.height);
+
+								std::memcpy(tile.pixels.data() + (static_cast<std::size_t>(ty) * kVirtualTileSize + tx) * 4, source.pixels.data() + (sy * source.width + sx) * 4, 4);
+							}
+						}
+
+						std::vector<std::byte> const blocks = compress_image(tile, BlockFormat::BC1);
+						std::memcpy(row.data() + static_cast<std::size_t>(px) * header.tileBytes, blocks.data(), blocks.size());
+					}
+				};
+
+				std::uint32_t const workers = glm::min(threadCount, pages);
+				{
+					std::vector<std::jthread> threads;
+					for (std::uint32_t i = 1; i < workers; ++i) threads.emplace_back(compress_tiles, i, workers);
+					compress_tiles(0, workers);
+				}
+
+				stream.write(reinterpret_cast<char const*>(row.data()), row.size());
+			}
+		}
+
+		spdlog::info("Cooked virtual texture `{}` ({}x{} pages, {} levels)", aSource.string(), header.pages, header.pages, header.levels);
+		return static_cast<bool>(stream);
+	}
+
+	std::optional<VirtualTextureHeader> read_virtual_texture_header(std::filesystem::path const& aPath) {
+		VirtualTextureHeader header;
+		bool const read = vfs::read_range(aPath, 0, std::as_writable_bytes(std::span(&header, 1)));
+
+		if (!read || std::memcmp(header.magic, VirtualTextureHeader().magic, sizeof(header.magic)) != 0) {
+			spdlog::error("`{}` is not a virtual texture", aPath.string());
+			return std::nullopt;
+		}
+
+		return header;
+	}
+}
\ No newline at end of file
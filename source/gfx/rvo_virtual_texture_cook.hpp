@@ -0,0 +1,36 @@
+#pragma once
+
+#include "rvo_block_compression.hpp"
+
+#include <filesystem>
+#include <optional>
+#include <cstddef>
+#include <cstdint>
+
+namespace rvo {
+	// Texels of unique content per page, plus a border on every side so bilinear filtering never reads a neighbouring page
+	inline constexpr std::uint32_t kVirtualPageSize = 128;
+	inline constexpr std::uint32_t kVirtualPageBorder = 4;
+	inline constexpr std::uint32_t kVirtualTileSize = kVirtualPageSize + kVirtualPageBorder * 2;
+
+	// Header of a cooked `.rvovt`, a square virtual texture split into BC1 tiles
+	// Tiles follow the header level by level, rows top to bottom, each exactly `tileBytes` long
+	struct VirtualTextureHeader final {
+		char magic[4] = { 'R', 'V', 'T', '1' };
+		std::uint32_t pages = 0; // Per side at level 0, a power of two
+		std::uint32_t levels = 0; // The last level is a single page
+		std::uint32_t tileBytes = 0;
+		std::uint32_t srgb = 1;
+
+		std::uint32_t pages_at(std::uint32_t aLevel) const noexcept { return pages >> aLevel ? pages >> aLevel : 1; }
+		std::size_t tile_offset(std::uint32_t aLevel, std::uint32_t aX, std::uint32_t aY) const noexcept;
+	};
+
+	static_assert(sizeof(VirtualTextureHeader) == 20);
+
+	// Builds a virtual texture out of aSource repeated aRepeat times on each axis
+	// The repeat stands in for painted content until the terrain has its own albedo, a painted source is used with aRepeat = 1
+	bool cook_virtual_texture(std::filesystem::path const& aSource, std::filesystem::path const& aDestination, std::uint32_t aRepeat, bool aSrgb);
+
+	std::optional<VirtualTextureHeader> read_virtual_texture_header(std::filesystem::path const& aPath);
+}
\ No newline at end of file
@@ -7,8 +7,6 @@
 #include <misc/cpp/imgui_stdlib.h>
 #include <ImGuizmo.h>
 
-#include <lua.hpp>
-
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -29,6 +27,10 @@
 #include "rvo_asset_manager.hpp"
 #include "rvo_transform.hpp"
 #include "rvo_renderer.hpp"
+#include "rvo_vfs.hpp"
+#include "rvo_scene.hpp"
+#include "rvo_script.hpp"
+#include "rvo_world.hpp"
 
 #include <entt/entt.hpp>
 
@@ -87,12 +89,20 @@ void configure_khr_debug() {
 	glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
 }
 
-void load_scene(entt::registry& aRegistry, rvo::AssetManager& aAssetManager) {
+// A saved world wins until scene.lua is edited again
+bool world_up_to_date() {
+	return rvo::is_cooked_up_to_date("scene.lua", "world/world.rvoworld");
+}
+
+void load_scene_entities(entt::registry& aRegistry, rvo::AssetManager& aAssetManager) {
+	// So does a saved scene
+	if (rvo::is_cooked_up_to_date("scene.lua", "scene.rvoscene") && rvo::load_scene_binary("scene.rvoscene", aRegistry, aAssetManager)) return;
+
 	// auto create sun
 	{
 		entt::handle entity = { aRegistry, aRegistry.create() };
 		auto& gameObject = entity.emplace<rvo::GameObject>();
-		gameObject.mName = "Sun";
+		entity.emplace<rvo::EditorData>("Sun");
 		gameObject.mTransform.position = { 0.0f, 10.0f, 0.0f };
 		gameObject.mTransform.orientation = rvo::orient_in_direction(glm::vec3(0.0f, -1.0f, 0.0f));
 
@@ -100,75 +110,12 @@ void load_scene(entt::registry& aRegistry, rvo::AssetManager& aAssetManager) {
 		directionalLight.color = glm::vec3(1.0f);
 	}
 
-	lua_State* L = luaL_newstate();
-	luaL_openlibs(L);
-
-	if (luaL_dofile(L, "scene.lua") != LUA_OK) {
-		spdlog::error("Error while parsing scene: {}", lua_tostring(L, -1));
-		lua_pop(L, 1);
-	}
-	else {
-		// Scene table at idx -1
-
-		lua_pushnil(L);
-		while (lua_next(L, -2)) {
-			entt::handle entity = { aRegistry, aRegistry.create() };
-
-			/* uses 'key' (at index -2) and 'value' (at index -1) */
-
-			if (lua_getfield(L, -1, "GameObject") == LUA_TTABLE) {
-				auto& component = entity.emplace<rvo::GameObject>();
-
-				if (lua_getfield(L, -1, "name") == LUA_TSTRING) {
-					component.mName = lua_tostring(L, -1);
-				}
-				lua_pop(L, 1);
-
-				if (lua_getfield(L, -1, "transform") == LUA_TTABLE) {
-					if (lua_getfield(L, -1, "position") == LUA_TTABLE && lua_rawlen(L, -1) == 3) {
-						for (int i = 0; i < 3; ++i) {
-							lua_rawgeti(L, -1, i + 1);
-							component.mTransform.position[i] = static_cast<float>(lua_tonumber(L, -1));
-							lua_pop(L, 1);
-						}
-					}
-					lua_pop(L, 1);
-
-					if (lua_getfield(L, -1, "scale") == LUA_TTABLE && lua_rawlen(L, -1) == 3) {
-						for (int i = 0; i < 3; ++i) {
-							lua_rawgeti(L, -1, i + 1);
-							component.mTransform.scale[i] = static_cast<float>(lua_tonumber(L, -1));
-							lua_pop(L, 1);
-						}
-					}
-					lua_pop(L, 1);
-				}
-				lua_pop(L, 1);
-			}
-			lua_pop(L, 1);
-
-			if (lua_getfield(L, -1, "MeshRenderer") == LUA_TTABLE) {
-				auto& component = entity.emplace<rvo::MeshRenderer>();
-
-				if (lua_getfield(L, -1, "material") == LUA_TSTRING) {
-					component.mMaterial = aAssetManager.get_material(lua_tostring(L, -1));
-				}
-				lua_pop(L, 1);
-
-				if (lua_getfield(L, -1, "mesh") == LUA_TSTRING) {
-					component.mMesh = aAssetManager.get_mesh(lua_tostring(L, -1));
-				}
-				lua_pop(L, 1);
-			}
-			lua_pop(L, 1);
-
-			lua_pop(L, 1);
-		}
-
-		lua_pop(L, 1); // Pop scene table
-	}
+	rvo::load_scene_script("scene.lua", aRegistry, aAssetManager);
+}
 
-	lua_close(L);
+void load_scene(entt::registry& aRegistry, rvo::AssetManager& aAssetManager) {
+	load_scene_entities(aRegistry, aAssetManager);
+	rvo::assign_scene_ids(aRegistry);
 }
 
 struct Application final {
@@ -188,6 +135,9 @@ struct Application final {
 	}
 
 	void init() {
+		// Paks shipped next to the loose assets, anything loose still overrides them
+		rvo::vfs::mount_directory(".");
+
 		mWindow = rvo::Window{ {
 			.width = 1280,
 			.height = 720,
@@ -237,15 +187,25 @@ struct Application final {
 		spdlog::info("GL_VENDOR: {}", reinterpret_cast<char const*>(glGetString(GL_VENDOR)));
 		spdlog::info("GL_VERSION: {}", reinterpret_cast<char const*>(glGetString(GL_VERSION)));
 		spdlog::info("GL_SHADING_LANGUAGE_VERSION: {}", reinterpret_cast<char const*>(glGetString(GL_SHADING_LANGUAGE_VERSION)));
+		spdlog::info("Parallel shader compile: {}", rvo::load_parallel_shader_compile(glfwGetProcAddress));
 
 		mRenderer.init(mAssetManager);
 
 		mCameraTransform.position = { 0.0f, 1.5f, 5.0f };
 
-		load_scene(mRegistry, mAssetManager);
+		if (!world_up_to_date() || !mWorldStreamer.open("world", mRegistry, mAssetManager)) load_scene(mRegistry, mAssetManager);
+
+		// Everything requested so far compiled side by side, waiting here keeps the hitches out of the first frames
+		mRenderer.warm_up(mAssetManager);
 	}
 
 	void update() {
+		mScriptSystem.update(mDeltaTime);
+		mWorldStreamer.update(mCameraTransform.position);
+
+		// The selection may have been in a cell that was just unloaded
+		if (!mRegistry.valid(mEditorState.mEditorSelection)) mEditorState.mEditorSelection = entt::null;
+
 		if (ImGui::Begin("Viewport")) {
 			ImVec2 avail = ImGui::GetContentRegionAvail();
 			ImVec2 cursor = ImGui::GetCursorPos();
@@ -315,6 +275,23 @@ struct Application final {
 		ImGui::End();
 	}
 
+	// Loads the scene next to the current one and patches only the entities that differ
+	// Streamed worlds have no whole registry to compare against and are reopened instead
+	void reload_scene() {
+		if (mWorldStreamer.is_open() || world_up_to_date()) {
+			mWorldStreamer.close();
+			mRegistry.clear();
+			if (!world_up_to_date() || !mWorldStreamer.open("world", mRegistry, mAssetManager)) load_scene(mRegistry, mAssetManager);
+			return;
+		}
+
+		entt::registry scene;
+		load_scene(scene, mAssetManager);
+
+		rvo::ScenePatchStats const stats = rvo::patch_scene(mRegistry, scene);
+		spdlog::info("Reloaded scene ({} created, {} updated, {} destroyed, {} unchanged)", stats.created, stats.updated, stats.destroyed, stats.unchanged);
+	}
+
 	void uninit() {
 		ImGui_ImplOpenGL3_Shutdown();
 		ImGui_ImplGlfw_Shutdown();
@@ -371,9 +348,15 @@ struct Application final {
 				}
 
 				if (ImGui::BeginMenu("Scene")) {
-					if (ImGui::MenuItem("Reload")) {
-						mRegistry.clear();
-						load_scene(mRegistry, mAssetManager);
+					if (ImGui::MenuItem("Reload")) reload_scene();
+
+					// A streamed world only has the cells near the camera in the registry, saving it would drop the rest
+					if (ImGui::MenuItem("Save", nullptr, nullptr, !mWorldStreamer.is_open())) {
+						rvo::save_scene("scene.rvoscene", mRegistry, mAssetManager);
+					}
+
+					if (ImGui::MenuItem("Save Partitioned", nullptr, nullptr, !mWorldStreamer.is_open())) {
+						rvo::save_world("world", mRegistry, mAssetManager, 64.0f);
 					}
 					ImGui::EndMenu();
 				}
@@ -394,11 +377,39 @@ struct Application final {
 					glfwSwapInterval(mSwapInterval);
 				}
 				ImGui::Checkbox("Wireframe", &mRenderer.mWireframe);
+				ImGui::Checkbox("Depth Prepass", &mRenderer.mDepthPrepass);
+				ImGui::Checkbox("Meshlet Culling", &mRenderer.mMeshletCulling);
+
+				{
+					auto& streamer = mAssetManager.mTextureStreamer;
+					int budget = static_cast<int>(streamer.mBudget / (1024 * 1024));
+					if (ImGui::SliderInt("Texture Budget", &budget, 16, 2048, "%d MiB")) streamer.mBudget = static_cast<std::size_t>(budget) * 1024 * 1024;
+					ImGui::LabelText("Texture Memory", "%.1f MiB (%zu streamed)", streamer.resident_bytes() / (1024.0 * 1024.0), streamer.streamed_textures());
+				}
 
 				ImGui::SliderFloat("Sensitivity", &mSensitivity, 0.01f, 1.0f);
 
 				ImGui::LabelText("Num Entities", "%d", mRenderer.mNumEntities);
 				ImGui::LabelText("Num Batches", "%d", mRenderer.mNumBatches);
+				ImGui::LabelText("Shader Permutations", "%zu", mAssetManager.shader_permutations());
+
+				{
+					rvo::LuaMemoryStats const& memory = mAssetManager.lua_memory();
+					ImGui::LabelText("Material Lua Memory", "%.1f KiB (peak %.1f KiB)", memory.bytes / 1024.0, memory.peakBytes / 1024.0);
+					ImGui::LabelText("Material Lua Allocations", "%zu (%zu large)", memory.allocations, memory.largeAllocations);
+				}
+
+				{
+					float budget = static_cast<float>(mScriptSystem.mBudget * 1000.0);
+					if (ImGui::SliderFloat("Script Budget", &budget, 0.1f, 16.0f, "%.1f ms")) mScriptSystem.mBudget = budget / 1000.0;
+					ImGui::LabelText("Scripts", "%zu (%zu deferred)", mScriptSystem.instances(), mScriptSystem.deferred());
+					ImGui::LabelText("Script Time", "%.3fms", mScriptSystem.last_update_time() * 1000.0);
+				}
+
+				if (mWorldStreamer.is_open()) {
+					ImGui::DragFloatRange2("World Streaming Radius", &mWorldStreamer.mLoadRadius, &mWorldStreamer.mUnloadRadius, 1.0f, 0.0f, 4096.0f);
+					ImGui::LabelText("World Cells", "%zu / %zu (%zu loading, %zu failed)", mWorldStreamer.loaded_cells(), mWorldStreamer.cells(), mWorldStreamer.loading_cells(), mWorldStreamer.failed_cells());
+				}
 
 				ImGui::LabelText("Cursor Pos", "%.1f x %.1f", mCursorPos.x, mCursorPos.y);
 				ImGui::LabelText("Cursor Delta", "%.1f x %.1f", mCursorDelta.x, mCursorDelta.y);
@@ -453,6 +464,8 @@ struct Application final {
 
 	rvo::AssetManager mAssetManager;
 	entt::registry mRegistry;
+	rvo::ScriptSystem mScriptSystem{ mRegistry };
+	rvo::WorldStreamer mWorldStreamer;
 
 	std::unordered_set<int> mKeysDown;
 	rvo::Transform mCameraTransform;
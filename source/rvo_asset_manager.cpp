@@ -1,77 +1,171 @@
 #include "rvo_asset_manager.hpp"
 
 #include "rvo_utility.hpp"
+#include "rvo_vfs.hpp"
 
-#define STB_INCLUDE_LINE_GLSL
-#define STB_INCLUDE_IMPLEMENTATION
-#include "stb_include.h"
+#include "gfx/rvo_mesh_cook.hpp"
+#include "gfx/rvo_program_cache.hpp"
+#include "gfx/rvo_shader_cook.hpp"
 
-#include <regex>
 #include <spdlog/spdlog.h>
 
 #include <lua.hpp>
 
+#include <algorithm>
 #include <cstdint>
+#include <string_view>
+#include <unordered_set>
 
 namespace rvo {
-	namespace {
-		std::optional<rvo::ShaderProgram> make_shader(std::string const& aPath) {
-			auto optBytes = rvo::read_file_string(aPath);
-			if (!optBytes) return std::nullopt;
+	std::optional<rvo::ShaderSource> AssetManager::load_shader_source(std::string const& aPath) {
+		auto const cooked = rvo::cooked_path(aPath, ".rvoshader");
+
+		auto optSource = rvo::read_cooked_shader(aPath, cooked);
+		if (!optSource) {
+			optSource = rvo::preprocess_shader(aPath);
+			if (!optSource) return std::nullopt;
 
-			bool backfaceCulling = true;
+			rvo::write_shader_source(cooked, *optSource);
+		}
 
-			{
-				std::regex pattern(R"(#\s*pragma\s+RVO_NO_BACKFACE_CULL)", std::regex::icase);
+		mShaderInfo[aPath] = { optSource->dependencies, optSource->keywords };
+		return optSource;
+	}
 
-				auto it = std::sregex_iterator(optBytes->begin(), optBytes->end(), pattern);
-				auto end = std::sregex_iterator();
-				std::size_t matchCount = std::distance(it, end);
+	bool AssetManager::build_shader(std::string const& aKey, std::string const& aPath, std::uint64_t aKeywords, std::shared_ptr<rvo::ShaderProgram> const& aTarget) {
+		auto optSource = load_shader_source(aPath);
+		if (!optSource) return false;
+
+		rvo::ShaderSource const source = optSource->permutation(aKeywords);
+
+		PendingShader pending;
+		pending.target = aTarget;
+		pending.cachePath = rvo::program_cache_path(aPath, aKeywords);
+		pending.cacheKey = rvo::program_cache_key(source);
+		pending.backfaceCull = source.backfaceCull;
+		pending.depthPrepass = source.depthPrepass;
+		pending.compute = source.is_compute();
+
+		// A build started for an older version of the file is dropped
+		mPendingShaders.erase(aKey);
+
+		if (auto program = rvo::load_cached_program(pending.cachePath, pending.cacheKey)) {
+			program->mBackfaceCull = pending.backfaceCull;
+			program->mDepthPrepass = pending.depthPrepass;
+			program->mCompute = pending.compute;
+			*aTarget = std::move(*program);
+			return true;
+		}
 
-				*optBytes = std::regex_replace(*optBytes, pattern, "// $&");
+		if (pending.compute) {
+			rvo::ProgramBuild::Stage const stages[] = { { GL_COMPUTE_SHADER, source.compute } };
+			pending.build = rvo::ProgramBuild(stages);
+		}
+		else {
+			rvo::ProgramBuild::Stage const stages[] = { { GL_VERTEX_SHADER, source.vertex }, { GL_FRAGMENT_SHADER, source.fragment } };
+			pending.build = rvo::ProgramBuild(stages);
+		}
 
-				if (matchCount > 0) {
-					backfaceCulling = false;
-				}
+		mPendingShaders.emplace(aKey, std::move(pending));
+		return true;
+	}
+
+	std::filesystem::file_time_type AssetManager::newest_shader_write_time(std::string const& aPath) const {
+		auto newest = rvo::vfs::last_write_time(aPath).value_or(std::filesystem::file_time_type::min());
+
+		if (auto it = mShaderInfo.find(aPath); it != mShaderInfo.end()) {
+			for (auto const& dependency : it->second.dependencies) {
+				newest = std::max(newest, rvo::vfs::last_write_time(dependency).value_or(std::filesystem::file_time_type::min()));
 			}
+		}
+
+		return newest;
+	}
+
+	void AssetManager::finish_shader_builds(bool aWait) {
+		for (auto it = mPendingShaders.begin(); it != mPendingShaders.end();) {
+			auto& pending = it->second;
 
-			char error[256];
-			char* vertSource = stb_include_string(optBytes->c_str(), "#version 460 core\n#define RVO_VERT\n", "shaders/include", aPath.c_str(), error);
-			char* fragSource = stb_include_string(optBytes->c_str(), "#version 460 core\n#define RVO_FRAG\n", "shaders/include", aPath.c_str(), error);
+			if (!aWait && !pending.build.ready()) {
+				++it;
+				continue;
+			}
 
-			auto vert = rvo::Shader(GL_VERTEX_SHADER, vertSource);
-			auto frag = rvo::Shader(GL_FRAGMENT_SHADER, fragSource);
+			if (auto ref = pending.target.lock()) {
+				// On failure the target keeps its last working program
+				if (auto program = pending.build.finish()) {
+					rvo::store_cached_program(pending.cachePath, pending.cacheKey, *program);
 
-			std::free(vertSource);
-			std::free(fragSource);
+					program->mBackfaceCull = pending.backfaceCull;
+					program->mDepthPrepass = pending.depthPrepass;
+					program->mCompute = pending.compute;
+					*ref = std::move(*program);
+				}
+			}
 
-			auto program = rvo::ShaderProgram({ vert, frag });
-			program.mBackfaceCull = backfaceCulling;
-			return program;
+			it = mPendingShaders.erase(it);
 		}
 	}
 
-	std::shared_ptr<rvo::ShaderProgram> AssetManager::get_shader_program(std::string_view aSource) {
-		auto it = mShaderPrograms.find(aSource);
+	std::shared_ptr<rvo::ShaderProgram> AssetManager::get_shader_program(std::string_view aSource, std::span<std::string const> aKeywords) {
+		std::string const path(aSource);
+		std::uint64_t keywords = 0;
+
+		if (!aKeywords.empty()) {
+			// Bits follow the order the shader declares its keywords in, which is only known once it has been read
+			auto info = mShaderInfo.find(path);
+			if (info == mShaderInfo.end()) {
+				if (!load_shader_source(path)) return nullptr;
+				info = mShaderInfo.find(path);
+			}
+
+			for (auto const& keyword : aKeywords) {
+				auto const& declared = info->second.keywords;
+				auto it = std::ranges::find(declared, keyword);
+
+				if (it == declared.end()) {
+					spdlog::warn("Shader `{}` does not declare keyword `{}`", path, keyword);
+					continue;
+				}
+
+				keywords |= std::uint64_t(1) << (it - declared.begin());
+			}
+		}
+
+		std::string const key = keywords ? fmt::format("{}#{:x}", path, keywords) : path;
+
+		auto it = mShaderPrograms.find(key);
 		if (std::shared_ptr<rvo::ShaderProgram> ref; it != mShaderPrograms.end() && (ref = it->second.asset.lock())) return ref;
 
-		auto program = make_shader(std::string(aSource));
-		if (!program) return nullptr;
+		// Empty until the build finishes, see `finish_shader_builds`
+		auto ref = std::make_shared<rvo::ShaderProgram>();
+		if (!build_shader(key, path, keywords, ref)) return nullptr;
 
-		auto ref = std::make_shared<rvo::ShaderProgram>(std::move(*program));
-		mShaderPrograms[std::string(aSource)] = { ref, std::filesystem::last_write_time(aSource) };
+		mShaderPrograms[key] = { ref, newest_shader_write_time(path), path, keywords };
+		spdlog::info("Loaded shader permutation `{}`, {} in total", key, shader_permutations());
 		return ref;
 	}
 
+	std::size_t AssetManager::shader_permutations() const noexcept {
+		// Released permutations stay in the map until the next prune in update
+		return std::ranges::count_if(mShaderPrograms, [](auto const& aEntry) { return !aEntry.second.asset.expired(); });
+	}
+
 	std::shared_ptr<rvo::Mesh> AssetManager::get_mesh(std::string_view aSource) {
 		auto it = mMeshes.find(aSource);
 		if (std::shared_ptr<rvo::Mesh> ref; it != mMeshes.end() && (ref = it->second.asset.lock())) return ref;
 
-		auto optBytes = rvo::read_file_bytes(aSource);
-		if (!optBytes) return nullptr;
+		auto const cooked = rvo::cooked_path(aSource, ".rvomesh");
+
+		if (!rvo::is_cooked_up_to_date(aSource, cooked) && !rvo::cook_mesh(aSource, cooked)) {
+			return nullptr;
+		}
+
+		auto optData = rvo::read_mesh_data(cooked);
+		if (!optData) return nullptr;
 
-		auto ref = std::make_shared<rvo::Mesh>(std::string(aSource).c_str());
-		mMeshes[std::string(aSource)] = { ref, std::filesystem::last_write_time(aSource) };
+		auto ref = std::make_shared<rvo::Mesh>(*optData);
+		mMeshes[std::string(aSource)] = { ref, rvo::vfs::last_write_time(aSource).value_or(std::filesystem::file_time_type::min()) };
 		return ref;
 	}
 
@@ -79,8 +173,10 @@ namespace rvo {
 		auto it = mTextures.find(aSource);
 		if (std::shared_ptr<rvo::Texture> ref; it != mTextures.end() && (ref = it->second.asset.lock())) return ref;
 
-		auto ref = std::make_shared<rvo::Texture>(rvo::Texture::make_from_path(std::string(aSource).c_str()));
-		mTextures[std::string(aSource)] = { ref, std::filesystem::last_write_time(aSource) };
+		auto ref = mTextureStreamer.load(aSource);
+		if (!ref) return nullptr;
+
+		mTextures[std::string(aSource)] = { ref, rvo::vfs::last_write_time(aSource).value_or(std::filesystem::file_time_type::min()) };
 		return ref;
 	}
 
@@ -88,19 +184,37 @@ namespace rvo {
 		auto it = mMaterials.find(aSource);
 		if (std::shared_ptr<rvo::Material> ref; it != mMaterials.end() && (ref = it->second.asset.lock())) return ref;
 
-		lua_State* L = luaL_newstate();
-		luaL_openlibs(L);
+		// Every material runs in the same state, the stack is restored to top on every path
+		lua_State* L = mLua.get();
+		int const top = lua_gettop(L);
 
-		if (luaL_dofile(L, std::string(aSource).c_str()) != LUA_OK) {
+		if (!rvo::run_lua_file(L, aSource, 1)) {
 			spdlog::warn("Failed to load material `{}`: {}", aSource, lua_tostring(L, -1));
-			lua_pop(L, 1);
+			lua_settop(L, top);
+			return nullptr;
+		}
+
+		if (!lua_istable(L, -1)) {
+			spdlog::warn("Material `{}` does not return a table", aSource);
+			lua_settop(L, top);
 			return nullptr;
 		}
 
 		auto ref = std::make_shared<rvo::Material>();
 
+		// { "KEYWORD", ... } selects the shader permutation
+		std::vector<std::string> keywords;
+		if (lua_getfield(L, -1, "keywords") == LUA_TTABLE) {
+			for (lua_Integer i = 1; lua_rawgeti(L, -1, i) == LUA_TSTRING; ++i) {
+				keywords.emplace_back(lua_tostring(L, -1));
+				lua_pop(L, 1);
+			}
+			lua_pop(L, 1);
+		}
+		lua_pop(L, 1);
+
 		if (lua_getfield(L, -1, "shaderProgram") == LUA_TSTRING) {
-			ref->mShaderProgram = get_shader_program(lua_tostring(L, -1));
+			ref->mShaderProgram = get_shader_program(lua_tostring(L, -1), keywords);
 		}
 		lua_pop(L, 1);
 
@@ -109,6 +223,30 @@ namespace rvo {
 		}
 		lua_pop(L, 1);
 
+		if (lua_getfield(L, -1, "textureTiling") == LUA_TNUMBER) {
+			float const tiling = static_cast<float>(lua_tonumber(L, -1));
+			if (tiling > 0.0f) ref->mTextureTiling = tiling;
+			else spdlog::warn("Material `{}` has a textureTiling that is not positive", aSource);
+		}
+		lua_pop(L, 1);
+
+		// { source = "textures/x.png", tiles = n }
+		if (lua_getfield(L, -1, "virtualTexture") == LUA_TTABLE) {
+			lua_getfield(L, -1, "source");
+			lua_getfield(L, -2, "tiles");
+
+			if (lua_isstring(L, -2)) {
+				lua_Integer const tiles = lua_isinteger(L, -1) ? lua_tointeger(L, -1) : 1;
+				ref->mVirtualTexture = mVirtualTextureSystem.load(lua_tostring(L, -2), static_cast<std::uint32_t>(tiles > 0 ? tiles : 1));
+			}
+			else {
+				spdlog::warn("Material `{}` has a virtualTexture without a source", aSource);
+			}
+
+			lua_pop(L, 2);
+		}
+		lua_pop(L, 1);
+
 		if (lua_getfield(L, -1, "fields") == LUA_TTABLE) {
 			lua_pushnil(L);
 
@@ -126,7 +264,8 @@ namespace rvo {
 						lua_pop(L, 1);
 					}
 
-					ref->mFields[std::move(key)] = value;
+					rvo::UniformId const id(key);
+					ref->mFields.push_back({ std::move(key), id, value });
 				}
 				else {
 					spdlog::warn("Unsupported field: {}", key);
@@ -137,9 +276,9 @@ namespace rvo {
 		}
 		lua_pop(L, 1);
 
-		lua_close(L);
+		lua_settop(L, top);
 
-		mMaterials[std::string(aSource)] = { ref, std::filesystem::last_write_time(aSource) };
+		mMaterials[std::string(aSource)] = { ref, rvo::vfs::last_write_time(aSource).value_or(std::filesystem::file_time_type::min()) };
 		return ref;
 	}
 
@@ -148,6 +287,8 @@ namespace rvo {
 	}
 
 	void AssetManager::update() {
+		finish_shader_builds(false);
+
 		// Once every 100 frames to reduce frame costs
 		if (gCount++ < 100) return;
 		gCount = 0;
@@ -155,12 +296,11 @@ namespace rvo {
 		// Hot swapping shader support :D
 		for (auto it = mShaderPrograms.begin(); it != mShaderPrograms.end();) {
 			if (auto ref = it->second.asset.lock()) {
-				if (std::filesystem::file_time_type newTime; (newTime = std::filesystem::last_write_time(it->first)) > it->second.lastWriteTime) {
+				if (auto newTime = newest_shader_write_time(it->second.source); newTime > it->second.lastWriteTime) {
 					it->second.lastWriteTime = newTime;
 
-					if (auto shader = make_shader(it->first)) {
-						*ref.get() = std::move(*shader);
-					}
+					// The current program stays in use until the new one is built
+					build_shader(it->first, it->second.source, it->second.keywords, ref);
 				}
 
 				++it;
@@ -170,6 +310,11 @@ namespace rvo {
 			}
 		}
 
+		// Sources no permutation uses any more, get_shader_program reads them again if they come back
+		std::unordered_set<std::string_view> usedSources;
+		for (auto const& [key, reference] : mShaderPrograms) usedSources.insert(reference.source);
+		std::erase_if(mShaderInfo, [&](auto const& aEntry) { return !usedSources.contains(aEntry.first); });
+
 		for (auto it = mMeshes.begin(); it != mMeshes.end();) {
 			if (it->second.asset.expired()) { it = mMeshes.erase(it); }
 			else { ++it; }
@@ -1,12 +1,21 @@
 #pragma once
 
 #include "rvo_gfx.hpp"
+#include "rvo_lua.hpp"
 #include "rvo_utility.hpp"
 #include "rvo_material.hpp"
+#include "rvo_texture_streamer.hpp"
+#include "rvo_virtual_texture.hpp"
 
+#include "gfx/rvo_shader_cook.hpp"
+
+#include <cstdint>
 #include <string>
 #include <memory>
+#include <optional>
+#include <span>
 #include <unordered_map>
+#include <vector>
 #include <filesystem>
 
 namespace rvo {
@@ -18,16 +27,59 @@ namespace rvo {
 			std::filesystem::file_time_type lastWriteTime;
 		};
 
-		std::shared_ptr<rvo::ShaderProgram> get_shader_program(std::string_view aSource);
+		// One permutation per set of aKeywords, out of those the shader declares with `#pragma RVO_KEYWORDS`
+		std::shared_ptr<rvo::ShaderProgram> get_shader_program(std::string_view aSource, std::span<std::string const> aKeywords = {});
 		std::shared_ptr<rvo::Mesh> get_mesh(std::string_view aSource);
 		std::shared_ptr<rvo::Texture> get_texture(std::string_view aSource);
 		std::shared_ptr<rvo::Material> get_material(std::string_view aSource);
 
 		void update();
+		rvo::LuaMemoryStats const& lua_memory() const noexcept { return mLua.memory(); }
+		// Live permutations only
+		std::size_t shader_permutations() const noexcept;
+		// Swaps finished shader builds into their programs, aWait blocks until every build is done
+		void finish_shader_builds(bool aWait);
+	private:
+		struct PendingShader final {
+			std::weak_ptr<rvo::ShaderProgram> target;
+			rvo::ProgramBuild build;
+			std::filesystem::path cachePath;
+			std::uint64_t cacheKey = 0;
+			bool backfaceCull = true;
+			bool depthPrepass = true;
+			bool compute = false;
+		};
+
+		struct ShaderInfo final {
+			std::vector<std::filesystem::path> dependencies;
+			std::vector<std::string> keywords;
+		};
+
+		// Cooked or freshly preprocessed, also refreshes mShaderInfo
+		std::optional<rvo::ShaderSource> load_shader_source(std::string const& aPath);
+		// Loads the aKeywords permutation of aPath from the program cache or starts building it, false when it cannot be preprocessed
+		bool build_shader(std::string const& aKey, std::string const& aPath, std::uint64_t aKeywords, std::shared_ptr<rvo::ShaderProgram> const& aTarget);
+
+		// Newest of aPath and everything it includes, so editing an include reloads every shader using it
+		std::filesystem::file_time_type newest_shader_write_time(std::string const& aPath) const;
+
+		rvo::LuaState mLua; // Material files, pooled since it lives as long as the AssetManager
+		rvo::UnorderedStringMap<PendingShader> mPendingShaders;
+		rvo::UnorderedStringMap<ShaderInfo> mShaderInfo;
 	public:
-		rvo::UnorderedStringMap<AssetReference<rvo::ShaderProgram>> mShaderPrograms;
+		struct ShaderReference final {
+			std::weak_ptr<rvo::ShaderProgram> asset;
+			std::filesystem::file_time_type lastWriteTime;
+			std::string source;
+			std::uint64_t keywords = 0;
+		};
+
+		// Keyed by path, with `#<keyword mask in hex>` appended for permutations
+		rvo::UnorderedStringMap<ShaderReference> mShaderPrograms;
 		rvo::UnorderedStringMap<AssetReference<rvo::Mesh>> mMeshes;
 		rvo::UnorderedStringMap<AssetReference<rvo::Texture>> mTextures;
 		rvo::UnorderedStringMap<AssetReference<rvo::Material>> mMaterials;
+		rvo::TextureStreamer mTextureStreamer;
+		rvo::VirtualTextureSystem mVirtualTextureSystem;
 	};
 }
\ No newline at end of file
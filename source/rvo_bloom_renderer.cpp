@@ -57,14 +57,14 @@ namespace rvo {
 
 			auto const& srcSize = mViewportSize;
 			auto const& dstSize = mMipSizes[level];
-			mProgramDownsample->push_2f("srcResolution", srcSize);
+			mProgramDownsample->push_2f("srcResolution"_u, srcSize);
 			glNamedFramebufferTexture(mFramebuffer.handle(), GL_COLOR_ATTACHMENT0, mMipChain.handle(), level);
 
-			mProgramDownsample->push_1i("uBasePass", 1);
+			mProgramDownsample->push_1i("uBasePass"_u, 1);
 			glViewport(0, 0, dstSize.x, dstSize.y);
 			glDrawArrays(GL_TRIANGLES, 0, 3);
 			glTextureBarrier();
-			mProgramDownsample->push_1i("uBasePass", 0);
+			mProgramDownsample->push_1i("uBasePass"_u, 0);
 		}
 
 		// Bind once since texture is the input for all rest of mip chains
@@ -73,7 +73,7 @@ namespace rvo {
 		for (int level = 1; level < mMipSizes.size(); ++level) {
 			auto const& srcSize = mMipSizes[level - 1];
 			auto const& dstSize = mMipSizes[level];
-			mProgramDownsample->push_2f("srcResolution", srcSize);
+			mProgramDownsample->push_2f("srcResolution"_u, srcSize);
 
 			glTextureParameteri(mMipChain.handle(), GL_TEXTURE_BASE_LEVEL, level - 1);
 			glTextureParameteri(mMipChain.handle(), GL_TEXTURE_MAX_LEVEL, level - 1);
@@ -86,8 +86,8 @@ namespace rvo {
 
 		// Upsample
 		mProgramUpsample->bind();
-		mProgramUpsample->push_1f("filterRadius", aFilterRadius);
-		mProgramUpsample->push_1f("aspectRatio", aAspectRatio);
+		mProgramUpsample->push_1f("filterRadius"_u, aFilterRadius);
+		mProgramUpsample->push_1f("aspectRatio"_u, aAspectRatio);
 
 		glEnable(GL_BLEND);
 		glBlendFunc(GL_ONE, GL_ONE);
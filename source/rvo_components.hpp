@@ -4,14 +4,26 @@
 #include "rvo_material.hpp"
 #include "rvo_transform.hpp"
 
+#include <cstdint>
 #include <string>
 #include <memory>
 
 namespace rvo {
+	// Identifies an entity made by a scene across reloads, see `assign_scene_ids`
+	struct SceneId final {
+		std::uint64_t mValue;
+	};
+
+	// Only what every frame reads, walked by the renderer for each entity
+	// Editor data lives in `EditorData` so it never shares cache lines with the transforms
 	struct GameObject final {
-		bool mEnabled = true;
 		rvo::Transform mTransform;
-		std::string mName = "Unnamed";
+		bool mEnabled = true;
+	};
+
+	// Cold data only the editor, scripts and scene files look at, see `entity_name`
+	struct EditorData final {
+		std::string mName;
 	};
 
 	struct MeshRenderer final {
@@ -19,10 +31,30 @@ namespace rvo {
 		std::shared_ptr<rvo::Material> mMaterial;
 	};
 
+	// What every instance of a prefab shares, stored once and never changed while instances exist
+	struct Prefab final {
+		std::string mName;
+		std::shared_ptr<rvo::Mesh> mMesh;
+		std::shared_ptr<rvo::Material> mMaterial;
+		std::string mScript; // Bound like a Script component on every instance when not empty
+	};
+
+	// Instances only own their GameObject and have no EditorData, `entity_name` makes `<prefab> <mIndex>` when asked
+	// A name given in EditorData overrides it
+	struct PrefabInstance final {
+		std::shared_ptr<Prefab const> mPrefab;
+		std::uint32_t mIndex = 0;
+	};
+
 	struct DirectionalLight final {
 		glm::vec3 color;
 	};
 
+	// See `ScriptSystem`, mSource is bound once when the component is added
+	struct Script final {
+		std::string mSource;
+	};
+
 	struct Camera final {
 		glm::vec2 clippingPlanes = { 0.02f, 256.0f };
 		float aspect = 0.0f;
@@ -1,6 +1,7 @@
 #include "rvo_gui_panels.hpp"
 
 #include "rvo_components.hpp"
+#include "rvo_scene.hpp"
 #include <glm/gtc/type_ptr.hpp>
 
 #include <imgui.h>
@@ -13,12 +14,12 @@ namespace rvo {
 			return;
 		}
 
-		for (auto [entity, gameObject] : aRegistry.view<rvo::GameObject>().each()) {
+		for (entt::entity entity : aRegistry.view<rvo::GameObject>()) {
 			ImGui::PushID(static_cast<int>(entity));
 
 			ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_Leaf;
 			if (entity == aState.mEditorSelection) flags |= ImGuiTreeNodeFlags_Selected;
-			bool opened = ImGui::TreeNodeEx(gameObject.mName.c_str(), flags);
+			bool opened = ImGui::TreeNodeEx(entity_name(aRegistry, entity).c_str(), flags);
 
 			if (ImGui::IsItemActivated()) {
 				aState.mEditorSelection = entity;
@@ -45,7 +46,12 @@ namespace rvo {
 		if (auto* component = aHandle.try_get<rvo::GameObject>()) {
 			if (ImGui::CollapsingHeader("GameObject")) {
 				ImGui::Checkbox("Enabled", &component->mEnabled);
-				ImGui::InputText("Name", &component->mName);
+
+				// Prefab instances show their generated name until they are given one
+				std::string const name = entity_name(*aHandle.registry(), aHandle.entity());
+				std::string edited = aHandle.all_of<rvo::EditorData>() ? aHandle.get<rvo::EditorData>().mName : std::string();
+				if (ImGui::InputTextWithHint("Name", name.c_str(), &edited)) aHandle.emplace_or_replace<rvo::EditorData>(std::move(edited));
+
 				ImGui::Separator();
 				component->mTransform.gui();
 			}
@@ -55,20 +61,34 @@ namespace rvo {
 			if (ImGui::CollapsingHeader("MeshRenderer")) {
 				ImGui::SeparatorText("Fields");
 
-				for (auto& [key, field] : component->mMaterial->mFields) {
-					if (auto* value = std::any_cast<glm::vec3>(&field)) {
-						ImGui::DragFloat3(key.c_str(), glm::value_ptr(*value));
+				for (auto& field : component->mMaterial->mFields) {
+					if (auto* value = std::any_cast<glm::vec3>(&field.value)) {
+						ImGui::DragFloat3(field.name.c_str(), glm::value_ptr(*value));
 					}
 				}
 			}
 		}
 
+		if (auto* component = aHandle.try_get<rvo::PrefabInstance>()) {
+			if (ImGui::CollapsingHeader("Prefab")) {
+				ImGui::LabelText("Prefab", "%s", component->mPrefab->mName.c_str());
+				ImGui::LabelText("Index", "%u", component->mIndex);
+				if (!component->mPrefab->mScript.empty()) ImGui::LabelText("Script", "%s", component->mPrefab->mScript.c_str());
+			}
+		}
+
 		if (auto* component = aHandle.try_get<rvo::DirectionalLight>()) {
 			if (ImGui::CollapsingHeader("DirectionalLight")) {
 				ImGui::ColorEdit3("Color", glm::value_ptr(component->color));
 			}
 		}
 
+		if (auto* component = aHandle.try_get<rvo::Script>()) {
+			if (ImGui::CollapsingHeader("Script")) {
+				ImGui::LabelText("Source", "%s", component->mSource.c_str());
+			}
+		}
+
 		ImGui::End();
 	}
 }
\ No newline at end of file
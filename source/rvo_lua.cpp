@@ -0,0 +1,477 @@
+#include "rvo_lua.hpp"
+
+#include "rvo_utility.hpp"
+#include "rvo_vfs.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <lua.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rvo {
+	namespace {
+		// Registry key of the metatable every chunk environment uses
+		constexpr char const* kSandbox = "rvo.sandbox";
+		// Registry key of a table holding the proxy metatable of each library by name
+		constexpr char const* kLibraryProxies = "rvo.library_proxies";
+
+		using Bytecode = std::shared_ptr<std::vector<std::byte> const>;
+
+		std::mutex gBytecodeMutex;
+		std::unordered_map<std::uint64_t, Bytecode> gBytecode;
+
+		// A cache file is this header followed by the dump, undump trusts its input so files that fail the hash are never loaded
+		struct BytecodeFileHeader final {
+			char magic[4] = { 'R', 'L', 'B', '1' };
+			std::uint32_t _padding = 0;
+			std::uint64_t hash = 0; // fnv1a of the dump
+		};
+
+		static_assert(sizeof(BytecodeFileHeader) == 16);
+
+		std::filesystem::path bytecode_path(std::uint64_t aKey) {
+			return fmt::format("cache/lua/{:016x}.luac", aKey);
+		}
+
+		int write_bytecode(lua_State*, void const* aData, std::size_t aSize, void* aUser) {
+			auto& bytes = *static_cast<std::vector<std::byte>*>(aUser);
+			auto const data = static_cast<std::byte const*>(aData);
+			bytes.insert(bytes.end(), data, data + aSize);
+			return 0;
+		}
+
+		// Written next to the final path and renamed over it, so a crash mid write never leaves a truncated file behind
+		void store_bytecode(std::filesystem::path const& aPath, std::vector<std::byte> const& aBytecode) {
+			std::error_code error;
+			std::filesystem::create_directories(aPath.parent_path(), error);
+
+			BytecodeFileHeader header;
+			header.hash = fnv1a(aBytecode);
+
+			std::filesystem::path temporary = aPath;
+			temporary += ".tmp";
+
+			{
+				std::ofstream stream(temporary, std::ios::binary);
+				stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+				stream.write(reinterpret_cast<char const*>(aBytecode.data()), aBytecode.size());
+				stream.close();
+
+				if (!stream) {
+					spdlog::warn("Failed to write `{}`", temporary.generic_string());
+					std::filesystem::remove(temporary, error);
+					return;
+				}
+			}
+
+			std::filesystem::rename(temporary, aPath, error);
+			if (error) {
+				spdlog::warn("Failed to replace `{}`: {}", aPath.generic_string(), error.message());
+				std::filesystem::remove(temporary, error);
+			}
+		}
+
+		// Compiles aSource and saves its bytecode, replacing a rejected entry. The lock keeps two states from writing the same file
+		Bytecode compile(lua_State* L, std::string_view aSource, std::string const& aChunkName, std::uint64_t aKey) {
+			if (luaL_loadbufferx(L, aSource.data(), aSource.size(), aChunkName.c_str(), "t") != LUA_OK) return nullptr;
+
+			auto bytecode = std::make_shared<std::vector<std::byte>>();
+			lua_dump(L, write_bytecode, bytecode.get(), 0);
+
+			std::lock_guard lock(gBytecodeMutex);
+			gBytecode.insert_or_assign(aKey, bytecode);
+			store_bytecode(bytecode_path(aKey), *bytecode);
+
+			return bytecode;
+		}
+
+		Bytecode cached_bytecode(std::uint64_t aKey) {
+			{
+				std::lock_guard lock(gBytecodeMutex);
+				if (auto it = gBytecode.find(aKey); it != gBytecode.end()) return it->second;
+			}
+
+			MappedFile const file(bytecode_path(aKey));
+			if (!file || file.bytes().size() <= sizeof(BytecodeFileHeader)) return nullptr;
+
+			BytecodeFileHeader header;
+			std::memcpy(&header, file.bytes().data(), sizeof(header));
+			std::span<std::byte const> const dump = file.bytes().subspan(sizeof(header));
+
+			// Truncated, corrupt or not written by compile, it is recompiled and replaced
+			if (std::memcmp(header.magic, BytecodeFileHeader().magic, sizeof(header.magic)) != 0 || header.hash != fnv1a(dump)) return nullptr;
+
+			auto bytecode = std::make_shared<std::vector<std::byte> const>(dump.begin(), dump.end());
+
+			std::lock_guard lock(gBytecodeMutex);
+			return gBytecode.try_emplace(aKey, std::move(bytecode)).first->second;
+		}
+
+		int read_only(lua_State* L) {
+			return luaL_error(L, "attempt to modify a library, libraries are shared by every chunk");
+		}
+
+		// pairs walks the library behind a proxy
+		int library_pairs(lua_State* L) {
+			lua_getmetatable(L, 1);
+			lua_getglobal(L, "next");
+			lua_getfield(L, -2, "__index");
+			lua_pushnil(L);
+			return 3;
+		}
+
+		// A table of its own that reads through to the shared globals, with a read only proxy of every library
+		// A rawset on a proxy only reaches that proxy, so one chunk can never change what another sees
+		void push_sandbox(lua_State* L) {
+			lua_newtable(L);
+			int const env = lua_gettop(L);
+
+			luaL_getmetatable(L, kLibraryProxies);
+			lua_pushnil(L);
+			while (lua_next(L, -2)) {
+				lua_newtable(L);
+				lua_insert(L, -2);
+				lua_setmetatable(L, -2);
+				lua_pushvalue(L, -2);
+				lua_insert(L, -2);
+				lua_rawset(L, env);
+			}
+			lua_pop(L, 1);
+
+			// The shared `_G` is the global table itself
+			lua_pushvalue(L, env);
+			lua_setfield(L, env, LUA_GNAME);
+
+			luaL_getmetatable(L, kSandbox);
+			lua_setmetatable(L, env);
+		}
+
+		// `load` for text only, crafted bytecode can break out of the VM
+		// A chunk loaded without an env gets a sandbox of its own instead of the shared globals
+		int load_text(lua_State* L) {
+			bool const hasEnv = !lua_isnone(L, 4);
+			lua_settop(L, 4);
+
+			lua_pushvalue(L, lua_upvalueindex(1));
+			lua_pushvalue(L, 1);
+			lua_pushvalue(L, 2);
+			lua_pushliteral(L, "t");
+			if (hasEnv) lua_pushvalue(L, 4);
+			else push_sandbox(L);
+
+			lua_call(L, 4, LUA_MULTRET);
+			return lua_gettop(L) - 4;
+		}
+
+		// Size classes step by 16 bytes, which is also the alignment of every block
+		constexpr std::size_t kGranularity = 16;
+		constexpr std::size_t kSizeClasses = 16;
+		constexpr std::size_t kMaxPooledSize = kGranularity * kSizeClasses;
+		constexpr std::size_t kSlabSize = 64 * 1024;
+		constexpr std::size_t kArenaBlockSize = 64 * 1024;
+
+		constexpr std::size_t size_class(std::size_t aSize) noexcept { return (aSize - 1) / kGranularity; }
+		constexpr std::size_t align_up(std::size_t aSize) noexcept { return (aSize + kGranularity - 1) & ~(kGranularity - 1); }
+
+		struct FreeBlock final {
+			FreeBlock* next;
+		};
+
+		using FreeLists = std::array<FreeBlock*, kSizeClasses>;
+
+		// Slabs are never returned, a block may be freed by another thread than the one that carved it
+		// Lists of threads that exit are kept here for the next thread that runs dry
+		struct SharedPools final {
+			~SharedPools() noexcept {
+				for (void* slab : slabs) std::free(slab);
+			}
+
+			std::mutex mutex;
+			FreeLists free{};
+			std::vector<void*> slabs;
+		};
+
+		SharedPools gSharedPools;
+
+		struct ThreadPools final {
+			~ThreadPools() noexcept {
+				std::lock_guard lock(gSharedPools.mutex);
+				for (std::size_t i = 0; i < kSizeClasses; ++i) {
+					if (!free[i]) continue;
+
+					FreeBlock* tail = free[i];
+					while (tail->next) tail = tail->next;
+					tail->next = gSharedPools.free[i];
+					gSharedPools.free[i] = free[i];
+				}
+			}
+
+			FreeLists free{};
+		};
+
+		thread_local ThreadPools gThreadPools;
+
+		bool refill(std::size_t aClass) {
+			std::lock_guard lock(gSharedPools.mutex);
+
+			if (gSharedPools.free[aClass]) {
+				std::swap(gThreadPools.free[aClass], gSharedPools.free[aClass]);
+				return true;
+			}
+
+			auto const slab = static_cast<std::byte*>(std::malloc(kSlabSize));
+			if (!slab) return false;
+			gSharedPools.slabs.push_back(slab);
+
+			std::size_t const blockSize = (aClass + 1) * kGranularity;
+			FreeBlock* head = nullptr;
+			for (std::size_t offset = kSlabSize / blockSize * blockSize; offset > 0; offset -= blockSize) {
+				auto const block = reinterpret_cast<FreeBlock*>(slab + offset - blockSize);
+				block->next = head;
+				head = block;
+			}
+
+			gThreadPools.free[aClass] = head;
+			return true;
+		}
+
+		void* allocate_block(std::size_t aSize) {
+			if (aSize > kMaxPooledSize) return std::malloc(aSize);
+
+			std::size_t const sizeClass = size_class(aSize);
+			FreeBlock*& head = gThreadPools.free[sizeClass];
+			if (!head && !refill(sizeClass)) return nullptr;
+
+			FreeBlock* block = head;
+			head = block->next;
+			return block;
+		}
+
+		void free_block(void* aBlock, std::size_t aSize) {
+			if (aSize > kMaxPooledSize) {
+				std::free(aBlock);
+				return;
+			}
+
+			FreeBlock*& head = gThreadPools.free[size_class(aSize)];
+			head = new (aBlock) FreeBlock{ head };
+		}
+	}
+
+	// Lua passes the size of every block back on realloc and free, so blocks carry no header
+	class LuaAllocator final {
+	public:
+		explicit LuaAllocator(LuaAllocation aMode) noexcept : mMode(aMode) {}
+		LuaAllocator(LuaAllocator const&) = delete;
+		LuaAllocator& operator=(LuaAllocator const&) = delete;
+
+		~LuaAllocator() noexcept {
+			for (void* block : mArenaBlocks) std::free(block);
+		}
+
+		static void* allocate(void* aUser, void* aPointer, std::size_t aOldSize, std::size_t aNewSize) {
+			// Without a pointer aOldSize is the type of the new object
+			return static_cast<LuaAllocator*>(aUser)->reallocate(aPointer, aPointer ? aOldSize : 0, aNewSize);
+		}
+
+		LuaMemoryStats mStats;
+	private:
+		void* reallocate(void* aPointer, std::size_t aOldSize, std::size_t aNewSize) {
+			if (aNewSize == 0) {
+				if (aPointer && mMode == LuaAllocation::kPooled) free_block(aPointer, aOldSize);
+				mStats.bytes -= aOldSize;
+				return nullptr;
+			}
+
+			void* const result = mMode == LuaAllocation::kPooled ? reallocate_pooled(aPointer, aOldSize, aNewSize) : reallocate_arena(aPointer, aOldSize, aNewSize);
+			if (!result) return nullptr;
+
+			if (!aPointer) ++mStats.allocations;
+			if (aNewSize > kMaxPooledSize && aOldSize <= kMaxPooledSize) ++mStats.largeAllocations;
+			mStats.bytes = mStats.bytes - aOldSize + aNewSize;
+			mStats.peakBytes = std::max(mStats.peakBytes, mStats.bytes);
+			return result;
+		}
+
+		void* reallocate_pooled(void* aPointer, std::size_t aOldSize, std::size_t aNewSize) {
+			if (aPointer) {
+				bool const wasPooled = aOldSize <= kMaxPooledSize;
+				bool const isPooled = aNewSize <= kMaxPooledSize;
+
+				if (wasPooled && isPooled && size_class(aOldSize) == size_class(aNewSize)) return aPointer;
+				if (!wasPooled && !isPooled) return std::realloc(aPointer, aNewSize);
+			}
+
+			void* const result = allocate_block(aNewSize);
+			if (result && aPointer) {
+				std::memcpy(result, aPointer, std::min(aOldSize, aNewSize));
+				free_block(aPointer, aOldSize);
+			}
+			return result;
+		}
+
+		void* reallocate_arena(void* aPointer, std::size_t aOldSize, std::size_t aNewSize) {
+			// The tail of a shrunk block is only reclaimed when the state closes
+			if (aPointer && aNewSize <= aOldSize) return aPointer;
+
+			auto const bytes = static_cast<std::byte*>(aPointer);
+			std::size_t const size = align_up(aNewSize);
+
+			// The newest block grows in place, the common case for a table or string buffer being filled
+			if (aPointer && bytes + align_up(aOldSize) == mCursor && static_cast<std::size_t>(mEnd - bytes) >= size) {
+				mCursor = bytes + size;
+				return aPointer;
+			}
+
+			void* const result = bump(size);
+			if (result && aPointer) std::memcpy(result, aPointer, aOldSize);
+			return result;
+		}
+
+		void* bump(std::size_t aSize) {
+			if (static_cast<std::size_t>(mEnd - mCursor) >= aSize) {
+				void* const result = mCursor;
+				mCursor += aSize;
+				return result;
+			}
+
+			// Large blocks get a block of their own so the current one keeps its free space
+			std::size_t const blockSize = aSize > kArenaBlockSize / 4 ? aSize : kArenaBlockSize;
+			auto const block = static_cast<std::byte*>(std::malloc(blockSize));
+			if (!block) return nullptr;
+
+			mArenaBlocks.push_back(block);
+			mStats.reservedBytes += blockSize;
+
+			if (blockSize == aSize) return block;
+
+			mCursor = block + aSize;
+			mEnd = block + blockSize;
+			return block;
+		}
+
+		LuaAllocation mMode;
+		std::vector<void*> mArenaBlocks;
+		std::byte* mCursor = nullptr;
+		std::byte* mEnd = nullptr;
+	};
+
+	LuaState::LuaState(LuaAllocation aAllocation) {
+		mAllocator = new LuaAllocator(aAllocation);
+		mState = lua_newstate(&LuaAllocator::allocate, mAllocator);
+		lua_State* L = mState;
+
+		lua_atpanic(L, [](lua_State* L) -> int {
+			spdlog::critical("Unprotected Lua error: {}", lua_tostring(L, -1));
+			return 0;
+		});
+
+		constexpr luaL_Reg kLibraries[] = {
+			{ LUA_GNAME, luaopen_base },
+			{ LUA_TABLIBNAME, luaopen_table },
+			{ LUA_STRLIBNAME, luaopen_string },
+			{ LUA_MATHLIBNAME, luaopen_math },
+			{ LUA_UTF8LIBNAME, luaopen_utf8 },
+			{ LUA_COLIBNAME, luaopen_coroutine },
+		};
+
+		for (luaL_Reg const& library : kLibraries) {
+			luaL_requiref(L, library.name, library.func, 1);
+			lua_pop(L, 1);
+		}
+
+		// Files are read through `rvo::vfs`, never straight from disk
+		lua_pushnil(L);
+		lua_setglobal(L, "dofile");
+		lua_pushnil(L);
+		lua_setglobal(L, "loadfile");
+
+		lua_getglobal(L, "load");
+		lua_pushcclosure(L, load_text, 1);
+		lua_setglobal(L, "load");
+
+		luaL_newmetatable(L, kLibraryProxies);
+		for (luaL_Reg const& library : kLibraries) {
+			if (std::strcmp(library.name, LUA_GNAME) == 0) continue;
+
+			lua_newtable(L);
+			lua_getglobal(L, library.name);
+			lua_setfield(L, -2, "__index");
+			lua_pushcfunction(L, read_only);
+			lua_setfield(L, -2, "__newindex");
+			lua_pushcfunction(L, library_pairs);
+			lua_setfield(L, -2, "__pairs");
+			lua_pushboolean(L, false);
+			lua_setfield(L, -2, "__metatable");
+			lua_setfield(L, -2, library.name);
+		}
+		lua_pop(L, 1);
+
+		// getmetatable("").__index would hand out the string library itself
+		lua_pushliteral(L, "");
+		lua_getmetatable(L, -1);
+		lua_pushboolean(L, false);
+		lua_setfield(L, -2, "__metatable");
+		lua_pop(L, 2);
+
+		luaL_newmetatable(L, kSandbox);
+		lua_pushglobaltable(L);
+		lua_setfield(L, -2, "__index");
+		lua_pushboolean(L, false);
+		lua_setfield(L, -2, "__metatable");
+		lua_pop(L, 1);
+	}
+
+	LuaState::~LuaState() noexcept {
+		if (mState) lua_close(mState);
+		delete mAllocator;
+	}
+
+	LuaMemoryStats const& LuaState::memory() const noexcept {
+		return mAllocator->mStats;
+	}
+
+	bool load_lua_chunk(lua_State* L, std::filesystem::path const& aPath) {
+		auto optSource = vfs::view(aPath);
+		if (!optSource) {
+			lua_pushfstring(L, "`%s` not found", aPath.generic_string().c_str());
+			return false;
+		}
+
+		// The chunk name is part of the key, it is baked into the debug info of the bytecode
+		std::string const chunkName = fmt::format("@{}", aPath.generic_string());
+		std::uint64_t const key = fnv1a(optSource->text(), fnv1a(chunkName));
+
+		Bytecode const bytecode = cached_bytecode(key);
+		bool loaded = bytecode && luaL_loadbufferx(L, reinterpret_cast<char const*>(bytecode->data()), bytecode->size(), chunkName.c_str(), "b") == LUA_OK;
+
+		if (!loaded) {
+			// Bytecode from another Lua build is rejected, recompiling replaces it in memory
+			if (bytecode) lua_pop(L, 1);
+
+			if (!compile(L, optSource->text(), chunkName, key)) return false;
+		}
+
+		// _ENV is the only upvalue of a main chunk
+		push_sandbox(L);
+		lua_setupvalue(L, -2, 1);
+		return true;
+	}
+
+	bool run_lua_file(lua_State* L, std::filesystem::path const& aPath, int aResults) {
+		return load_lua_chunk(L, aPath) && lua_pcall(L, 0, aResults, 0) == LUA_OK;
+	}
+}
\ No newline at end of file
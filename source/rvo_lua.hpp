@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <utility>
+
+struct lua_State;
+
+namespace rvo {
+	struct LuaMemoryStats final {
+		std::size_t bytes = 0; // Held by Lua right now
+		std::size_t peakBytes = 0;
+		std::size_t reservedBytes = 0; // Arena blocks, pooled states share their slabs and reserve nothing of their own
+		std::size_t allocations = 0;
+		std::size_t largeAllocations = 0; // Too large for a size class, straight from malloc
+	};
+
+	enum class LuaAllocation {
+		// Blocks of up to 256 bytes come from size class pools owned by the calling thread, larger ones from malloc
+		kPooled,
+		// Bump allocated, nothing is freed until the state closes and then everything goes at once
+		// For states that run a file or two and are thrown away
+		kArena,
+	};
+
+	class LuaAllocator;
+
+	// Lua for data files and scripts, with only the base, table, string, math, utf8 and coroutine libraries and without dofile or loadfile
+	// `load` takes text chunks only, and chunks see the libraries through read only proxies so none can change them for the others
+	// Open one and keep it, opening libraries costs far more than running a material
+	class LuaState final {
+	public:
+		explicit LuaState(LuaAllocation aAllocation = LuaAllocation::kPooled);
+		LuaState(LuaState const&) = delete;
+		LuaState& operator=(LuaState const&) = delete;
+		inline LuaState(LuaState&& aOther) noexcept { swap(aOther); }
+		inline LuaState& operator=(LuaState&& aOther) noexcept { swap(aOther); return *this; }
+		~LuaState() noexcept;
+
+		inline void swap(LuaState& aOther) noexcept {
+			std::swap(mState, aOther.mState);
+			std::swap(mAllocator, aOther.mAllocator);
+		}
+
+		lua_State* get() const noexcept { return mState; }
+		LuaMemoryStats const& memory() const noexcept;
+	private:
+		lua_State* mState = nullptr;
+		LuaAllocator* mAllocator = nullptr;
+	};
+
+	// Pushes aPath as a function whose globals are a table of its own that reads through to the shared globals
+	// Writes to a global stay in that table, the shared globals are only changed from C++
+	// Compiled chunks are kept as bytecode keyed by a hash of the source, in memory and under `cache/lua/`
+	// Cache files carry a hash of their bytecode and are recompiled when it does not match
+	// On failure pushes the error message instead and returns false
+	bool load_lua_chunk(lua_State* L, std::filesystem::path const& aPath);
+
+	// load_lua_chunk and call it, leaving aResults values or the error message
+	bool run_lua_file(lua_State* L, std::filesystem::path const& aPath, int aResults);
+}
\ No newline at end of file
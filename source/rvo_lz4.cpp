@@ -0,0 +1,158 @@
+#include "rvo_lz4.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+namespace rvo {
+	namespace {
+		constexpr std::size_t kMinMatch = 4;
+		// The format requires the last match to start 12 bytes before the end and the last 5 bytes to be literals
+		constexpr std::size_t kMatchSearchEnd = 12;
+		constexpr std::size_t kLastLiterals = 5;
+		constexpr std::size_t kMaxOffset = 65535;
+		constexpr int kHashBits = 16;
+
+		std::uint32_t load32(std::byte const* aPointer) noexcept {
+			std::uint32_t value;
+			std::memcpy(&value, aPointer, sizeof(value));
+			return value;
+		}
+
+		std::uint32_t hash(std::uint32_t aSequence) noexcept {
+			return (aSequence * 2654435761u) >> (32 - kHashBits);
+		}
+
+		// Lengths above 14 continue in 255 steps
+		void write_length(std::vector<std::byte>& aOutput, std::size_t aLength) {
+			for (; aLength >= 255; aLength -= 255) aOutput.push_back(std::byte{ 255 });
+			aOutput.push_back(static_cast<std::byte>(aLength));
+		}
+
+		void write_sequence(std::vector<std::byte>& aOutput, std::byte const* aLiterals, std::size_t aLiteralCount, std::size_t aOffset, std::size_t aMatchLength) {
+			std::size_t const matchCode = aMatchLength ? aMatchLength - kMinMatch : 0;
+			std::uint8_t const token = static_cast<std::uint8_t>((aLiteralCount < 15 ? aLiteralCount : 15) << 4 | (matchCode < 15 ? matchCode : 15));
+			aOutput.push_back(static_cast<std::byte>(token));
+
+			if (aLiteralCount >= 15) write_length(aOutput, aLiteralCount - 15);
+			aOutput.insert(aOutput.end(), aLiterals, aLiterals + aLiteralCount);
+
+			// The last sequence carries only literals
+			if (!aMatchLength) return;
+
+			aOutput.push_back(static_cast<std::byte>(aOffset & 0xFF));
+			aOutput.push_back(static_cast<std::byte>(aOffset >> 8));
+			if (matchCode >= 15) write_length(aOutput, matchCode - 15);
+		}
+
+		bool read_length(std::span<std::byte const> aSource, std::size_t& aPosition, std::size_t& aLength) {
+			std::uint8_t byte;
+			do {
+				if (aPosition >= aSource.size()) return false;
+				byte = static_cast<std::uint8_t>(aSource[aPosition++]);
+				aLength += byte;
+			} while (byte == 255);
+
+			return true;
+		}
+	}
+
+	std::vector<std::byte> lz4_compress(std::span<std::byte const> aSource) {
+		std::vector<std::byte> output;
+		output.reserve(lz4_compress_bound(aSource.size()));
+
+		std::byte const* const source = aSource.data();
+		std::size_t const size = aSource.size();
+
+		// Positions are stored plus one so zero means empty
+		std::vector<std::uint32_t> table(std::size_t(1) << kHashBits);
+
+		std::size_t anchor = 0;
+		std::size_t position = 0;
+
+		if (size > kMatchSearchEnd) {
+			std::size_t const searchEnd = size - kMatchSearchEnd;
+
+			while (position < searchEnd) {
+				std::uint32_t const sequence = load32(source + position);
+				std::uint32_t& slot = table[hash(sequence)];
+				std::size_t const candidate = slot;
+				slot = static_cast<std::uint32_t>(position + 1);
+
+				if (candidate == 0 || position - (candidate - 1) > kMaxOffset || load32(source + candidate - 1) != sequence) {
+					// Skip faster through data that does not compress
+					position += 1 + ((position - anchor) >> 6);
+					continue;
+				}
+
+				std::size_t match = candidate - 1;
+
+				// Extend backwards into the pending literals
+				while (position > anchor && match > 0 && source[position - 1] == source[match - 1]) {
+					--position;
+					--match;
+				}
+
+				std::size_t length = kMinMatch;
+				std::size_t const matchLimit = size - kLastLiterals;
+				while (position + length < matchLimit && source[position + length] == source[match + length]) ++length;
+
+				write_sequence(output, source + anchor, position - anchor, position - match, length);
+
+				// Index a position inside the match so the next search sees recent data
+				if (position + length - 2 < searchEnd) {
+					table[hash(load32(source + position + length - 2))] = static_cast<std::uint32_t>(position + length - 2 + 1);
+				}
+
+				position += length;
+				anchor = position;
+			}
+		}
+
+		write_sequence(output, source + anchor, size - anchor, 0, 0);
+		return output;
+	}
+
+	bool lz4_decompress(std::span<std::byte const> aSource, std::span<std::byte> aDestination) {
+		std::size_t in = 0;
+		std::size_t out = 0;
+
+		while (in < aSource.size()) {
+			std::uint8_t const token = static_cast<std::uint8_t>(aSource[in++]);
+
+			std::size_t literals = token >> 4;
+			if (literals == 15 && !read_length(aSource, in, literals)) return false;
+			if (literals > aSource.size() - in || literals > aDestination.size() - out) return false;
+
+			if (literals) std::memcpy(aDestination.data() + out, aSource.data() + in, literals);
+			in += literals;
+			out += literals;
+
+			if (in == aSource.size()) break;
+			if (aSource.size() - in < 2) return false;
+
+			std::size_t const offset = static_cast<std::size_t>(aSource[in]) | static_cast<std::size_t>(aSource[in + 1]) << 8;
+			in += 2;
+			if (offset == 0 || offset > out) return false;
+
+			std::size_t length = token & 0xF;
+			if (length == 15 && !read_length(aSource, in, length)) return false;
+			length += kMinMatch;
+			if (length > aDestination.size() - out) return false;
+
+			// Matches may overlap their own output, which repeats the last offset bytes
+			std::byte* destination = aDestination.data() + out;
+			std::byte const* match = destination - offset;
+			if (offset >= length) {
+				std::memcpy(destination, match, length);
+			}
+			else {
+				for (std::size_t i = 0; i < length; ++i) destination[i] = match[i];
+			}
+
+			out += length;
+		}
+
+		return out == aDestination.size();
+	}
+}
\ No newline at end of file
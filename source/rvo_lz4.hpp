@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <vector>
+
+namespace rvo {
+	// Byte oriented lz77 in the lz4 block format, fast to decode and good enough on text and vertex data
+	// Blocks are independent, there is no frame and no checksum
+
+	// Upper bound of lz4_compress output for aSize input bytes
+	constexpr std::size_t lz4_compress_bound(std::size_t aSize) noexcept { return aSize + aSize / 255 + 16; }
+
+	std::vector<std::byte> lz4_compress(std::span<std::byte const> aSource);
+
+	// aDestination must be exactly the decompressed size, false on malformed input
+	bool lz4_decompress(std::span<std::byte const> aSource, std::span<std::byte> aDestination);
+}
\ No newline at end of file
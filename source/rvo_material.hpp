@@ -4,13 +4,23 @@
 
 #include <memory>
 #include <string>
-#include <unordered_map>
+#include <vector>
 #include <any>
 
 namespace rvo {
+	class VirtualTexture;
+
+	struct MaterialField final {
+		std::string name;
+		rvo::UniformId id; // Hashed once when the material loads
+		std::any value;
+	};
+
 	struct Material final {
 		std::shared_ptr<rvo::ShaderProgram> mShaderProgram;
 		std::shared_ptr<rvo::Texture> mTexture;
-		std::unordered_map<std::string, std::any> mFields;
+		std::shared_ptr<rvo::VirtualTexture> mVirtualTexture;
+		std::vector<MaterialField> mFields;
+		float mTextureTiling = 1.0f; // Repeats of mTexture across the uv range, shaders read it as uTextureTiling
 	};
 }
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include "rvo_pak.hpp"
+
+#include "rvo_lz4.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+namespace rvo {
+	namespace {
+		template<typename T>
+		std::span<T const> view(std::span<std::byte const> aFile, std::uint64_t aOffset, std::size_t aCount) {
+			if (aOffset % alignof(T) != 0 || aOffset > aFile.size() || aCount > (aFile.size() - aOffset) / sizeof(T)) return {};
+			return { reinterpret_cast<T const*>(aFile.data() + aOffset), aCount };
+		}
+	}
+
+	std::string pak_name(std::filesystem::path const& aPath) {
+		std::string name = aPath.lexically_normal().generic_string();
+		if (name.starts_with("./")) name.erase(0, 2);
+		return name;
+	}
+
+	std::optional<Pak> Pak::open(std::filesystem::path const& aPath) {
+		Pak pak;
+		pak.mPath = aPath;
+		pak.mFile = MappedFile(aPath);
+		if (!pak.mFile) return std::nullopt;
+
+		std::span<std::byte const> const file = pak.mFile.bytes();
+
+		PakHeader header;
+		if (file.size() < sizeof(header)) return std::nullopt;
+		std::memcpy(&header, file.data(), sizeof(header));
+
+		if (std::memcmp(header.magic, PakHeader().magic, sizeof(header.magic)) != 0 || header.version != PakHeader().version || header.blockSize != kPakBlockSize) {
+			spdlog::error("`{}` is not a supported pak", aPath.string());
+			return std::nullopt;
+		}
+
+		pak.mEntries = view<PakEntry>(file, header.entriesOffset, header.entryCount);
+		if (pak.mEntries.size() != header.entryCount || header.namesOffset > file.size()) {
+			spdlog::error("`{}` is truncated", aPath.string());
+			return std::nullopt;
+		}
+
+		std::size_t blockCount = 0;
+		for (PakEntry const& entry : pak.mEntries) blockCount = std::max<std::size_t>(blockCount, std::size_t(entry.firstBlock) + entry.blockCount);
+
+		pak.mBlocks = view<PakBlock>(file, header.blocksOffset, blockCount);
+		pak.mNames = { reinterpret_cast<char const*>(file.data() + header.namesOffset), file.size() - header.namesOffset };
+
+		bool const valid = pak.mBlocks.size() == blockCount
+			&& std::ranges::all_of(pak.mEntries, [&](PakEntry const& aEntry) { return std::size_t(aEntry.nameOffset) + aEntry.nameLength <= pak.mNames.size(); })
+			&& std::ranges::all_of(pak.mBlocks, [&](PakBlock const& aBlock) { return aBlock.rawSize <= kPakBlockSize && aBlock.offset <= file.size() && aBlock.size <= file.size() - aBlock.offset; });
+
+		if (!valid) {
+			spdlog::error("`{}` is corrupt", aPath.string());
+			return std::nullopt;
+		}
+
+		return pak;
+	}
+
+	PakEntry const* Pak::find(std::string_view aName) const noexcept {
+		std::uint64_t const hash = fnv1a(aName);
+
+		auto it = std::ranges::lower_bound(mEntries, hash, {}, &PakEntry::hash);
+		for (; it != mEntries.end() && it->hash == hash; ++it) {
+			if (name(*it) == aName) return &*it;
+		}
+
+		return nullptr;
+	}
+
+	std::string_view Pak::name(PakEntry const& aEntry) const noexcept {
+		return mNames.substr(aEntry.nameOffset, aEntry.nameLength);
+	}
+
+	std::optional<std::vector<std::byte>> Pak::read(PakEntry const& aEntry) const {
+		std::vector<std::byte> bytes(aEntry.size);
+		if (!read_range(aEntry, 0, bytes)) return std::nullopt;
+		return bytes;
+	}
+
+	bool Pak::read_range(PakEntry const& aEntry, std::size_t aOffset, std::span<std::byte> aDestination) const {
+		if (aOffset > aEntry.size || aDestination.size() > aEntry.size - aOffset) return false;
+
+		std::span<std::byte const> const file = mFile.bytes();
+		std::vector<std::byte> scratch;
+
+		std::size_t written = 0;
+		while (written < aDestination.size()) {
+			std::size_t const position = aOffset + written;
+			std::size_t const index = position / kPakBlockSize;
+			if (index >= aEntry.blockCount) return false;
+
+			PakBlock const& block = mBlocks[aEntry.firstBlock + index];
+			std::span<std::byte const> const stored = file.subspan(block.offset, block.size);
+
+			std::size_t const inBlock = position % kPakBlockSize;
+			if (inBlock >= block.rawSize) return false;
+			std::size_t const count = std::min<std::size_t>(block.rawSize - inBlock, aDestination.size() - written);
+			std::span<std::byte> const destination = aDestination.subspan(written, count);
+
+			if (block.size == block.rawSize) {
+				std::memcpy(destination.data(), stored.data() + inBlock, count);
+			}
+			else if (count == block.rawSize) {
+				// Whole block, decode straight into the destination
+				if (!lz4_decompress(stored, destination)) return false;
+			}
+			else {
+				scratch.resize(block.rawSize);
+				if (!lz4_decompress(stored, scratch)) return false;
+				std::memcpy(destination.data(), scratch.data() + inBlock, count);
+			}
+
+			written += count;
+		}
+
+		return true;
+	}
+
+	bool write_pak(std::filesystem::path const& aDestination, std::filesystem::path const& aRoot, std::span<std::filesystem::path const> aFiles) {
+		PakHeader header;
+		std::vector<PakEntry> entries;
+		std::vector<PakBlock> blocks;
+		std::string names;
+
+		std::error_code error;
+		std::filesystem::create_directories(aDestination.parent_path(), error);
+
+		std::ofstream stream(aDestination, std::ios::binary);
+		if (!stream) {
+			spdlog::error("Failed to open `{}` for writing", aDestination.string());
+			return false;
+		}
+
+		stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+		std::uint64_t offset = sizeof(header);
+
+		std::size_t rawBytes = 0;
+
+		for (std::filesystem::path const& file : aFiles) {
+			MappedFile const mapping(aRoot / file);
+			if (!mapping) {
+				spdlog::error("Failed to read `{}` while packing", (aRoot / file).string());
+				return false;
+			}
+
+			std::string const name = pak_name(file);
+
+			PakEntry& entry = entries.emplace_back();
+			entry.hash = fnv1a(name);
+			entry.size = mapping.bytes().size();
+			entry.lastWriteTime = std::filesystem::last_write_time(aRoot / file, error).time_since_epoch().count();
+			entry.nameOffset = static_cast<std::uint32_t>(names.size());
+			entry.nameLength = static_cast<std::uint32_t>(name.size());
+			entry.firstBlock = static_cast<std::uint32_t>(blocks.size());
+			entry.blockCount = 0;
+			names += name;
+
+			for (std::size_t begin = 0; begin < mapping.bytes().size(); begin += kPakBlockSize) {
+				std::span<std::byte const> const raw = mapping.bytes().subspan(begin, std::min<std::size_t>(kPakBlockSize, mapping.bytes().size() - begin));
+				std::vector<std::byte> const compressed = lz4_compress(raw);
+
+				// Blocks that do not shrink are stored, reading them is a plain copy
+				std::span<std::byte const> const stored = compressed.size() < raw.size() ? std::span<std::byte const>(compressed) : raw;
+
+				blocks.push_back({ offset, static_cast<std::uint32_t>(stored.size()), static_cast<std::uint32_t>(raw.size()) });
+				stream.write(reinterpret_cast<char const*>(stored.data()), stored.size());
+				offset += stored.size();
+				++entry.blockCount;
+			}
+
+			rawBytes += mapping.bytes().size();
+		}
+
+		std::ranges::sort(entries, {}, &PakEntry::hash);
+
+		// Tables are read in place, keep them aligned
+		std::uint64_t const padding = (8 - offset % 8) % 8;
+		std::array<char, 8> const zeros{};
+		stream.write(zeros.data(), padding);
+		offset += padding;
+
+		header.entryCount = static_cast<std::uint32_t>(entries.size());
+		header.entriesOffset = offset;
+		header.blocksOffset = header.entriesOffset + entries.size() * sizeof(PakEntry);
+		header.namesOffset = header.blocksOffset + blocks.size() * sizeof(PakBlock);
+
+		stream.write(reinterpret_cast<char const*>(entries.data()), entries.size() * sizeof(PakEntry));
+		stream.write(reinterpret_cast<char const*>(blocks.data()), blocks.size() * sizeof(PakBlock));
+		stream.write(names.data(), names.size());
+
+		stream.seekp(0);
+		stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+		if (!stream) {
+			spdlog::error("Failed to write `{}`", aDestination.string());
+			return false;
+		}
+
+		spdlog::info("Packed {} files into `{}` ({} -> {} bytes)", entries.size(), aDestination.string(), rawBytes, header.namesOffset + names.size());
+		return true;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "rvo_utility.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace rvo {
+	// Layout of an `.rvopak`, all little endian
+	// header | block data | entries sorted by hash | block table | names
+	// Every entry is split into kPakBlockSize blocks compressed on their own, so a range read only decodes the blocks it touches
+	inline constexpr std::uint32_t kPakBlockSize = 64 * 1024;
+
+	struct PakHeader final {
+		char magic[4] = { 'R', 'P', 'A', 'K' };
+		std::uint32_t version = 1;
+		std::uint32_t entryCount = 0;
+		std::uint32_t blockSize = kPakBlockSize;
+		std::uint64_t entriesOffset = 0;
+		std::uint64_t blocksOffset = 0;
+		std::uint64_t namesOffset = 0;
+	};
+
+	struct PakEntry final {
+		std::uint64_t hash; // fnv1a of the name
+		std::uint64_t size;
+		std::int64_t lastWriteTime; // file_time_type ticks of the packed file
+		std::uint32_t nameOffset;
+		std::uint32_t nameLength;
+		std::uint32_t firstBlock;
+		std::uint32_t blockCount;
+	};
+
+	struct PakBlock final {
+		std::uint64_t offset;
+		std::uint32_t size; // Stored size, equal to rawSize when the block did not compress
+		std::uint32_t rawSize;
+	};
+
+	static_assert(sizeof(PakHeader) == 40 && sizeof(PakEntry) == 40 && sizeof(PakBlock) == 16);
+
+	// Paths inside a pak are relative to `working/`, lexically normal with forward slashes
+	std::string pak_name(std::filesystem::path const& aPath);
+
+	// Read only archive, the table of contents is used in place from the mapped file
+	class Pak final {
+	public:
+		// nullopt when the file is missing or not a pak
+		static std::optional<Pak> open(std::filesystem::path const& aPath);
+
+		PakEntry const* find(std::string_view aName) const noexcept;
+		std::string_view name(PakEntry const& aEntry) const noexcept;
+
+		std::optional<std::vector<std::byte>> read(PakEntry const& aEntry) const;
+		// Fills aDestination from aOffset, false when the entry is too short or corrupt
+		bool read_range(PakEntry const& aEntry, std::size_t aOffset, std::span<std::byte> aDestination) const;
+
+		std::span<PakEntry const> entries() const noexcept { return mEntries; }
+		std::filesystem::path const& path() const noexcept { return mPath; }
+	private:
+		Pak() = default;
+
+		std::filesystem::path mPath;
+		MappedFile mFile;
+		std::span<PakEntry const> mEntries;
+		std::span<PakBlock const> mBlocks;
+		std::string_view mNames;
+	};
+
+	// Packs aFiles, given relative to aRoot, into aDestination
+	bool write_pak(std::filesystem::path const& aDestination, std::filesystem::path const& aRoot, std::span<std::filesystem::path const> aFiles);
+}
\ No newline at end of file
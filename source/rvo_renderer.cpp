@@ -1,6 +1,33 @@
 #include "rvo_renderer.hpp"
 
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <optional>
+
 namespace rvo {
+	namespace {
+		// Gribb/Hartmann, planes point inwards and are normalized so distances are in world units
+		std::array<glm::vec4, 6> extract_frustum_planes(glm::mat4 const& aViewProjection) {
+			auto row = [&](int aRow) { return glm::vec4(aViewProjection[0][aRow], aViewProjection[1][aRow], aViewProjection[2][aRow], aViewProjection[3][aRow]); };
+
+			std::array<glm::vec4, 6> planes = {
+				row(3) + row(0),
+				row(3) - row(0),
+				row(3) + row(1),
+				row(3) - row(1),
+				row(3) + row(2),
+				row(3) - row(2),
+			};
+
+			for (auto& plane : planes) {
+				plane /= glm::length(glm::vec3(plane));
+			}
+
+			return planes;
+		}
+	}
+
 	void GBuffers::resize(glm::ivec2 const& aTargetSize) {
 		if (aTargetSize == mSize) return;
 
@@ -97,6 +124,11 @@ namespace rvo {
 	void Renderer::init(rvo::AssetManager& aAssetManager) {
 		mShaderProgramComposite = aAssetManager.get_shader_program("shaders/composite.glsl");
 		mShaderProgramFinal = aAssetManager.get_shader_program("shaders/final.glsl");
+		mShaderProgramDepth = aAssetManager.get_shader_program("shaders/depth.glsl");
+		mShaderProgramMeshletCull = aAssetManager.get_shader_program("shaders/meshlet_cull.glsl");
+		mShaderProgramFallback = aAssetManager.get_shader_program("shaders/fallback.glsl");
+		mTextureStreamer = &aAssetManager.mTextureStreamer;
+		mVirtualTextureSystem = &aAssetManager.mVirtualTextureSystem;
 
 		bloomRenderer.init(aAssetManager);
 
@@ -110,6 +142,32 @@ namespace rvo {
 		mInstanceRendererData.init(1024);
 	}
 
+	void Renderer::warm_up(rvo::AssetManager& aAssetManager) {
+		aAssetManager.finish_shader_builds(true);
+
+		// Into a 1x1 gbuffer, the attachment formats are part of what drivers compile against
+		mGBuffers.resize({ 1, 1 });
+		mGBuffers.mFbo.bind();
+		glViewport(0, 0, 1, 1);
+
+		GLuint vertexArray;
+		glCreateVertexArrays(1, &vertexArray);
+		glBindVertexArray(vertexArray);
+
+		for (auto const& [path, reference] : aAssetManager.mShaderPrograms) {
+			auto program = reference.asset.lock();
+			if (!program || !program->handle() || program->mCompute) continue;
+
+			program->bind();
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+		}
+
+		glBindVertexArray(0);
+		glDeleteVertexArrays(1, &vertexArray);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glFinish();
+	}
+
 	void Renderer::render_scene(glm::ivec2 aTargetSize, entt::registry& aRegistry, Transform const& aTransform, Camera aCamera, float aCurrentTime) {
 		mTargetSize = aTargetSize;
 
@@ -136,6 +194,8 @@ namespace rvo {
 		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+		mVirtualTextureSystem->begin_frame(mGBuffers.mSize);
+
 		if (mWireframe) {
 			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 		}
@@ -151,6 +211,12 @@ namespace rvo {
 		static std::unordered_map<std::pair<std::shared_ptr<rvo::Mesh>, std::shared_ptr<rvo::Material>>, std::vector<rvo::Transform>, MeshMaterialPairHash> entitiesSorted;
 		entitiesSorted.clear();
 
+		// Cull output slot of every meshlet culled batch, a mesh drawn with several materials culls into one slot per batch
+		static std::unordered_map<std::pair<std::shared_ptr<rvo::Mesh>, std::shared_ptr<rvo::Material>>, std::uint32_t, MeshMaterialPairHash> cullSlots;
+		static std::unordered_map<rvo::Mesh const*, std::uint32_t> cullSlotCounts;
+		cullSlots.clear();
+		cullSlotCounts.clear();
+
 		// Find sun, and set sun direction to match its direction
 		{
 			// Default case is to point down if no sun object is found
@@ -177,25 +243,98 @@ namespace rvo {
 			++mNumEntities;
 		}
 
-		for (auto const& [key, items] : entitiesSorted) {
-			auto const& [mesh, material] = key;
+		// Crowds are prefab instances, the owning group keeps both pools packed in the same order so this is a linear walk
+		for (auto [entity, gameObject, instance] : aRegistry.group<rvo::GameObject, rvo::PrefabInstance>().each()) {
+			if (!gameObject.mEnabled) continue;
 
-			if (!material->mShaderProgram->mBackfaceCull) {
-				glDisable(GL_CULL_FACE);
-			}
+			rvo::Prefab const& prefab = *instance.mPrefab;
+			if (!prefab.mMaterial) continue;
+			if (!prefab.mMaterial->mShaderProgram) continue;
+			if (!prefab.mMesh) continue;
 
-			mesh->bind();
-			material->mShaderProgram->bind();
-			if (material->mTexture) material->mTexture->bind(0);
+			entitiesSorted[std::make_pair(prefab.mMesh, prefab.mMaterial)].push_back(gameObject.mTransform);
+			++mNumEntities;
+		}
 
-			for (const auto& [key, field] : material->mFields) {
-				if (auto const* value = std::any_cast<glm::vec3>(&field)) {
-					material->mShaderProgram->push_3f(key, *value);
+		// Large single instance meshes are culled per meshlet, the culled indices of a batch are shared by both passes
+		auto uses_meshlets = [&](rvo::Mesh const& aMesh, std::vector<rvo::Transform> const& aItems) {
+			return mMeshletCulling && aItems.size() == 1 && aMesh.has_meshlets();
+		};
+
+		// Programs are empty until their first build finishes, the fallback draws until then and its state applies
+		auto shading_program = [&](rvo::Material const& aMaterial) -> rvo::ShaderProgram& {
+			return aMaterial.mShaderProgram->handle() ? *aMaterial.mShaderProgram : *mShaderProgramFallback;
+		};
+
+		auto const frustum = extract_frustum_planes(mEngineShaderData.projection * mEngineShaderData.view);
+
+		// Feed the texture streamer the projected size of every visible object, uploads from last frame's requests land first
+		{
+			mTextureStreamer->update();
+
+			float const pixelsPerUnit = static_cast<float>(mGBuffers.mSize.y) * 0.5f * mEngineShaderData.projection[1][1];
+
+			for (auto const& [key, items] : entitiesSorted) {
+				auto const& [mesh, material] = key;
+				if (!material->mTexture) continue;
+
+				glm::vec4 const sphere = mesh->bounding_sphere();
+				float screenSize = 0.0f;
+
+				for (auto const& item : items) {
+					glm::mat4 const model = item.get();
+					glm::vec3 const center = model * glm::vec4(glm::vec3(sphere), 1.0f);
+					float const scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+					float const radius = sphere.w * scale;
+
+					bool const visible = std::ranges::all_of(frustum, [&](glm::vec4 const& aPlane) { return glm::dot(glm::vec3(aPlane), center) + aPlane.w >= -radius; });
+					if (!visible) continue;
+
+					float const distance = glm::distance(center, aTransform.position);
+					if (distance <= radius) {
+						screenSize = std::numeric_limits<float>::max();
+						break;
+					}
+
+					screenSize = glm::max(screenSize, 2.0f * radius * pixelsPerUnit / distance);
 				}
+
+				// A tiled texture repeats across the object, each repeat needs as many texels as the whole object would
+				if (screenSize > 0.0f) mTextureStreamer->request(material->mTexture.get(), screenSize * material->mTextureTiling);
+			}
+		}
+
+		{
+			bool dispatched = false;
+
+			for (auto const& [key, items] : entitiesSorted) {
+				auto const& [mesh, material] = key;
+				if (!uses_meshlets(*mesh, items)) continue;
+
+				std::uint32_t const slot = cullSlotCounts[mesh.get()]++;
+				cullSlots.emplace(key, slot);
+
+				// Cone culling drops back faces, only valid when the program drawing the batch culls them as well
+				mesh->cull_meshlets(*mShaderProgramMeshletCull, items[0].get(), frustum, aTransform.position, shading_program(*material).mBackfaceCull, slot);
+				dispatched = true;
 			}
 
-			std::size_t remainingItems = items.size();
+			if (dispatched) {
+				glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT);
+			}
+		}
+
+		auto find_cull_slot = [&](auto const& aKey) -> std::optional<std::uint32_t> {
+			auto it = cullSlots.find(aKey);
+			if (it == cullSlots.end()) return std::nullopt;
+			return it->second;
+		};
+
+		// Uploads the transforms in chunks of the instance buffer, returns the number of draws issued
+		auto draw_instanced = [&](rvo::Mesh const& aMesh, std::vector<rvo::Transform> const& aItems, std::optional<std::uint32_t> aCullSlot) {
+			std::size_t remainingItems = aItems.size();
 			std::size_t idx = 0;
+			int numDraws = 0;
 
 			while (remainingItems > 0) {
 				std::size_t numElementsThisDraw = glm::min(remainingItems, mInstanceRendererData.mInstancesPerDraw);
@@ -203,7 +342,7 @@ namespace rvo {
 				auto data = mInstanceRendererData.begin(numElementsThisDraw);
 
 				for (std::size_t i = 0; i < numElementsThisDraw; ++i) {
-					data[i] = items[idx + i].get();
+					data[i] = aItems[idx + i].get() * aMesh.dequantize_transform();
 				}
 
 				mInstanceRendererData.finish();
@@ -211,16 +350,86 @@ namespace rvo {
 				idx += numElementsThisDraw;
 				remainingItems -= numElementsThisDraw;
 
-				mesh->draw(static_cast<GLsizei>(numElementsThisDraw));
-				++mNumBatches;
+				if (aCullSlot) {
+					aMesh.draw_culled(*aCullSlot);
+				}
+				else {
+					aMesh.draw(static_cast<GLsizei>(numElementsThisDraw));
+				}
+
+				++numDraws;
+			}
+
+			return numDraws;
+		};
+
+		// Depth prepass, fetches only positions so the main pass shades each pixel once
+		bool const depthPrepass = mDepthPrepass && !mWireframe;
+
+		if (depthPrepass) {
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			mShaderProgramDepth->bind();
+
+			for (auto const& [key, items] : entitiesSorted) {
+				auto const& [mesh, material] = key;
+
+				// Skipped here when the main pass skips it too
+				rvo::ShaderProgram const& program = shading_program(*material);
+				if (!program.handle() || !program.mDepthPrepass) continue;
+
+				if (!program.mBackfaceCull) {
+					glDisable(GL_CULL_FACE);
+				}
+
+				auto const cullSlot = find_cull_slot(key);
+				mesh->bind_depth(cullSlot.has_value());
+				draw_instanced(*mesh, items, cullSlot);
 
+				if (!program.mBackfaceCull) {
+					glEnable(GL_CULL_FACE);
+				}
 			}
 
-			if (!material->mShaderProgram->mBackfaceCull) {
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+			glDepthFunc(GL_LEQUAL);
+		}
+
+		for (auto const& [key, items] : entitiesSorted) {
+			auto const& [mesh, material] = key;
+
+			rvo::ShaderProgram& program = shading_program(*material);
+			if (!program.handle()) continue;
+
+			if (!program.mBackfaceCull) {
+				glDisable(GL_CULL_FACE);
+			}
+
+			auto const cullSlot = find_cull_slot(key);
+			mesh->bind(cullSlot.has_value());
+			program.bind();
+			if (material->mTexture) material->mTexture->bind(0);
+			program.push_1f("uTextureTiling"_u, material->mTextureTiling);
+			if (material->mVirtualTexture) mVirtualTextureSystem->bind(*material->mVirtualTexture, program);
+
+			for (auto const& field : material->mFields) {
+				if (auto const* value = std::any_cast<glm::vec3>(&field.value)) {
+					program.push_3f(field.id, *value);
+				}
+			}
+
+			mNumBatches += draw_instanced(*mesh, items, cullSlot);
+
+			if (!program.mBackfaceCull) {
 				glEnable(GL_CULL_FACE);
 			}
 		}
 
+		if (depthPrepass) {
+			glDepthFunc(GL_LESS);
+		}
+
+		mVirtualTextureSystem->end_frame();
+
 		if (mWireframe) {
 			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 		}
@@ -238,7 +447,7 @@ namespace rvo {
 		glViewport(0, 0, mGBuffers.mSize.x, mGBuffers.mSize.y);
 
 		mShaderProgramFinal->bind();
-		mShaderProgramFinal->push_1f("uBlend", mBloomBlend);
+		mShaderProgramFinal->push_1f("uBlend"_u, mBloomBlend);
 		mGBuffers.mFboMixedColor.bind(0);
 		bloomRenderer.mip_chain().bind(1);
 		glDrawArrays(GL_TRIANGLES, 0, 3);
@@ -43,6 +43,8 @@ namespace rvo {
 
 	struct Renderer final {
 		void init(rvo::AssetManager& aAssetManager);
+		// Waits for every shader build and draws once with each program so drivers finish compiling now instead of on first use
+		void warm_up(rvo::AssetManager& aAssetManager);
 		void render_scene(glm::ivec2 aTargetSize, entt::registry& aRegistry, Transform const& aTransform, Camera aCamera, float aCurrentTime);
 
 		rvo::Texture& get_output_texture();
@@ -59,8 +61,16 @@ namespace rvo {
 		int mNumBatches;
 		int mNumEntities;
 		bool mWireframe = false;
+		bool mDepthPrepass = true;
+		bool mMeshletCulling = true;
+
+		rvo::TextureStreamer* mTextureStreamer = nullptr;
+		rvo::VirtualTextureSystem* mVirtualTextureSystem = nullptr;
 
 		std::shared_ptr<rvo::ShaderProgram> mShaderProgramFinal;
 		std::shared_ptr<rvo::ShaderProgram> mShaderProgramComposite;
+		std::shared_ptr<rvo::ShaderProgram> mShaderProgramDepth;
+		std::shared_ptr<rvo::ShaderProgram> mShaderProgramMeshletCull;
+		std::shared_ptr<rvo::ShaderProgram> mShaderProgramFallback; // Stands in for materials whose shader is still building
 	};
 }
\ No newline at end of file
@@ -0,0 +1,1084 @@
+#include "rvo_scene.hpp"
+
+#include "rvo_components.hpp"
+#include "rvo_lua.hpp"
+#include "rvo_vfs.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <lua.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+namespace rvo {
+	namespace {
+		// Followed by, in order:
+		// u32 string offsets[stringCount + 1], char strings[stringBytes]
+		// u32 mesh paths[meshCount], u32 material paths[materialCount], both index the string table
+		// GameObject: u8 enabled[], vec3 position[], quat orientation[], vec3 scale[], each entityCount long
+		// EditorData: u32 name[], entityCount long, kNone for entities without one
+		// MeshRenderer: u32 mesh[], u32 material[], each meshRendererCount long, indexing the asset tables or kNone
+		// DirectionalLight: u32 entity[], vec3 color[], each lightCount long
+		// Script: u32 entity[], u32 source[], each scriptCount long, sources index the string table
+		// Prefab: u32 name[], u32 mesh[], u32 material[], u32 script[], each prefabCount long, scripts index the string table or kNone
+		// PrefabInstance: u32 entity[], u32 prefab[], u32 index[], each instanceCount long
+		struct SceneFileHeader final {
+			char magic[4] = { 'R', 'S', 'C', '4' };
+			std::uint32_t entityCount = 0;
+			std::uint32_t meshRendererCount = 0;
+			std::uint32_t lightCount = 0;
+			std::uint32_t stringCount = 0;
+			std::uint32_t stringBytes = 0;
+			std::uint32_t meshCount = 0;
+			std::uint32_t materialCount = 0;
+			std::uint32_t scriptCount = 0;
+			std::uint32_t prefabCount = 0;
+			std::uint32_t instanceCount = 0;
+		};
+
+		static_assert(sizeof(SceneFileHeader) == 44);
+
+		struct StringTable final {
+			std::uint32_t add(std::string_view aString) {
+				auto [it, inserted] = indices.try_emplace(std::string(aString), static_cast<std::uint32_t>(offsets.size() - 1));
+				if (inserted) {
+					characters.insert(characters.end(), aString.begin(), aString.end());
+					offsets.push_back(static_cast<std::uint32_t>(characters.size()));
+				}
+				return it->second;
+			}
+
+			std::unordered_map<std::string, std::uint32_t> indices;
+			std::vector<std::uint32_t> offsets = { 0 };
+			std::vector<char> characters;
+		};
+
+		// Maps each live asset back to the path it was loaded from, assets that are not shared by aReferences get no path
+		template<typename T, typename References>
+		class AssetTable final {
+		public:
+			AssetTable(References const& aReferences) {
+				for (auto const& [path, reference] : aReferences) {
+					if (auto asset = reference.asset.lock()) mPaths.try_emplace(asset.get(), path);
+				}
+			}
+
+			std::uint32_t add(T const* aAsset, StringTable& aStrings) {
+				if (!aAsset) return SceneData::kNone;
+
+				auto path = mPaths.find(aAsset);
+				if (path == mPaths.end()) return SceneData::kNone;
+
+				auto [it, inserted] = mIndices.try_emplace(aAsset, static_cast<std::uint32_t>(mTable.size()));
+				if (inserted) mTable.push_back(aStrings.add(path->second));
+				return it->second;
+			}
+
+			std::vector<std::uint32_t> const& table() const noexcept { return mTable; }
+		private:
+			std::unordered_map<T const*, std::string_view> mPaths;
+			std::unordered_map<T const*, std::uint32_t> mIndices;
+			std::vector<std::uint32_t> mTable;
+		};
+
+		template<typename T>
+		void append(std::vector<std::byte>& aBytes, std::vector<T> const& aColumn) {
+			auto const bytes = std::as_bytes(std::span(aColumn));
+			aBytes.insert(aBytes.end(), bytes.begin(), bytes.end());
+		}
+
+		struct ColumnReader final {
+			template<typename T>
+			std::vector<T> take(std::size_t aCount) {
+				std::vector<T> column;
+				if (failed || bytes.size() / sizeof(T) < aCount) {
+					failed = true;
+					return column;
+				}
+
+				column.resize(aCount);
+				std::memcpy(column.data(), bytes.data(), aCount * sizeof(T));
+				bytes = bytes.subspan(aCount * sizeof(T));
+				return column;
+			}
+
+			std::span<std::byte const> bytes;
+			bool failed = false;
+		};
+
+		bool all_below(std::vector<std::uint32_t> const& aIndices, std::uint32_t aLimit, bool aAllowNone = false) {
+			for (std::uint32_t index : aIndices) {
+				if (index >= aLimit && !(aAllowNone && index == SceneData::kNone)) return false;
+			}
+			return true;
+		}
+
+		// Entity columns are written in order, a repeated entity would be emplaced twice into one storage
+		bool strictly_increasing(std::vector<std::uint32_t> const& aIndices) {
+			return std::ranges::adjacent_find(aIndices, std::greater_equal{}) == aIndices.end();
+		}
+
+		struct SceneScript final {
+			entt::registry& registry;
+			AssetManager& assetManager;
+			std::vector<std::shared_ptr<Mesh>> meshes;
+			std::vector<std::shared_ptr<Material>> materials;
+		};
+
+		// Upvalues shared by the `rvo` functions
+		constexpr int kScriptUpvalue = 1;
+		constexpr int kMeshCacheUpvalue = 2; // Path string to index into SceneScript::meshes
+		constexpr int kMaterialCacheUpvalue = 3;
+
+		SceneScript& scene_script(lua_State* L) {
+			return *static_cast<SceneScript*>(lua_touserdata(L, lua_upvalueindex(kScriptUpvalue)));
+		}
+
+		// Lua strings are interned with their hash, so looking a path up in the cache table costs a pointer compare
+		// The AssetManager is only asked, and the path only hashed, the first time a path is seen
+		template<typename T, typename Load>
+		std::shared_ptr<T> cached_asset(lua_State* L, int aIndex, int aCacheUpvalue, std::vector<std::shared_ptr<T>>& aAssets, Load&& aLoad) {
+			if (lua_type(L, aIndex) != LUA_TSTRING) return nullptr;
+
+			aIndex = lua_absindex(L, aIndex);
+			lua_pushvalue(L, aIndex);
+			if (lua_rawget(L, lua_upvalueindex(aCacheUpvalue)) == LUA_TNUMBER) {
+				std::size_t const cached = static_cast<std::size_t>(lua_tointeger(L, -1));
+				lua_pop(L, 1);
+				return aAssets[cached];
+			}
+			lua_pop(L, 1);
+
+			std::size_t length;
+			char const* path = lua_tolstring(L, aIndex, &length);
+			aAssets.push_back(aLoad(std::string_view(path, length)));
+
+			lua_pushvalue(L, aIndex);
+			lua_pushinteger(L, static_cast<lua_Integer>(aAssets.size() - 1));
+			lua_rawset(L, lua_upvalueindex(aCacheUpvalue));
+			return aAssets.back();
+		}
+
+		MeshRenderer cached_mesh_renderer(lua_State* L, int aMesh, int aMaterial) {
+			SceneScript& script = scene_script(L);
+			MeshRenderer meshRenderer;
+			meshRenderer.mMesh = cached_asset(L, aMesh, kMeshCacheUpvalue, script.meshes, [&](std::string_view aPath) { return script.assetManager.get_mesh(aPath); });
+			meshRenderer.mMaterial = cached_asset(L, aMaterial, kMaterialCacheUpvalue, script.materials, [&](std::string_view aPath) { return script.assetManager.get_material(aPath); });
+			return meshRenderer;
+		}
+
+		// Leaves aValue untouched unless aIndex is a table of three numbers
+		void read_vec3(lua_State* L, int aIndex, glm::vec3& aValue) {
+			if (!lua_istable(L, aIndex) || lua_rawlen(L, aIndex) != 3) return;
+
+			for (int i = 0; i < 3; ++i) {
+				lua_rawgeti(L, aIndex, i + 1);
+				aValue[i] = static_cast<float>(lua_tonumber(L, -1));
+				lua_pop(L, 1);
+			}
+		}
+
+		// Position and scale of an rvo.spawn table, the name goes to aName
+		GameObject read_spawn(lua_State* L, int aIndex, std::string& aName) {
+			GameObject gameObject;
+
+			if (lua_getfield(L, aIndex, "name") == LUA_TSTRING) aName = lua_tostring(L, -1);
+			lua_pop(L, 1);
+
+			lua_getfield(L, aIndex, "position");
+			read_vec3(L, -1, gameObject.mTransform.position);
+			lua_pop(L, 1);
+
+			if (lua_getfield(L, aIndex, "scale") == LUA_TNUMBER) gameObject.mTransform.scale = glm::vec3(static_cast<float>(lua_tonumber(L, -1)));
+			else read_vec3(L, -1, gameObject.mTransform.scale);
+			lua_pop(L, 1);
+
+			return gameObject;
+		}
+
+		struct SpawnManyArguments final {
+			std::size_t count;
+			std::size_t scaleCount;
+			char const* name;
+			char const* script;
+		};
+
+		// Arguments are checked before anything that needs unwinding is created, lua errors longjmp
+		SpawnManyArguments check_spawn_many(lua_State* L) {
+			luaL_checktype(L, 3, LUA_TTABLE);
+			std::size_t const positionCount = lua_rawlen(L, 3);
+			std::size_t const scaleCount = lua_istable(L, 4) ? lua_rawlen(L, 4) : 0;
+			std::size_t const count = positionCount / 3;
+			luaL_argcheck(L, positionCount % 3 == 0, 3, "expected x, y, z per entity");
+			luaL_argcheck(L, scaleCount == 0 || scaleCount == count || scaleCount == positionCount, 4, "expected one or three scales per entity");
+			return { count, scaleCount, luaL_optstring(L, 5, nullptr), luaL_optstring(L, 6, nullptr) };
+		}
+
+		std::vector<GameObject> read_spawn_many(lua_State* L, SpawnManyArguments const& aArguments) {
+			std::vector<GameObject> gameObjects(aArguments.count);
+			for (std::size_t i = 0; i < gameObjects.size(); ++i) {
+				GameObject& gameObject = gameObjects[i];
+
+				for (int axis = 0; axis < 3; ++axis) {
+					lua_rawgeti(L, 3, static_cast<lua_Integer>(i * 3 + axis + 1));
+					gameObject.mTransform.position[axis] = static_cast<float>(lua_tonumber(L, -1));
+					lua_pop(L, 1);
+				}
+
+				if (aArguments.scaleCount == aArguments.count) {
+					lua_rawgeti(L, 4, static_cast<lua_Integer>(i + 1));
+					gameObject.mTransform.scale = glm::vec3(static_cast<float>(lua_tonumber(L, -1)));
+					lua_pop(L, 1);
+				}
+				else if (aArguments.scaleCount != 0) {
+					for (int axis = 0; axis < 3; ++axis) {
+						lua_rawgeti(L, 4, static_cast<lua_Integer>(i * 3 + axis + 1));
+						gameObject.mTransform.scale[axis] = static_cast<float>(lua_tonumber(L, -1));
+						lua_pop(L, 1);
+					}
+				}
+			}
+			return gameObjects;
+		}
+
+		// Only named entities get an EditorData
+		void insert_names(entt::registry& aRegistry, std::vector<entt::entity> const& aEntities, std::vector<std::string>&& aNames) {
+			std::vector<entt::entity> named;
+			std::vector<EditorData> editorData;
+			for (std::size_t i = 0; i < aNames.size(); ++i) {
+				if (aNames[i].empty()) continue;
+				named.push_back(aEntities[i]);
+				editorData.push_back({ std::move(aNames[i]) });
+			}
+			aRegistry.insert<EditorData>(named.begin(), named.end(), std::make_move_iterator(editorData.begin()));
+		}
+
+		// One create and one insert per component for the whole batch, aNames is empty or one per entity
+		void insert_batch(entt::registry& aRegistry, std::vector<GameObject>&& aGameObjects, std::vector<std::string>&& aNames, MeshRenderer const& aMeshRenderer, std::string_view aScript) {
+			std::vector<entt::entity> entities(aGameObjects.size());
+			aRegistry.create(entities.begin(), entities.end());
+			aRegistry.insert<GameObject>(entities.begin(), entities.end(), std::make_move_iterator(aGameObjects.begin()));
+			insert_names(aRegistry, entities, std::move(aNames));
+			if (aMeshRenderer.mMesh || aMeshRenderer.mMaterial) aRegistry.insert<MeshRenderer>(entities.begin(), entities.end(), aMeshRenderer);
+			if (!aScript.empty()) aRegistry.insert<Script>(entities.begin(), entities.end(), Script{ std::string(aScript) });
+		}
+
+		// Instances number themselves in the order of aGameObjects
+		void insert_instances(entt::registry& aRegistry, std::vector<GameObject>&& aGameObjects, std::shared_ptr<Prefab const> const& aPrefab) {
+			std::vector<entt::entity> entities(aGameObjects.size());
+			aRegistry.create(entities.begin(), entities.end());
+			aRegistry.insert<GameObject>(entities.begin(), entities.end(), std::make_move_iterator(aGameObjects.begin()));
+
+			std::vector<PrefabInstance> instances(entities.size());
+			for (std::size_t i = 0; i < instances.size(); ++i) instances[i] = { aPrefab, static_cast<std::uint32_t>(i) };
+			aRegistry.insert<PrefabInstance>(entities.begin(), entities.end(), std::make_move_iterator(instances.begin()));
+		}
+
+		std::shared_ptr<Prefab const> make_prefab(char const* aName, MeshRenderer const& aMeshRenderer, std::string_view aScript) {
+			return std::make_shared<Prefab const>(Prefab{ aName ? aName : "Unnamed", aMeshRenderer.mMesh, aMeshRenderer.mMaterial, std::string(aScript) });
+		}
+
+		// rvo.spawn{ name = "", position = { x, y, z }, scale = s or { x, y, z }, mesh = "", material = "", script = "" }
+		// Every field is optional, returns the entity
+		int script_spawn(lua_State* L) {
+			luaL_checktype(L, 1, LUA_TTABLE);
+
+			SceneScript& script = scene_script(L);
+			entt::entity const entity = script.registry.create();
+			std::string name;
+			script.registry.emplace<GameObject>(entity, read_spawn(L, 1, name));
+			if (!name.empty()) script.registry.emplace<EditorData>(entity, std::move(name));
+
+			lua_getfield(L, 1, "mesh");
+			lua_getfield(L, 1, "material");
+			if (lua_isstring(L, -2) || lua_isstring(L, -1)) script.registry.emplace<MeshRenderer>(entity, cached_mesh_renderer(L, -2, -1));
+			lua_pop(L, 2);
+
+			if (lua_getfield(L, 1, "script") == LUA_TSTRING) script.registry.emplace<Script>(entity, lua_tostring(L, -1));
+			lua_pop(L, 1);
+
+			lua_pushinteger(L, static_cast<lua_Integer>(entt::to_integral(entity)));
+			return 1;
+		}
+
+		// rvo.spawn_many(mesh, material, { x, y, z, x, y, z, ... }, scales, name, script)
+		// scales is optional and holds either one uniform scale or x, y, z per entity
+		// The entities are instances of one prefab holding name, assets and script, they are named `<name> <i>` when asked
+		// Returns how many were spawned
+		int script_spawn_many(lua_State* L) {
+			SpawnManyArguments const arguments = check_spawn_many(L);
+
+			SceneScript& script = scene_script(L);
+			insert_instances(script.registry, read_spawn_many(L, arguments), make_prefab(arguments.name, cached_mesh_renderer(L, 1, 2), arguments.script ? arguments.script : ""));
+
+			lua_pushinteger(L, static_cast<lua_Integer>(arguments.count));
+			return 1;
+		}
+
+		// Plain values of a chunk table, copied out of the scene script's state and into a worker's
+		using ChunkValue = std::variant<lua_Integer, lua_Number, std::string, bool>;
+		using ChunkData = std::vector<std::pair<std::string, ChunkValue>>;
+
+		// Entities in the order a generator spawned them, consecutive ones sharing assets and script share a batch
+		// Each rvo.spawn_many is a batch of its own that becomes one prefab
+		struct GeneratedBatch final {
+			std::string mesh;
+			std::string material;
+			std::string script;
+			std::vector<GameObject> gameObjects;
+			std::vector<std::string> names; // One per rvo.spawn, prefab instances have none
+			std::optional<std::string> prefab;
+		};
+
+		struct GeneratedChunk final {
+			std::vector<GeneratedBatch> batches;
+			std::string error;
+		};
+
+		struct Generation final {
+			std::filesystem::path source;
+			lua_Integer seed = 0;
+			std::vector<ChunkData> chunks;
+			std::vector<GeneratedChunk> results;
+			std::atomic<std::size_t> next = 0;
+		};
+
+		// Keys that aren't strings and values of other types are left out
+		ChunkData read_chunk(lua_State* L, int aIndex) {
+			ChunkData chunk;
+
+			lua_pushnil(L);
+			while (lua_next(L, aIndex)) {
+				if (lua_type(L, -2) == LUA_TSTRING) {
+					std::string key = lua_tostring(L, -2);
+
+					switch (lua_type(L, -1)) {
+						case LUA_TNUMBER:
+							if (lua_isinteger(L, -1)) chunk.emplace_back(std::move(key), lua_tointeger(L, -1));
+							else chunk.emplace_back(std::move(key), lua_tonumber(L, -1));
+							break;
+						case LUA_TSTRING:
+							chunk.emplace_back(std::move(key), std::string(lua_tostring(L, -1)));
+							break;
+						case LUA_TBOOLEAN:
+							chunk.emplace_back(std::move(key), lua_toboolean(L, -1) != 0);
+							break;
+					}
+				}
+				lua_pop(L, 1);
+			}
+
+			return chunk;
+		}
+
+		void push_chunk(lua_State* L, ChunkData const& aChunk) {
+			lua_createtable(L, 0, static_cast<int>(aChunk.size()));
+
+			for (auto const& [key, value] : aChunk) {
+				if (auto* integer = std::get_if<lua_Integer>(&value)) lua_pushinteger(L, *integer);
+				else if (auto* number = std::get_if<lua_Number>(&value)) lua_pushnumber(L, *number);
+				else if (auto* string = std::get_if<std::string>(&value)) lua_pushlstring(L, string->data(), string->size());
+				else lua_pushboolean(L, std::get<bool>(value));
+
+				lua_setfield(L, -2, key.c_str());
+			}
+		}
+
+		// Upvalue 1 of the generator functions points at the chunk being generated
+		GeneratedChunk& generated_chunk(lua_State* L) {
+			return **static_cast<GeneratedChunk**>(lua_touserdata(L, lua_upvalueindex(1)));
+		}
+
+		std::string optional_string(lua_State* L, int aIndex) {
+			if (lua_type(L, aIndex) != LUA_TSTRING) return {};
+
+			std::size_t length;
+			char const* string = lua_tolstring(L, aIndex, &length);
+			return std::string(string, length);
+		}
+
+		// rvo.spawn inside a generator, returns nothing since the entity only exists once the chunks are merged
+		int generate_spawn(lua_State* L) {
+			luaL_checktype(L, 1, LUA_TTABLE);
+
+			GeneratedChunk& chunk = generated_chunk(L);
+			lua_getfield(L, 1, "mesh");
+			lua_getfield(L, 1, "material");
+			lua_getfield(L, 1, "script");
+			std::string mesh = optional_string(L, -3);
+			std::string material = optional_string(L, -2);
+			std::string script = optional_string(L, -1);
+			lua_pop(L, 3);
+
+			if (chunk.batches.empty() || chunk.batches.back().prefab || chunk.batches.back().mesh != mesh || chunk.batches.back().material != material || chunk.batches.back().script != script) {
+				chunk.batches.push_back({ std::move(mesh), std::move(material), std::move(script) });
+			}
+
+			GeneratedBatch& batch = chunk.batches.back();
+			batch.names.emplace_back();
+			batch.gameObjects.push_back(read_spawn(L, 1, batch.names.back()));
+			return 0;
+		}
+
+		int generate_spawn_many(lua_State* L) {
+			SpawnManyArguments const arguments = check_spawn_many(L);
+
+			GeneratedChunk& chunk = generated_chunk(L);
+			chunk.batches.push_back({ optional_string(L, 1), optional_string(L, 2), arguments.script ? arguments.script : "", read_spawn_many(L, arguments), {}, arguments.name ? arguments.name : "Unnamed" });
+
+			lua_pushinteger(L, static_cast<lua_Integer>(arguments.count));
+			return 1;
+		}
+
+		// Takes chunks until none are left, in a state of its own
+		void generate_chunks(Generation& aGeneration) {
+			LuaState state(LuaAllocation::kArena);
+			lua_State* L = state.get();
+			GeneratedChunk* current = nullptr;
+
+			std::string error;
+			if (!load_lua_chunk(L, aGeneration.source)) {
+				error = lua_tostring(L, -1);
+			}
+			else {
+				lua_getupvalue(L, -1, 1);
+				lua_newtable(L);
+				lua_pushlightuserdata(L, &current);
+				lua_pushcclosure(L, generate_spawn, 1);
+				lua_setfield(L, -2, "spawn");
+				lua_pushlightuserdata(L, &current);
+				lua_pushcclosure(L, generate_spawn_many, 1);
+				lua_setfield(L, -2, "spawn_many");
+				lua_setfield(L, -2, "rvo");
+				lua_pop(L, 1);
+
+				if (lua_pcall(L, 0, 1, 0) != LUA_OK) error = lua_tostring(L, -1);
+				else if (!lua_isfunction(L, -1)) error = "the generator does not return a function";
+			}
+
+			int const generator = lua_gettop(L);
+
+			for (std::size_t i; (i = aGeneration.next.fetch_add(1)) < aGeneration.chunks.size();) {
+				GeneratedChunk& result = aGeneration.results[i];
+				if (!error.empty()) {
+					result.error = error;
+					continue;
+				}
+
+				current = &result;
+
+				// Reseeded for every chunk so what it generates doesn't depend on the worker it landed on
+				lua_getglobal(L, "math");
+				lua_getfield(L, -1, "randomseed");
+				lua_pushinteger(L, aGeneration.seed);
+				lua_pushinteger(L, static_cast<lua_Integer>(i));
+				lua_pcall(L, 2, 0, 0);
+				lua_settop(L, generator);
+
+				lua_pushvalue(L, generator);
+				push_chunk(L, aGeneration.chunks[i]);
+				lua_pushinteger(L, static_cast<lua_Integer>(i + 1));
+
+				if (lua_pcall(L, 2, 0, 0) != LUA_OK) {
+					result.error = lua_tostring(L, -1);
+					lua_settop(L, generator);
+				}
+			}
+		}
+
+		// rvo.generate(generator, chunks, seed)
+		// generator is a file returning function(chunk, index), called for each table of the chunks array on worker threads
+		// Chunks hold plain numbers, strings and booleans. rvo.spawn and rvo.spawn_many inside a generator are recorded
+		// and added here chunk by chunk, so the scene is the same for a given seed whatever the thread count
+		int script_generate(lua_State* L) {
+			char const* source = luaL_checkstring(L, 1);
+			luaL_checktype(L, 2, LUA_TTABLE);
+			lua_Integer const seed = luaL_optinteger(L, 3, 0);
+
+			Generation generation;
+			generation.source = source;
+			generation.seed = seed;
+
+			for (lua_Integer i = 1; lua_rawgeti(L, 2, i) == LUA_TTABLE; ++i) {
+				generation.chunks.push_back(read_chunk(L, lua_gettop(L)));
+				lua_pop(L, 1);
+			}
+			lua_pop(L, 1);
+
+			generation.results.resize(generation.chunks.size());
+
+			std::size_t const workers = std::min<std::size_t>(std::max(std::thread::hardware_concurrency(), 1u), generation.chunks.size());
+			{
+				std::vector<std::jthread> threads;
+				for (std::size_t i = 1; i < workers; ++i) threads.emplace_back(generate_chunks, std::ref(generation));
+				if (workers > 0) generate_chunks(generation);
+			}
+
+			SceneScript& script = scene_script(L);
+			std::size_t spawned = 0;
+			std::size_t failed = 0;
+
+			for (GeneratedChunk& chunk : generation.results) {
+				if (!chunk.error.empty()) {
+					if (failed++ == 0) spdlog::error("Generator `{}` failed: {}", source, chunk.error);
+					continue;
+				}
+
+				for (GeneratedBatch& batch : chunk.batches) {
+					if (batch.mesh.empty()) lua_pushnil(L);
+					else lua_pushlstring(L, batch.mesh.data(), batch.mesh.size());
+					if (batch.material.empty()) lua_pushnil(L);
+					else lua_pushlstring(L, batch.material.data(), batch.material.size());
+
+					MeshRenderer const meshRenderer = cached_mesh_renderer(L, -2, -1);
+					lua_pop(L, 2);
+
+					spawned += batch.gameObjects.size();
+					if (batch.prefab) insert_instances(script.registry, std::move(batch.gameObjects), make_prefab(batch.prefab->c_str(), meshRenderer, batch.script));
+					else insert_batch(script.registry, std::move(batch.gameObjects), std::move(batch.names), meshRenderer, batch.script);
+				}
+			}
+
+			if (failed > 1) spdlog::error("Generator `{}` failed on {} of {} chunks", source, failed, generation.chunks.size());
+			spdlog::info("Generated {} entities from {} chunks of `{}` on {} threads", spawned, generation.chunks.size(), source, workers);
+
+			lua_pushinteger(L, static_cast<lua_Integer>(spawned));
+			return 1;
+		}
+
+		// The table form scripts used before `rvo.spawn`, one entry per entity with GameObject and MeshRenderer subtables
+		int script_instantiate(lua_State* L) {
+			entt::registry& registry = scene_script(L).registry;
+
+			lua_pushnil(L);
+			while (lua_next(L, -2)) {
+				entt::handle entity = { registry, registry.create() };
+
+				/* uses 'key' (at index -2) and 'value' (at index -1) */
+
+				if (lua_getfield(L, -1, "GameObject") == LUA_TTABLE) {
+					auto& component = entity.emplace<GameObject>();
+
+					if (lua_getfield(L, -1, "name") == LUA_TSTRING) {
+						entity.emplace<EditorData>(lua_tostring(L, -1));
+					}
+					lua_pop(L, 1);
+
+					if (lua_getfield(L, -1, "transform") == LUA_TTABLE) {
+						if (lua_getfield(L, -1, "position") == LUA_TTABLE && lua_rawlen(L, -1) == 3) {
+							for (int i = 0; i < 3; ++i) {
+								lua_rawgeti(L, -1, i + 1);
+								component.mTransform.position[i] = static_cast<float>(lua_tonumber(L, -1));
+								lua_pop(L, 1);
+							}
+						}
+						lua_pop(L, 1);
+
+						if (lua_getfield(L, -1, "scale") == LUA_TTABLE && lua_rawlen(L, -1) == 3) {
+							for (int i = 0; i < 3; ++i) {
+								lua_rawgeti(L, -1, i + 1);
+								component.mTransform.scale[i] = static_cast<float>(lua_tonumber(L, -1));
+								lua_pop(L, 1);
+							}
+						}
+						lua_pop(L, 1);
+					}
+					lua_pop(L, 1);
+				}
+				lua_pop(L, 1);
+
+				if (lua_getfield(L, -1, "MeshRenderer") == LUA_TTABLE) {
+					lua_getfield(L, -1, "mesh");
+					lua_getfield(L, -2, "material");
+					entity.emplace<MeshRenderer>(cached_mesh_renderer(L, -2, -1));
+					lua_pop(L, 2);
+				}
+				lua_pop(L, 1);
+
+				lua_pop(L, 1);
+			}
+
+			return 0;
+		}
+	}
+
+	bool write_scene(std::filesystem::path const& aPath, entt::registry const& aRegistry, std::span<entt::entity const> aEntities, AssetManager const& aAssetManager) {
+		// Renderers first, entities without a GameObject are left out
+		std::vector<entt::entity> entities;
+		for (entt::entity entity : aEntities) if (aRegistry.all_of<GameObject, MeshRenderer>(entity)) entities.push_back(entity);
+		std::size_t const meshRendererCount = entities.size();
+		for (entt::entity entity : aEntities) if (aRegistry.all_of<GameObject>(entity) && !aRegistry.all_of<MeshRenderer>(entity)) entities.push_back(entity);
+
+		StringTable strings;
+		AssetTable<Mesh, decltype(aAssetManager.mMeshes)> meshes(aAssetManager.mMeshes);
+		AssetTable<Material, decltype(aAssetManager.mMaterials)> materials(aAssetManager.mMaterials);
+
+		std::vector<std::uint8_t> enabled;
+		std::vector<std::uint32_t> names;
+		std::vector<glm::vec3> positions;
+		std::vector<glm::quat> orientations;
+		std::vector<glm::vec3> scales;
+		std::vector<std::uint32_t> rendererMeshes;
+		std::vector<std::uint32_t> rendererMaterials;
+		std::vector<std::uint32_t> lightEntities;
+		std::vector<glm::vec3> lightColors;
+		std::vector<std::uint32_t> scriptEntities;
+		std::vector<std::uint32_t> scriptSources;
+		std::unordered_map<Prefab const*, std::uint32_t> prefabIndices;
+		std::vector<std::uint32_t> prefabNames;
+		std::vector<std::uint32_t> prefabMeshes;
+		std::vector<std::uint32_t> prefabMaterials;
+		std::vector<std::uint32_t> prefabScripts;
+		std::vector<std::uint32_t> instanceEntities;
+		std::vector<std::uint32_t> instancePrefabs;
+		std::vector<std::uint32_t> instanceIndices;
+
+		for (std::size_t i = 0; i < entities.size(); ++i) {
+			GameObject const& gameObject = aRegistry.get<GameObject>(entities[i]);
+			enabled.push_back(gameObject.mEnabled);
+			auto* editorData = aRegistry.try_get<EditorData>(entities[i]);
+			names.push_back(editorData && !editorData->mName.empty() ? strings.add(editorData->mName) : SceneData::kNone);
+			positions.push_back(gameObject.mTransform.position);
+			orientations.push_back(gameObject.mTransform.orientation);
+			scales.push_back(gameObject.mTransform.scale);
+
+			if (i < meshRendererCount) {
+				MeshRenderer const& meshRenderer = aRegistry.get<MeshRenderer>(entities[i]);
+				rendererMeshes.push_back(meshes.add(meshRenderer.mMesh.get(), strings));
+				rendererMaterials.push_back(materials.add(meshRenderer.mMaterial.get(), strings));
+			}
+
+			if (auto* light = aRegistry.try_get<DirectionalLight>(entities[i])) {
+				lightEntities.push_back(static_cast<std::uint32_t>(i));
+				lightColors.push_back(light->color);
+			}
+
+			if (auto* script = aRegistry.try_get<Script>(entities[i])) {
+				scriptEntities.push_back(static_cast<std::uint32_t>(i));
+				scriptSources.push_back(strings.add(script->mSource));
+			}
+
+			if (auto* instance = aRegistry.try_get<PrefabInstance>(entities[i])) {
+				Prefab const& prefab = *instance->mPrefab;
+				auto [it, inserted] = prefabIndices.try_emplace(&prefab, static_cast<std::uint32_t>(prefabNames.size()));
+				if (inserted) {
+					prefabNames.push_back(strings.add(prefab.mName));
+					prefabMeshes.push_back(meshes.add(prefab.mMesh.get(), strings));
+					prefabMaterials.push_back(materials.add(prefab.mMaterial.get(), strings));
+					prefabScripts.push_back(prefab.mScript.empty() ? SceneData::kNone : strings.add(prefab.mScript));
+				}
+
+				instanceEntities.push_back(static_cast<std::uint32_t>(i));
+				instancePrefabs.push_back(it->second);
+				instanceIndices.push_back(instance->mIndex);
+			}
+		}
+
+		SceneFileHeader header;
+		header.entityCount = static_cast<std::uint32_t>(entities.size());
+		header.meshRendererCount = static_cast<std::uint32_t>(meshRendererCount);
+		header.lightCount = static_cast<std::uint32_t>(lightEntities.size());
+		header.scriptCount = static_cast<std::uint32_t>(scriptEntities.size());
+		header.prefabCount = static_cast<std::uint32_t>(prefabNames.size());
+		header.instanceCount = static_cast<std::uint32_t>(instanceEntities.size());
+		header.stringCount = static_cast<std::uint32_t>(strings.offsets.size() - 1);
+		header.stringBytes = static_cast<std::uint32_t>(strings.characters.size());
+		header.meshCount = static_cast<std::uint32_t>(meshes.table().size());
+		header.materialCount = static_cast<std::uint32_t>(materials.table().size());
+
+		std::vector<std::byte> bytes(sizeof(header));
+		std::memcpy(bytes.data(), &header, sizeof(header));
+		append(bytes, strings.offsets);
+		append(bytes, strings.characters);
+		append(bytes, meshes.table());
+		append(bytes, materials.table());
+		append(bytes, enabled);
+		append(bytes, positions);
+		append(bytes, orientations);
+		append(bytes, scales);
+		append(bytes, names);
+		append(bytes, rendererMeshes);
+		append(bytes, rendererMaterials);
+		append(bytes, lightEntities);
+		append(bytes, lightColors);
+		append(bytes, scriptEntities);
+		append(bytes, scriptSources);
+		append(bytes, prefabNames);
+		append(bytes, prefabMeshes);
+		append(bytes, prefabMaterials);
+		append(bytes, prefabScripts);
+		append(bytes, instanceEntities);
+		append(bytes, instancePrefabs);
+		append(bytes, instanceIndices);
+
+		if (aPath.has_parent_path()) {
+			std::error_code error;
+			std::filesystem::create_directories(aPath.parent_path(), error);
+		}
+
+		std::ofstream stream(aPath, std::ios::binary);
+		if (!stream) {
+			spdlog::error("Failed to open `{}` for writing", aPath.string());
+			return false;
+		}
+
+		stream.write(reinterpret_cast<char const*>(bytes.data()), bytes.size());
+		return static_cast<bool>(stream);
+	}
+
+	bool save_scene(std::filesystem::path const& aPath, entt::registry const& aRegistry, AssetManager const& aAssetManager) {
+		auto view = aRegistry.view<GameObject const>();
+		std::vector<entt::entity> const entities(view.begin(), view.end());
+
+		if (!write_scene(aPath, aRegistry, entities, aAssetManager)) return false;
+
+		spdlog::info("Saved scene `{}` ({} entities)", aPath.string(), entities.size());
+		return true;
+	}
+
+	std::optional<SceneData> read_scene(std::filesystem::path const& aPath) {
+		auto optFile = vfs::view(aPath);
+		if (!optFile) return std::nullopt;
+
+		std::span<std::byte const> const bytes = optFile->bytes();
+
+		SceneFileHeader header;
+		if (bytes.size() < sizeof(header)) return std::nullopt;
+		std::memcpy(&header, bytes.data(), sizeof(header));
+
+		if (std::memcmp(header.magic, SceneFileHeader().magic, sizeof(header.magic)) != 0) {
+			spdlog::error("`{}` is not a scene", aPath.string());
+			return std::nullopt;
+		}
+
+		ColumnReader reader{ bytes.subspan(sizeof(header)) };
+		auto const stringOffsets = reader.take<std::uint32_t>(std::size_t(header.stringCount) + 1);
+		auto const characters = reader.take<char>(header.stringBytes);
+		auto const meshPaths = reader.take<std::uint32_t>(header.meshCount);
+		auto const materialPaths = reader.take<std::uint32_t>(header.materialCount);
+		auto const enabled = reader.take<std::uint8_t>(header.entityCount);
+		auto const positions = reader.take<glm::vec3>(header.entityCount);
+		auto const orientations = reader.take<glm::quat>(header.entityCount);
+		auto const scales = reader.take<glm::vec3>(header.entityCount);
+		auto const names = reader.take<std::uint32_t>(header.entityCount);
+		auto rendererMeshes = reader.take<std::uint32_t>(header.meshRendererCount);
+		auto rendererMaterials = reader.take<std::uint32_t>(header.meshRendererCount);
+		auto lightEntities = reader.take<std::uint32_t>(header.lightCount);
+		auto const lightColors = reader.take<glm::vec3>(header.lightCount);
+		auto scriptEntities = reader.take<std::uint32_t>(header.scriptCount);
+		auto const scriptSources = reader.take<std::uint32_t>(header.scriptCount);
+		auto const prefabNames = reader.take<std::uint32_t>(header.prefabCount);
+		auto const prefabMeshes = reader.take<std::uint32_t>(header.prefabCount);
+		auto const prefabMaterials = reader.take<std::uint32_t>(header.prefabCount);
+		auto const prefabScripts = reader.take<std::uint32_t>(header.prefabCount);
+		auto instanceEntities = reader.take<std::uint32_t>(header.instanceCount);
+		auto instancePrefabs = reader.take<std::uint32_t>(header.instanceCount);
+		auto instanceIndices = reader.take<std::uint32_t>(header.instanceCount);
+
+		bool valid = !reader.failed && reader.bytes.empty() && header.meshRendererCount <= header.entityCount;
+		for (std::size_t i = 0; valid && i < header.stringCount; ++i) valid = stringOffsets[i] <= stringOffsets[i + 1];
+		valid = valid && stringOffsets.front() == 0 && stringOffsets.back() == header.stringBytes;
+		valid = valid && all_below(meshPaths, header.stringCount) && all_below(materialPaths, header.stringCount) && all_below(names, header.stringCount, true);
+		valid = valid && all_below(rendererMeshes, header.meshCount, true) && all_below(rendererMaterials, header.materialCount, true);
+		valid = valid && all_below(lightEntities, header.entityCount) && strictly_increasing(lightEntities);
+		valid = valid && all_below(scriptEntities, header.entityCount) && strictly_increasing(scriptEntities) && all_below(scriptSources, header.stringCount);
+		valid = valid && all_below(prefabNames, header.stringCount) && all_below(prefabScripts, header.stringCount, true);
+		valid = valid && all_below(prefabMeshes, header.meshCount, true) && all_below(prefabMaterials, header.materialCount, true);
+		valid = valid && all_below(instanceEntities, header.entityCount) && strictly_increasing(instanceEntities) && all_below(instancePrefabs, header.prefabCount);
+
+		if (!valid) {
+			spdlog::error("`{}` is not a scene", aPath.string());
+			return std::nullopt;
+		}
+
+		auto string_at = [&](std::uint32_t aIndex) {
+			return std::string(characters.data() + stringOffsets[aIndex], stringOffsets[aIndex + 1] - stringOffsets[aIndex]);
+		};
+
+		SceneData data;
+
+		for (std::uint32_t path : meshPaths) data.meshes.push_back(string_at(path));
+		for (std::uint32_t path : materialPaths) data.materials.push_back(string_at(path));
+
+		data.gameObjects.resize(header.entityCount);
+		for (std::size_t i = 0; i < data.gameObjects.size(); ++i) {
+			data.gameObjects[i].mEnabled = enabled[i] != 0;
+			data.gameObjects[i].mTransform.position = positions[i];
+			data.gameObjects[i].mTransform.orientation = orientations[i];
+			data.gameObjects[i].mTransform.scale = scales[i];
+		}
+
+		data.names.resize(header.entityCount);
+		for (std::size_t i = 0; i < data.names.size(); ++i) {
+			if (names[i] != SceneData::kNone) data.names[i] = string_at(names[i]);
+		}
+
+		data.rendererMeshes = std::move(rendererMeshes);
+		data.rendererMaterials = std::move(rendererMaterials);
+
+		data.lightEntities = std::move(lightEntities);
+		data.lights.resize(header.lightCount);
+		for (std::size_t i = 0; i < data.lights.size(); ++i) data.lights[i].color = lightColors[i];
+
+		data.scriptEntities = std::move(scriptEntities);
+		data.scripts.resize(header.scriptCount);
+		for (std::size_t i = 0; i < data.scripts.size(); ++i) data.scripts[i].mSource = string_at(scriptSources[i]);
+
+		data.prefabs.resize(header.prefabCount);
+		for (std::size_t i = 0; i < data.prefabs.size(); ++i) {
+			data.prefabs[i] = { string_at(prefabNames[i]), prefabMeshes[i], prefabMaterials[i], prefabScripts[i] == SceneData::kNone ? std::string() : string_at(prefabScripts[i]) };
+		}
+
+		data.instanceEntities = std::move(instanceEntities);
+		data.instancePrefabs = std::move(instancePrefabs);
+		data.instanceIndices = std::move(instanceIndices);
+
+		return data;
+	}
+
+	SceneInstance instantiate_scene(SceneData aData, entt::registry& aRegistry, AssetManager& aAssetManager) {
+		SceneInstance instance;
+
+		instance.meshes.reserve(aData.meshes.size());
+		for (std::string const& path : aData.meshes) instance.meshes.push_back(aAssetManager.get_mesh(path));
+
+		instance.materials.reserve(aData.materials.size());
+		for (std::string const& path : aData.materials) instance.materials.push_back(aAssetManager.get_material(path));
+
+		std::vector<MeshRenderer> meshRenderers(aData.rendererMeshes.size());
+		for (std::size_t i = 0; i < meshRenderers.size(); ++i) {
+			if (aData.rendererMeshes[i] != SceneData::kNone) meshRenderers[i].mMesh = instance.meshes[aData.rendererMeshes[i]];
+			if (aData.rendererMaterials[i] != SceneData::kNone) meshRenderers[i].mMaterial = instance.materials[aData.rendererMaterials[i]];
+		}
+
+		std::vector<entt::entity>& entities = instance.entities;
+		entities.resize(aData.gameObjects.size());
+		aRegistry.create(entities.begin(), entities.end());
+		aRegistry.insert<GameObject>(entities.begin(), entities.end(), std::make_move_iterator(aData.gameObjects.begin()));
+		insert_names(aRegistry, entities, std::move(aData.names));
+		aRegistry.insert<MeshRenderer>(entities.begin(), entities.begin() + meshRenderers.size(), std::make_move_iterator(meshRenderers.begin()));
+
+		std::vector<entt::entity> lights(aData.lightEntities.size());
+		for (std::size_t i = 0; i < lights.size(); ++i) lights[i] = entities[aData.lightEntities[i]];
+		aRegistry.insert<DirectionalLight>(lights.begin(), lights.end(), aData.lights.begin());
+
+		std::vector<entt::entity> scripted(aData.scriptEntities.size());
+		for (std::size_t i = 0; i < scripted.size(); ++i) scripted[i] = entities[aData.scriptEntities[i]];
+		aRegistry.insert<Script>(scripted.begin(), scripted.end(), std::make_move_iterator(aData.scripts.begin()));
+
+		std::vector<std::shared_ptr<Prefab const>> prefabs;
+		prefabs.reserve(aData.prefabs.size());
+		for (ScenePrefab& prefab : aData.prefabs) {
+			prefabs.push_back(std::make_shared<Prefab const>(Prefab{
+				std::move(prefab.name),
+				prefab.mesh != SceneData::kNone ? instance.meshes[prefab.mesh] : nullptr,
+				prefab.material != SceneData::kNone ? instance.materials[prefab.material] : nullptr,
+				std::move(prefab.script),
+			}));
+		}
+
+		std::vector<entt::entity> instanced(aData.instanceEntities.size());
+		std::vector<PrefabInstance> instances(instanced.size());
+		for (std::size_t i = 0; i < instanced.size(); ++i) {
+			instanced[i] = entities[aData.instanceEntities[i]];
+			instances[i] = { prefabs[aData.instancePrefabs[i]], aData.instanceIndices[i] };
+		}
+		aRegistry.insert<PrefabInstance>(instanced.begin(), instanced.end(), std::make_move_iterator(instances.begin()));
+
+		return instance;
+	}
+
+	bool load_scene_binary(std::filesystem::path const& aPath, entt::registry& aRegistry, AssetManager& aAssetManager) {
+		auto optData = read_scene(aPath);
+		if (!optData) return false;
+
+		SceneInstance const instance = instantiate_scene(std::move(*optData), aRegistry, aAssetManager);
+
+		spdlog::info("Loaded scene `{}` ({} entities, {} meshes, {} materials)", aPath.string(), instance.entities.size(), instance.meshes.size(), instance.materials.size());
+		return true;
+	}
+
+	bool load_scene_script(std::filesystem::path const& aPath, entt::registry& aRegistry, AssetManager& aAssetManager) {
+		SceneScript script{ aRegistry, aAssetManager };
+
+		// Everything the script allocates goes when the state does, materials it loads still run in the AssetManager's state
+		LuaState state(LuaAllocation::kArena);
+		lua_State* L = state.get();
+		int const top = lua_gettop(L);
+
+		// Asset caches, shared by every function as upvalues
+		lua_newtable(L);
+		lua_newtable(L);
+
+		auto push_function = [&](lua_CFunction aFunction) {
+			lua_pushlightuserdata(L, &script);
+			lua_pushvalue(L, top + 1);
+			lua_pushvalue(L, top + 2);
+			lua_pushcclosure(L, aFunction, 3);
+		};
+
+		bool success = rvo::load_lua_chunk(L, aPath);
+
+		if (success) {
+			// `rvo` goes in the environment of this chunk only
+			lua_getupvalue(L, -1, 1);
+			lua_newtable(L);
+			push_function(script_spawn);
+			lua_setfield(L, -2, "spawn");
+			push_function(script_spawn_many);
+			lua_setfield(L, -2, "spawn_many");
+			push_function(script_generate);
+			lua_setfield(L, -2, "generate");
+			lua_setfield(L, -2, "rvo");
+			lua_pop(L, 1);
+
+			success = lua_pcall(L, 0, 1, 0) == LUA_OK;
+		}
+
+		if (success && lua_istable(L, -1)) {
+			push_function(script_instantiate);
+			lua_insert(L, -2);
+			success = lua_pcall(L, 1, 0, 0) == LUA_OK;
+		}
+
+		if (!success) spdlog::error("Error while loading scene `{}`: {}", aPath.string(), lua_tostring(L, -1));
+		else spdlog::info("Loaded scene `{}` ({} meshes, {} materials)", aPath.string(), script.meshes.size(), script.materials.size());
+
+		LuaMemoryStats const& memory = state.memory();
+		spdlog::info("Scene script used {} KiB of Lua memory at peak over {} allocations ({} large), arena {} KiB", memory.peakBytes / 1024, memory.allocations, memory.largeAllocations, memory.reservedBytes / 1024);
+
+		lua_settop(L, top);
+		return success;
+	}
+
+	std::string entity_name(entt::registry const& aRegistry, entt::entity aEntity) {
+		auto* editorData = aRegistry.try_get<EditorData>(aEntity);
+		if (editorData && !editorData->mName.empty()) return editorData->mName;
+
+		if (auto* instance = aRegistry.try_get<PrefabInstance>(aEntity)) return fmt::format("{} {}", instance->mPrefab->mName, instance->mIndex);
+		return "Unnamed";
+	}
+
+	void assign_scene_ids(entt::registry& aRegistry) {
+		std::unordered_map<std::uint64_t, std::uint64_t> occurrences;
+
+		for (entt::entity entity : aRegistry.view<GameObject const>()) {
+			if (aRegistry.all_of<SceneId>(entity)) continue;
+
+			// Named entities key by fnv1a(name), unnamed prefab instances by fnv1a(index bytes, fnv1a(prefab name))
+			// Repeats of a key are told apart by the order they are met in
+			auto* editorData = aRegistry.try_get<EditorData>(entity);
+			std::string_view const name = editorData ? std::string_view(editorData->mName) : std::string_view();
+			std::uint64_t key = fnv1a(name);
+			if (auto* instance = aRegistry.try_get<PrefabInstance>(entity); instance && name.empty()) {
+				key = fnv1a(std::as_bytes(std::span(&instance->mIndex, 1)), fnv1a(instance->mPrefab->mName));
+			}
+
+			std::uint64_t const occurrence = occurrences[key]++;
+			aRegistry.emplace<SceneId>(entity, fnv1a(std::as_bytes(std::span(&occurrence, 1)), key));
+		}
+	}
+
+	namespace {
+		constexpr auto kReplace = [](auto const&, auto const&) { return false; };
+
+		// True when the component was added, replaced or removed
+		// aRebind tells whether construction listeners like ScriptSystem need to see the new value, it is removed and added again then
+		template<typename T, typename Equal, typename Rebind>
+		bool patch_component(entt::registry& aRegistry, entt::entity aTarget, entt::registry& aScene, entt::entity aSource, Equal aEqual, Rebind aRebind) {
+			T* current = aRegistry.try_get<T>(aTarget);
+			T* incoming = aScene.try_get<T>(aSource);
+
+			if (!incoming) {
+				if (!current) return false;
+				aRegistry.remove<T>(aTarget);
+				return true;
+			}
+
+			if (current && aEqual(*current, *incoming)) return false;
+
+			if (current && aRebind(*current, *incoming)) aRegistry.remove<T>(aTarget);
+			aRegistry.emplace_or_replace<T>(aTarget, std::move(*incoming));
+			return true;
+		}
+	}
+
+	ScenePatchStats patch_scene(entt::registry& aRegistry, entt::registry& aScene) {
+		ScenePatchStats stats;
+
+		std::unordered_map<std::uint64_t, entt::entity> existing;
+		for (entt::entity entity : aRegistry.view<SceneId const>()) existing.emplace(aRegistry.get<SceneId>(entity).mValue, entity);
+
+		for (entt::entity source : aScene.view<SceneId const>()) {
+			std::uint64_t const id = aScene.get<SceneId>(source).mValue;
+
+			entt::entity target;
+			bool changed = false;
+			bool const created = !existing.contains(id);
+
+			if (created) {
+				target = aRegistry.create();
+				aRegistry.emplace<SceneId>(target, id);
+				++stats.created;
+			}
+			else {
+				target = existing.extract(id).mapped();
+			}
+
+			changed |= patch_component<GameObject>(aRegistry, target, aScene, source, [](GameObject const& a, GameObject const& b) {
+				return a.mEnabled == b.mEnabled && a.mTransform.position == b.mTransform.position && a.mTransform.orientation == b.mTransform.orientation && a.mTransform.scale == b.mTransform.scale;
+			}, kReplace);
+
+			changed |= patch_component<EditorData>(aRegistry, target, aScene, source, [](EditorData const& a, EditorData const& b) {
+				return a.mName == b.mName;
+			}, kReplace);
+
+			// Assets come from the same AssetManager, an unchanged renderer holds the very same pointers
+			changed |= patch_component<MeshRenderer>(aRegistry, target, aScene, source, [](MeshRenderer const& a, MeshRenderer const& b) {
+				return a.mMesh == b.mMesh && a.mMaterial == b.mMaterial;
+			}, kReplace);
+
+			changed |= patch_component<DirectionalLight>(aRegistry, target, aScene, source, [](DirectionalLight const& a, DirectionalLight const& b) {
+				return a.color == b.color;
+			}, kReplace);
+
+			auto const sameScript = [](Script const& a, Script const& b) { return a.mSource == b.mSource; };
+			changed |= patch_component<Script>(aRegistry, target, aScene, source, sameScript, std::not_fn(sameScript));
+
+			// Every load makes new prefabs, they are compared by what they hold
+			auto const samePrefab = [](Prefab const& a, Prefab const& b) {
+				return a.mName == b.mName && a.mMesh == b.mMesh && a.mMaterial == b.mMaterial && a.mScript == b.mScript;
+			};
+			changed |= patch_component<PrefabInstance>(aRegistry, target, aScene, source, [&](PrefabInstance const& a, PrefabInstance const& b) {
+				return a.mIndex == b.mIndex && samePrefab(*a.mPrefab, *b.mPrefab);
+			}, [](PrefabInstance const& a, PrefabInstance const& b) {
+				return a.mPrefab->mScript != b.mPrefab->mScript;
+			});
+
+			if (created) continue;
+			if (changed) ++stats.updated;
+			else ++stats.unchanged;
+		}
+
+		for (auto const& [id, entity] : existing) aRegistry.destroy(entity);
+		stats.destroyed = existing.size();
+
+		aScene.clear();
+		return stats;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "rvo_asset_manager.hpp"
+#include "rvo_components.hpp"
+
+#include <entt/entt.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace rvo {
+	// A Prefab before its assets are resolved
+	struct ScenePrefab final {
+		std::string name;
+		std::uint32_t mesh; // Indexing SceneData::meshes or SceneData::kNone
+		std::uint32_t material;
+		std::string script;
+	};
+
+	// An `.rvoscene` read into components, asset paths are not resolved yet so it can be made on any thread
+	struct SceneData final {
+		// Index of a missing mesh, material, name or script
+		static constexpr std::uint32_t kNone = std::numeric_limits<std::uint32_t>::max();
+
+		std::vector<std::string> meshes;
+		std::vector<std::string> materials;
+		std::vector<GameObject> gameObjects; // Entities with a MeshRenderer come first
+		std::vector<std::string> names; // One per gameObject, empty for entities without EditorData
+		std::vector<std::uint32_t> rendererMeshes; // One per MeshRenderer, indexing meshes or kNone
+		std::vector<std::uint32_t> rendererMaterials;
+		std::vector<std::uint32_t> lightEntities; // Indexing gameObjects
+		std::vector<DirectionalLight> lights;
+		std::vector<std::uint32_t> scriptEntities;
+		std::vector<Script> scripts;
+		std::vector<ScenePrefab> prefabs;
+		std::vector<std::uint32_t> instanceEntities;
+		std::vector<std::uint32_t> instancePrefabs; // Indexing prefabs
+		std::vector<std::uint32_t> instanceIndices;
+	};
+
+	// Entities made from one SceneData, the assets they use stay loaded for as long as this exists
+	struct SceneInstance final {
+		std::vector<entt::entity> entities;
+		std::vector<std::shared_ptr<Mesh>> meshes;
+		std::vector<std::shared_ptr<Material>> materials;
+	};
+
+	// `.rvoscene` stores each component as a column of plain values next to a string table and tables of asset paths
+	// Entities with a MeshRenderer come first so both columns cover one contiguous range of entities
+	bool write_scene(std::filesystem::path const& aPath, entt::registry const& aRegistry, std::span<entt::entity const> aEntities, AssetManager const& aAssetManager);
+	bool save_scene(std::filesystem::path const& aPath, entt::registry const& aRegistry, AssetManager const& aAssetManager);
+
+	// Everything is checked before anything is returned, nullopt when aPath is missing or malformed
+	std::optional<SceneData> read_scene(std::filesystem::path const& aPath);
+	// Creates every entity in one call and inserts each column as a whole, every asset is resolved once
+	SceneInstance instantiate_scene(SceneData aData, entt::registry& aRegistry, AssetManager& aAssetManager);
+	bool load_scene_binary(std::filesystem::path const& aPath, entt::registry& aRegistry, AssetManager& aAssetManager);
+
+	// The name in EditorData, or `<prefab> <index>` made on the spot for a prefab instance that has none of its own
+	std::string entity_name(entt::registry const& aRegistry, entt::entity aEntity);
+
+	// Gives every GameObject without a SceneId one made from its name, or prefab and index, and how many entities of that name came before it
+	// Loading the same scene twice gives the same ids, so a reload can be matched up with the registry it replaces
+	void assign_scene_ids(entt::registry& aRegistry);
+
+	struct ScenePatchStats final {
+		std::size_t created = 0;
+		std::size_t updated = 0;
+		std::size_t destroyed = 0;
+		std::size_t unchanged = 0;
+	};
+
+	// Makes the SceneId entities of aRegistry match those of aScene, a freshly loaded registry that is consumed
+	// Matched entities keep their handle and only the components that differ are replaced, so the assets they use stay loaded
+	// Entities without a SceneId are left alone
+	ScenePatchStats patch_scene(entt::registry& aRegistry, entt::registry& aScene);
+
+	// Runs a scene script with `rvo.spawn{...}` and `rvo.spawn_many(mesh, material, positions, scales, name, script)` available
+	// Both write straight into aRegistry, a table of entities returned by the script is still instantiated afterwards
+	// `rvo.generate(generator, chunks, seed)` runs a generator file over independent chunks on worker threads, see rvo_scene.cpp
+	bool load_scene_script(std::filesystem::path const& aPath, entt::registry& aRegistry, AssetManager& aAssetManager);
+}
\ No newline at end of file
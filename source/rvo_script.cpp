@@ -0,0 +1,250 @@
+#include "rvo_script.hpp"
+
+#include "rvo_components.hpp"
+#include "rvo_scene.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <lua.hpp>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <string_view>
+
+namespace rvo {
+	namespace {
+		constexpr char const* kEntityMetatable = "rvo.entity";
+
+		// Checking the clock costs more than resuming a short script, so it is only read every few resumes
+		constexpr std::size_t kBudgetCheckInterval = 16;
+
+		// Userdata behind self, the GameObject is looked up on every access and never copied into Lua
+		struct ScriptEntity final {
+			entt::registry* registry;
+			entt::entity entity;
+		};
+
+		GameObject& script_game_object(lua_State* L) {
+			auto const& self = *static_cast<ScriptEntity*>(luaL_checkudata(L, 1, kEntityMetatable));
+			auto* gameObject = self.registry->valid(self.entity) ? self.registry->try_get<GameObject>(self.entity) : nullptr;
+			if (!gameObject) luaL_error(L, "entity no longer exists");
+			return *gameObject;
+		}
+
+		// A Script component wins over the script of the entity's prefab, nullptr when it has neither
+		std::string const* script_source(entt::registry const& aRegistry, entt::entity aEntity) {
+			if (auto* script = aRegistry.try_get<Script>(aEntity)) return &script->mSource;
+			if (auto* instance = aRegistry.try_get<PrefabInstance>(aEntity); instance && !instance->mPrefab->mScript.empty()) return &instance->mPrefab->mScript;
+			return nullptr;
+		}
+
+		struct TransformField final {
+			std::string_view name;
+			glm::vec3 Transform::* vector;
+			int axis;
+		};
+
+		constexpr TransformField kTransformFields[] = {
+			{ "x", &Transform::position, 0 },
+			{ "y", &Transform::position, 1 },
+			{ "z", &Transform::position, 2 },
+			{ "sx", &Transform::scale, 0 },
+			{ "sy", &Transform::scale, 1 },
+			{ "sz", &Transform::scale, 2 },
+		};
+
+		TransformField const* find_transform_field(std::string_view aName) {
+			for (TransformField const& field : kTransformFields) if (field.name == aName) return &field;
+			return nullptr;
+		}
+
+		// Methods table at upvalue 1
+		int entity_index(lua_State* L) {
+			GameObject& gameObject = script_game_object(L);
+			std::size_t length;
+			char const* key = luaL_checklstring(L, 2, &length);
+			std::string_view const name(key, length);
+
+			if (auto* field = find_transform_field(name)) lua_pushnumber(L, (gameObject.mTransform.*field->vector)[field->axis]);
+			else if (name == "enabled") lua_pushboolean(L, gameObject.mEnabled);
+			else if (name == "name") {
+				auto const& self = *static_cast<ScriptEntity*>(lua_touserdata(L, 1));
+				std::string const entityName = entity_name(*self.registry, self.entity);
+				lua_pushlstring(L, entityName.data(), entityName.size());
+			}
+			else lua_getfield(L, lua_upvalueindex(1), key);
+
+			return 1;
+		}
+
+		int entity_newindex(lua_State* L) {
+			GameObject& gameObject = script_game_object(L);
+			std::size_t length;
+			char const* key = luaL_checklstring(L, 2, &length);
+			std::string_view const name(key, length);
+
+			if (auto* field = find_transform_field(name)) (gameObject.mTransform.*field->vector)[field->axis] = static_cast<float>(luaL_checknumber(L, 3));
+			else if (name == "enabled") gameObject.mEnabled = lua_toboolean(L, 3);
+			else return luaL_error(L, "`%s` cannot be assigned", key);
+
+			return 0;
+		}
+
+		int entity_translate(lua_State* L) {
+			GameObject& gameObject = script_game_object(L);
+			gameObject.mTransform.translate(glm::vec3(luaL_checknumber(L, 2), luaL_checknumber(L, 3), luaL_checknumber(L, 4)));
+			return 0;
+		}
+
+		// Around a local axis
+		int entity_rotate(lua_State* L) {
+			GameObject& gameObject = script_game_object(L);
+			float const angle = static_cast<float>(luaL_checknumber(L, 2));
+			glm::vec3 const axis(luaL_optnumber(L, 3, 0.0), luaL_optnumber(L, 4, 1.0), luaL_optnumber(L, 5, 0.0));
+			gameObject.mTransform.orientation = glm::rotate(gameObject.mTransform.orientation, angle, glm::normalize(axis));
+			return 0;
+		}
+	}
+
+	ScriptSystem::ScriptSystem(entt::registry& aRegistry) : mRegistry(aRegistry) {
+		lua_State* L = mLua.get();
+
+		luaL_newmetatable(L, kEntityMetatable);
+		lua_newtable(L);
+		lua_pushcfunction(L, entity_translate);
+		lua_setfield(L, -2, "translate");
+		lua_pushcfunction(L, entity_rotate);
+		lua_setfield(L, -2, "rotate");
+		lua_pushcclosure(L, entity_index, 1);
+		lua_setfield(L, -2, "__index");
+		lua_pushcfunction(L, entity_newindex);
+		lua_setfield(L, -2, "__newindex");
+		lua_pop(L, 1);
+
+		mRegistry.on_construct<Script>().connect<&ScriptSystem::on_script_constructed>(*this);
+		mRegistry.on_construct<PrefabInstance>().connect<&ScriptSystem::on_script_constructed>(*this);
+	}
+
+	ScriptSystem::~ScriptSystem() noexcept {
+		mRegistry.on_construct<Script>().disconnect<&ScriptSystem::on_script_constructed>(*this);
+		mRegistry.on_construct<PrefabInstance>().disconnect<&ScriptSystem::on_script_constructed>(*this);
+	}
+
+	std::size_t ScriptSystem::instances() const noexcept {
+		std::size_t count = 0;
+		for (ScriptType const& type : mTypes) count += type.instances.size();
+		return count;
+	}
+
+	void ScriptSystem::on_script_constructed(entt::registry&, entt::entity aEntity) {
+		mUnbound.push_back(aEntity);
+	}
+
+	std::size_t ScriptSystem::script_type(std::string const& aSource) {
+		if (auto it = mTypeIndices.find(aSource); it != mTypeIndices.end()) return it->second;
+
+		lua_State* L = mLua.get();
+		int function = LUA_NOREF;
+
+		if (!run_lua_file(L, aSource, 1)) {
+			spdlog::error("Failed to load script `{}`: {}", aSource, lua_tostring(L, -1));
+			lua_pop(L, 1);
+		}
+		else if (!lua_isfunction(L, -1)) {
+			spdlog::error("Script `{}` does not return a function", aSource);
+			lua_pop(L, 1);
+		}
+		else {
+			function = luaL_ref(L, LUA_REGISTRYINDEX);
+		}
+
+		mTypes.push_back({ aSource, function });
+		mTypeIndices.emplace(aSource, mTypes.size() - 1);
+		return mTypes.size() - 1;
+	}
+
+	void ScriptSystem::bind(entt::entity aEntity) {
+		std::string const* source = mRegistry.valid(aEntity) ? script_source(mRegistry, aEntity) : nullptr;
+		if (!source) return;
+
+		ScriptType& type = mTypes[script_type(*source)];
+		if (type.function == LUA_NOREF) return;
+
+		lua_State* L = mLua.get();
+		lua_State* thread = lua_newthread(L);
+		int const threadReference = luaL_ref(L, LUA_REGISTRYINDEX);
+
+		// The coroutine body and self wait on the thread's stack for the first resume
+		lua_rawgeti(thread, LUA_REGISTRYINDEX, type.function);
+		new (lua_newuserdatauv(thread, sizeof(ScriptEntity), 0)) ScriptEntity{ &mRegistry, aEntity };
+		luaL_setmetatable(thread, kEntityMetatable);
+
+		type.instances.push_back({ aEntity, thread, threadReference, mTime });
+	}
+
+	bool ScriptSystem::resume(ScriptType const& aType, Instance& aInstance) {
+		if (!mRegistry.valid(aInstance.entity)) return false;
+
+		// A reload that changed the source added the Script again, the new one has its own instance
+		std::string const* source = script_source(mRegistry, aInstance.entity);
+		if (!source || *source != aType.source) return false;
+
+		GameObject const* gameObject = mRegistry.try_get<GameObject>(aInstance.entity);
+		if (!gameObject) return false;
+
+		// Disabled entities keep their coroutine but don't build up time while they wait
+		if (!gameObject->mEnabled) {
+			aInstance.lastTime = mTime;
+			return true;
+		}
+
+		lua_State* thread = aInstance.thread;
+		lua_pushnumber(thread, mTime - aInstance.lastTime);
+		aInstance.lastTime = mTime;
+
+		int results = 0;
+		int const status = lua_resume(thread, mLua.get(), aInstance.started ? 1 : 2, &results);
+		aInstance.started = true;
+
+		if (status == LUA_YIELD) {
+			lua_pop(thread, results);
+			return true;
+		}
+
+		if (status != LUA_OK) spdlog::error("Script `{}` on `{}` failed: {}", aType.source, entity_name(mRegistry, aInstance.entity), lua_tostring(thread, -1));
+		return false;
+	}
+
+	void ScriptSystem::update(double aDeltaTime) {
+		using Clock = std::chrono::steady_clock;
+		auto const start = Clock::now();
+		auto const deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(mBudget));
+
+		mTime += aDeltaTime;
+
+		// An entity given both a Script and a PrefabInstance is queued twice but runs once
+		std::ranges::sort(mUnbound);
+		mUnbound.erase(std::ranges::unique(mUnbound).begin(), mUnbound.end());
+		for (entt::entity entity : mUnbound) bind(entity);
+		mUnbound.clear();
+
+		std::size_t const total = instances();
+
+		// A type with more instances than fit in the budget spreads its round over several updates, the others still get theirs
+		std::size_t const resumed = visit_round_robin(mTypes, mTypeCursor, [this](ScriptType& aType, Instance& aInstance) {
+			if (resume(aType, aInstance)) return true;
+
+			luaL_unref(mLua.get(), LUA_REGISTRYINDEX, aInstance.threadReference);
+			return false;
+		}, [&](std::size_t aVisited) {
+			return aVisited > 0 && aVisited % kBudgetCheckInterval == 0 && Clock::now() >= deadline;
+		});
+
+		mDeferred = total > resumed ? total - resumed : 0;
+		mLastUpdateTime = std::chrono::duration<double>(Clock::now() - start).count();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "rvo_lua.hpp"
+#include "rvo_utility.hpp"
+
+#include <entt/entt.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace rvo {
+	// Runs the coroutine of every entity with a `Script` or a scripted `Prefab`, spread over frames so scripts never take more than mBudget
+	// A script file returns function(self, dt), resumed once per update, `coroutine.yield()` returns the next dt
+	// self reads and writes the entity's GameObject in place: x, y, z, sx, sy, sz, enabled, name, translate(x, y, z), rotate(radians, x, y, z)
+	class ScriptSystem final {
+	public:
+		explicit ScriptSystem(entt::registry& aRegistry);
+		ScriptSystem(ScriptSystem const&) = delete;
+		ScriptSystem& operator=(ScriptSystem const&) = delete;
+		~ScriptSystem() noexcept;
+
+		// Instances of one script run back to back, starting each frame where the last one ran out of time
+		// Scripts that had to wait get the time since they last ran as their dt
+		void update(double aDeltaTime);
+
+		std::size_t instances() const noexcept;
+		std::size_t deferred() const noexcept { return mDeferred; }
+		double last_update_time() const noexcept { return mLastUpdateTime; }
+		LuaMemoryStats const& memory() const noexcept { return mLua.memory(); }
+
+		double mBudget = 0.002; // Seconds per update
+	private:
+		struct Instance final {
+			entt::entity entity;
+			lua_State* thread;
+			int threadReference;
+			double lastTime;
+			bool started = false;
+		};
+
+		struct ScriptType final {
+			std::string source;
+			int function; // Registry reference, LUA_NOREF when the file failed to load
+			std::vector<Instance> instances;
+			std::size_t cursor = 0;
+		};
+
+		void on_script_constructed(entt::registry& aRegistry, entt::entity aEntity);
+		void bind(entt::entity aEntity);
+		std::size_t script_type(std::string const& aSource);
+		// False once the instance finished, failed or lost its entity
+		bool resume(ScriptType const& aType, Instance& aInstance);
+
+		entt::registry& mRegistry;
+		LuaState mLua;
+		std::vector<ScriptType> mTypes;
+		rvo::UnorderedStringMap<std::size_t> mTypeIndices;
+		std::vector<entt::entity> mUnbound; // Scripts added since the last update
+		std::size_t mTypeCursor = 0;
+		std::size_t mDeferred = 0;
+		double mTime = 0.0;
+		double mLastUpdateTime = 0.0;
+	};
+}
\ No newline at end of file
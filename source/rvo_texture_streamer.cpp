@@ -0,0 +1,323 @@
+#include "rvo_texture_streamer.hpp"
+
+#include "rvo_utility.hpp"
+#include "rvo_vfs.hpp"
+#include "gfx/rvo_texture_cook.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <limits>
+
+namespace rvo {
+	namespace {
+		constexpr int kWorkerCount = 2;
+
+		// Level whose texels map roughly one to one onto the pixels the texture covers
+		std::size_t wanted_level(Ktx2Texture const& aInfo, float aScreenSize, std::size_t aTailLevel) {
+			if (aScreenSize <= 0.0f) return aTailLevel;
+
+			float const texels = static_cast<float>(glm::max(aInfo.width, aInfo.height));
+			float const level = glm::floor(glm::log2(texels / aScreenSize));
+			return static_cast<std::size_t>(glm::clamp(level, 0.0f, static_cast<float>(aTailLevel)));
+		}
+
+		std::size_t resident_size(Ktx2Texture const& aInfo, std::size_t aResidentLevel) {
+			std::size_t size = 0;
+			for (std::size_t i = aResidentLevel; i < aInfo.levels.size(); ++i) size += aInfo.levels[i].size;
+			return size;
+		}
+	}
+
+	TextureStreamer::TextureStreamer() {
+		for (int i = 0; i < kWorkerCount; ++i) {
+			mWorkers.emplace_back([this](std::stop_token aStopToken) { worker(aStopToken); });
+		}
+	}
+
+	TextureStreamer::~TextureStreamer() noexcept {
+		// Stops waiting workers, busy ones finish their read first
+		mWorkers.clear();
+
+		for (StagingSlot& slot : mStagingSlots) {
+			if (slot.fence) glDeleteSync(slot.fence);
+		}
+	}
+
+	std::shared_ptr<Texture> TextureStreamer::load(std::filesystem::path const& aSource, bool aSrgb) {
+		auto const cooked = rvo::cooked_path(aSource, aSrgb ? ".ktx2" : ".linear.ktx2");
+
+		if (!rvo::is_cooked_up_to_date(aSource, cooked) && !rvo::cook_texture(aSource, cooked, aSrgb)) {
+			return nullptr;
+		}
+
+		// Index the file first to find where the tail starts, then read only the tail
+		auto optInfo = rvo::read_ktx2(cooked, std::numeric_limits<std::size_t>::max());
+		if (!optInfo) return nullptr;
+
+		std::size_t tailLevel = 0;
+		while (tailLevel + 1 < optInfo->levels.size() && glm::max(optInfo->level_width(tailLevel), optInfo->level_height(tailLevel)) > kTailSize) {
+			++tailLevel;
+		}
+
+		auto optTail = rvo::read_ktx2(cooked, tailLevel);
+		if (!optTail) return nullptr;
+
+		if (!mStagingMemory) {
+			constexpr GLbitfield kFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+			mStagingBuffer = { {
+					.data = std::span(static_cast<std::byte const*>(nullptr), kStagingSlots * kStagingSlotSize),
+					.flags = kFlags,
+				} };
+
+			mStagingMemory = static_cast<std::byte*>(glMapNamedBufferRange(mStagingBuffer.handle(), 0, kStagingSlots * kStagingSlotSize, kFlags));
+		}
+
+		auto texture = std::make_shared<Texture>(Texture::make_from_ktx2(*optTail, tailLevel));
+
+		// The address may belong to a texture that died since the last update
+		if (auto it = mEntries.find(texture.get()); it != mEntries.end()) {
+			mResidentBytes -= resident_size(it->second.info, it->second.residentLevel);
+			mEntries.erase(it);
+		}
+
+		optTail->data.clear();
+		optTail->data.shrink_to_fit();
+
+		mResidentBytes += resident_size(*optTail, tailLevel);
+		mEntries.emplace(texture.get(), Entry{
+				.texture = texture,
+				.path = cooked,
+				.info = std::move(*optTail),
+				.residentLevel = tailLevel,
+				.tailLevel = tailLevel,
+			});
+
+		return texture;
+	}
+
+	void TextureStreamer::request(Texture const* aTexture, float aScreenSize) {
+		auto it = mEntries.find(aTexture);
+		if (it == mEntries.end()) return;
+
+		it->second.screenSize = glm::max(it->second.screenSize, aScreenSize);
+		it->second.lastUsedFrame = mFrame;
+	}
+
+	void TextureStreamer::update() {
+		for (StagingSlot& slot : mStagingSlots) {
+			if (!slot.fence) continue;
+
+			GLenum const status = glClientWaitSync(slot.fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) continue;
+
+			glDeleteSync(slot.fence);
+			slot.fence = nullptr;
+			slot.busy = false;
+		}
+
+		std::vector<std::unique_ptr<Job>> completed;
+		{
+			std::scoped_lock lock(mMutex);
+			completed.swap(mCompleted);
+		}
+
+		for (auto& job : completed) finish(*job);
+
+		for (auto it = mEntries.begin(); it != mEntries.end();) {
+			if (it->second.texture.expired()) {
+				mResidentBytes -= resident_size(it->second.info, it->second.residentLevel);
+				it = mEntries.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+
+		std::vector<Entry*> candidates;
+		for (auto& [key, entry] : mEntries) {
+			if (entry.loading) continue;
+			if (wanted_level(entry.info, entry.screenSize, entry.tailLevel) < entry.residentLevel) candidates.push_back(&entry);
+		}
+
+		// Largest on screen first, one level per texture per frame
+		std::ranges::sort(candidates, std::greater{}, [](Entry const* aEntry) { return aEntry->screenSize; });
+
+		bool scheduled = false;
+
+		for (Entry* entry : candidates) {
+			std::size_t const level = entry->residentLevel - 1;
+			Ktx2Texture::Level const range = entry->info.levels[level];
+
+			// Make room by dropping the top level of whatever went unseen the longest, or holds more than it needs
+			while (mResidentBytes + mInFlightBytes + range.size > mBudget) {
+				Entry* victim = nullptr;
+
+				for (auto& [key, other] : mEntries) {
+					if (other.loading || other.residentLevel >= other.tailLevel) continue;
+
+					bool const unused = other.lastUsedFrame < mFrame;
+					bool const excess = wanted_level(other.info, other.screenSize, other.tailLevel) > other.residentLevel;
+					if (!unused && !excess) continue;
+
+					if (!victim || other.lastUsedFrame < victim->lastUsedFrame) victim = &other;
+				}
+
+				if (!victim) break;
+				demote(*victim);
+			}
+
+			// Everything resident is in use, the budget wins over quality
+			if (mResidentBytes + mInFlightBytes + range.size > mBudget) break;
+
+			int slot = -1;
+			if (range.size <= kStagingSlotSize) {
+				auto it = std::ranges::find_if(mStagingSlots, [](StagingSlot const& aSlot) { return !aSlot.busy; });
+				if (it == mStagingSlots.end()) break;
+
+				it->busy = true;
+				slot = static_cast<int>(it - mStagingSlots.begin());
+			}
+
+			auto job = std::make_unique<Job>(Job{
+					.texture = entry->texture,
+					.path = entry->path,
+					.level = level,
+					.range = range,
+					.slot = slot,
+				});
+
+			entry->loading = true;
+			mInFlightBytes += range.size;
+
+			std::scoped_lock lock(mMutex);
+			mPending.push_back(std::move(job));
+			scheduled = true;
+		}
+
+		if (scheduled) mCondition.notify_all();
+
+		for (auto& [key, entry] : mEntries) entry.screenSize = 0.0f;
+		++mFrame;
+	}
+
+	void TextureStreamer::worker(std::stop_token aStopToken) {
+		rvo::BatchFileReader reader;
+
+		while (true) {
+			std::vector<std::unique_ptr<Job>> jobs;
+
+			// Everything scheduled so far is read as one batch
+			{
+				std::unique_lock lock(mMutex);
+				if (!mCondition.wait(lock, aStopToken, [this] { return !mPending.empty(); })) return;
+
+				jobs.assign(std::make_move_iterator(mPending.begin()), std::make_move_iterator(mPending.end()));
+				mPending.clear();
+			}
+
+			std::vector<rvo::FileRead> reads;
+			reads.reserve(jobs.size());
+
+			for (auto& job : jobs) {
+				std::span<std::byte> destination;
+				if (job->slot >= 0) {
+					destination = staging(job->slot).first(job->range.size);
+				}
+				else {
+					job->storage.resize(job->range.size);
+					destination = job->storage;
+				}
+
+				reads.push_back({ .path = job->path, .offset = job->range.offset, .destination = destination });
+			}
+
+			rvo::vfs::read_ranges(reads, reader);
+
+			std::scoped_lock lock(mMutex);
+			for (std::size_t i = 0; i < jobs.size(); ++i) {
+				jobs[i]->success = reads[i].success;
+				mCompleted.push_back(std::move(jobs[i]));
+			}
+		}
+	}
+
+	void TextureStreamer::finish(Job& aJob) {
+		mInFlightBytes -= aJob.range.size;
+
+		auto texture = aJob.texture.lock();
+		auto it = texture ? mEntries.find(texture.get()) : mEntries.end();
+		if (it != mEntries.end()) it->second.loading = false;
+
+		if (!aJob.success) {
+			spdlog::warn("Failed to stream level {} of `{}`", aJob.level, aJob.path.string());
+		}
+
+		// Demoted while the read was in flight, the level no longer fits onto the chain
+		bool const current = aJob.success && it != mEntries.end() && it->second.residentLevel == aJob.level + 1;
+
+		if (current) {
+			Entry& entry = it->second;
+			Texture promoted = reallocate(entry, *texture, aJob.level);
+
+			GLenum const format = block_internal_format(entry.info.format, entry.info.srgb);
+			GLsizei const width = static_cast<GLsizei>(entry.info.level_width(aJob.level));
+			GLsizei const height = static_cast<GLsizei>(entry.info.level_height(aJob.level));
+
+			if (aJob.slot >= 0) {
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mStagingBuffer.handle());
+				glCompressedTextureSubImage2D(promoted.handle(), 0, 0, 0, width, height, format, static_cast<GLsizei>(aJob.range.size), reinterpret_cast<void const*>(aJob.slot * kStagingSlotSize));
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			}
+			else {
+				promoted.upload_compressed(0, width, height, format, aJob.storage);
+			}
+
+			*texture = std::move(promoted);
+			entry.residentLevel = aJob.level;
+			mResidentBytes += aJob.range.size;
+		}
+
+		if (aJob.slot >= 0) {
+			StagingSlot& slot = mStagingSlots[aJob.slot];
+
+			if (current) {
+				slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			}
+			else {
+				slot.busy = false;
+			}
+		}
+	}
+
+	Texture TextureStreamer::reallocate(Entry const& aEntry, Texture const& aTexture, std::size_t aLevel) const {
+		Texture result = Texture::make_from_ktx2(aEntry.info, aLevel);
+
+		for (std::size_t i = glm::max(aLevel, aEntry.residentLevel); i < aEntry.info.levels.size(); ++i) {
+			GLsizei const width = static_cast<GLsizei>(aEntry.info.level_width(i));
+			GLsizei const height = static_cast<GLsizei>(aEntry.info.level_height(i));
+			GLint const sourceLevel = static_cast<GLint>(i - aEntry.residentLevel);
+			GLint const destinationLevel = static_cast<GLint>(i - aLevel);
+
+			glCopyImageSubData(aTexture.handle(), GL_TEXTURE_2D, sourceLevel, 0, 0, 0, result.handle(), GL_TEXTURE_2D, destinationLevel, 0, 0, 0, width, height, 1);
+		}
+
+		return result;
+	}
+
+	void TextureStreamer::demote(Entry& aEntry) {
+		auto texture = aEntry.texture.lock();
+		if (!texture) return;
+
+		*texture = reallocate(aEntry, *texture, aEntry.residentLevel + 1);
+		mResidentBytes -= aEntry.info.levels[aEntry.residentLevel].size;
+		++aEntry.residentLevel;
+	}
+
+	std::span<std::byte> TextureStreamer::staging(int aSlot) const noexcept {
+		return { mStagingMemory + aSlot * kStagingSlotSize, kStagingSlotSize };
+	}
+}
\ No newline at end of file
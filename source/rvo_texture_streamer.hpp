@@ -0,0 +1,100 @@
+#pragma once
+
+#include "rvo_gfx.hpp"
+#include "gfx/rvo_ktx2.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace rvo {
+	// Keeps only the mip levels that are large enough to matter on screen in vram
+	// Streamed textures are reallocated to hold exactly their resident levels, higher levels are read from the cooked ktx2 on worker threads
+	class TextureStreamer final {
+	public:
+		// Levels of this size and below are loaded up front and never dropped
+		static constexpr std::uint32_t kTailSize = 64;
+
+		TextureStreamer();
+		TextureStreamer(TextureStreamer const&) = delete;
+		TextureStreamer& operator=(TextureStreamer const&) = delete;
+		~TextureStreamer() noexcept;
+
+		// Cooks aSource when needed and uploads only the tail of its mip chain, nullptr on failure
+		std::shared_ptr<Texture> load(std::filesystem::path const& aSource, bool aSrgb = true);
+
+		// aScreenSize is the projected size in pixels of a surface sampling aTexture over its whole uv range
+		// Call for every use during the frame, the largest request wins
+		void request(Texture const* aTexture, float aScreenSize);
+
+		// Once per frame on the gl thread, uploads finished reads, schedules new ones and enforces mBudget
+		void update();
+
+		std::size_t resident_bytes() const noexcept { return mResidentBytes; }
+		std::size_t streamed_textures() const noexcept { return mEntries.size(); }
+
+		std::size_t mBudget = 256 * 1024 * 1024;
+	private:
+		static constexpr std::size_t kStagingSlots = 8;
+		static constexpr std::size_t kStagingSlotSize = 4 * 1024 * 1024;
+
+		struct Entry final {
+			std::weak_ptr<Texture> texture;
+			std::filesystem::path path;
+			Ktx2Texture info; // Without data
+			std::size_t residentLevel; // Largest level in vram
+			std::size_t tailLevel; // Largest level that is never dropped
+			float screenSize = 0.0f; // Largest request this frame
+			std::uint64_t lastUsedFrame = 0;
+			bool loading = false;
+		};
+
+		struct Job final {
+			std::weak_ptr<Texture> texture;
+			std::filesystem::path path;
+			std::size_t level;
+			Ktx2Texture::Level range;
+			int slot; // Staging slot the level is read into, -1 for levels too large for a slot
+			std::vector<std::byte> storage; // Used instead of the staging slot
+			bool success = false;
+		};
+
+		struct StagingSlot final {
+			bool busy = false;
+			GLsync fence = nullptr; // Set while the gpu may still read from the slot
+		};
+
+		void worker(std::stop_token aStopToken);
+		void finish(Job& aJob);
+		// Rebuilds the texture with aLevel as its largest level, copying the levels both share
+		Texture reallocate(Entry const& aEntry, Texture const& aTexture, std::size_t aLevel) const;
+		void demote(Entry& aEntry);
+		std::span<std::byte> staging(int aSlot) const noexcept;
+
+		std::unordered_map<Texture const*, Entry> mEntries;
+		std::size_t mResidentBytes = 0;
+		std::size_t mInFlightBytes = 0;
+		std::uint64_t mFrame = 0;
+
+		Buffer mStagingBuffer;
+		std::byte* mStagingMemory = nullptr;
+		std::array<StagingSlot, kStagingSlots> mStagingSlots;
+
+		std::mutex mMutex;
+		std::condition_variable_any mCondition;
+		std::deque<std::unique_ptr<Job>> mPending;
+		std::vector<std::unique_ptr<Job>> mCompleted;
+
+		// Last so the workers are joined before anything they touch is destroyed
+		std::vector<std::jthread> mWorkers;
+	};
+}
\ No newline at end of file
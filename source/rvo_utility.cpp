@@ -1,29 +1,319 @@
 #include "rvo_utility.hpp"
 
+#include "rvo_vfs.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <thread>
+
+#ifdef _WIN32
+#	include <Windows.h>
+#else
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#	define RVO_IO_URING
+#	include <cerrno>
+#	include <linux/io_uring.h>
+#	include <sys/syscall.h>
+#endif
 
 namespace rvo {
 	std::optional<std::vector<std::byte>> read_file_bytes(std::filesystem::path const& aPath) {
-		std::ifstream stream(aPath, std::ios::binary);
-		if (!stream) return std::nullopt;
+		MappedFile file(aPath);
+		if (!file) return std::nullopt;
 
-		stream.seekg(0, std::ios::end);
-		std::vector<std::byte> bytes(stream.tellg());
-		stream.seekg(0, std::ios::beg);
-		stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
-
-		return bytes;
+		return std::vector<std::byte>(file.bytes().begin(), file.bytes().end());
 	}
 
 	std::optional<std::string> read_file_string(std::filesystem::path const& aPath) {
+		MappedFile file(aPath);
+		if (!file) return std::nullopt;
+
+		return std::string(reinterpret_cast<char const*>(file.bytes().data()), file.bytes().size());
+	}
+
+	bool read_file_range(std::filesystem::path const& aPath, std::size_t aOffset, std::span<std::byte> aDestination) {
 		std::ifstream stream(aPath, std::ios::binary);
-		if (!stream) return std::nullopt;
+		if (!stream) return false;
+
+		stream.seekg(static_cast<std::streamoff>(aOffset));
+		stream.read(reinterpret_cast<char*>(aDestination.data()), aDestination.size());
+
+		return static_cast<bool>(stream);
+	}
+
+	MappedFile::MappedFile(std::filesystem::path const& aPath) {
+#ifdef _WIN32
+		HANDLE file = CreateFileW(aPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE) return;
+
+		// Empty files cannot be mapped, they are valid with no bytes
+		LARGE_INTEGER size;
+		if (GetFileSizeEx(file, &size)) {
+			mValid = size.QuadPart == 0;
+
+			if (size.QuadPart > 0 && (mMapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr))) {
+				mData = static_cast<std::byte const*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+				mSize = static_cast<std::size_t>(size.QuadPart);
+				mValid = mData != nullptr;
+			}
+		}
+
+		// The mapping keeps the file open
+		CloseHandle(file);
+#else
+		int const file = open(aPath.c_str(), O_RDONLY | O_CLOEXEC);
+		if (file < 0) return;
+
+		// Empty files cannot be mapped, they are valid with no bytes
+		struct stat info;
+		if (fstat(file, &info) == 0 && S_ISREG(info.st_mode)) {
+			mValid = info.st_size == 0;
+
+			if (info.st_size > 0) {
+				void* data = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+				if (data != MAP_FAILED) {
+					mData = static_cast<std::byte const*>(data);
+					mSize = static_cast<std::size_t>(info.st_size);
+					mValid = true;
+				}
+			}
+		}
+
+		// The mapping keeps the file open
+		close(file);
+#endif
+
+		if (!mData) mSize = 0;
+	}
+
+	MappedFile::~MappedFile() noexcept {
+#ifdef _WIN32
+		if (mData) UnmapViewOfFile(mData);
+		if (mMapping) CloseHandle(mMapping);
+#else
+		if (mData) munmap(const_cast<std::byte*>(mData), mSize);
+#endif
+	}
+
+#ifdef RVO_IO_URING
+	// The raw ring, liburing is not vendored and only a fraction of it is needed
+	struct BatchFileReader::Ring final {
+		static constexpr unsigned kEntries = 64;
+
+		int fd = -1;
+		void* sqMap = MAP_FAILED;
+		std::size_t sqMapSize = 0;
+		void* cqMap = MAP_FAILED;
+		std::size_t cqMapSize = 0;
+		io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+		std::size_t sqesSize = 0;
+
+		unsigned* sqTail = nullptr;
+		unsigned sqMask = 0;
+		unsigned* sqArray = nullptr;
+		unsigned* cqHead = nullptr;
+		unsigned* cqTail = nullptr;
+		unsigned cqMask = 0;
+		io_uring_cqe* cqes = nullptr;
+
+		~Ring() noexcept {
+			if (sqes != MAP_FAILED) munmap(sqes, sqesSize);
+			if (cqMap != MAP_FAILED && cqMap != sqMap) munmap(cqMap, cqMapSize);
+			if (sqMap != MAP_FAILED) munmap(sqMap, sqMapSize);
+			if (fd >= 0) close(fd);
+		}
+
+		bool init() {
+			io_uring_params params{};
+			fd = static_cast<int>(syscall(__NR_io_uring_setup, kEntries, &params));
+			if (fd < 0) return false;
+
+			sqMapSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+			cqMapSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+			// Kernels since 5.4 share one mapping between both rings
+			if (params.features & IORING_FEAT_SINGLE_MMAP) sqMapSize = cqMapSize = std::max(sqMapSize, cqMapSize);
+
+			sqMap = mmap(nullptr, sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+			if (sqMap == MAP_FAILED) return false;
+
+			cqMap = params.features & IORING_FEAT_SINGLE_MMAP ? sqMap : mmap(nullptr, cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+			if (cqMap == MAP_FAILED) return false;
+
+			sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+			sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+			if (sqes == MAP_FAILED) return false;
+
+			auto* const sq = static_cast<std::byte*>(sqMap);
+			auto* const cq = static_cast<std::byte*>(cqMap);
+			sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+			sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+			sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+			cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+			cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+			cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+			cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+			return true;
+		}
+	};
+
+	BatchFileReader::BatchFileReader() {
+		auto ring = std::make_unique<Ring>();
+		if (ring->init()) mRing = std::move(ring);
+	}
+
+	// Reads as many ranges as fit the ring with one io_uring_enter, short reads are resubmitted for their remainder
+	// Only returns once the kernel is done with every buffer, a read still running would write into memory the caller reclaimed
+	bool BatchFileReader::read_ring(std::span<FileRead*> aReads) {
+		struct Pending final {
+			FileRead* read;
+			int fd;
+			std::size_t done = 0;
+		};
+
+		std::vector<Pending> pending;
+		pending.reserve(aReads.size());
+
+		for (FileRead* read : aReads) {
+			int const fd = open(read->path.c_str(), O_RDONLY | O_CLOEXEC);
+			read->success = false;
+			if (fd >= 0) pending.push_back({ read, fd });
+		}
+
+		std::vector<std::size_t> queue(pending.size());
+		for (std::size_t i = 0; i < queue.size(); ++i) queue[i] = i;
+
+		bool ringWorks = true;
+		unsigned tail = std::atomic_ref(*mRing->sqTail).load(std::memory_order_relaxed);
+		std::size_t unsubmitted = 0; // In the submission queue, not taken by the kernel yet
+		std::size_t inFlight = 0; // Taken by the kernel and not completed
+
+		while (inFlight > 0 || unsubmitted > 0 || (ringWorks && !queue.empty())) {
+			// At most kEntries outstanding, the completion queue is twice that so it never overflows
+			std::size_t const count = ringWorks ? std::min(queue.size(), Ring::kEntries - inFlight - unsubmitted) : 0;
+
+			for (std::size_t i = 0; i < count; ++i) {
+				Pending const& entry = pending[queue[i]];
+				unsigned const index = tail & mRing->sqMask;
+
+				io_uring_sqe& sqe = mRing->sqes[index];
+				sqe = {};
+				sqe.opcode = IORING_OP_READ;
+				sqe.fd = entry.fd;
+				sqe.off = entry.read->offset + entry.done;
+				sqe.addr = reinterpret_cast<std::uint64_t>(entry.read->destination.data() + entry.done);
+				sqe.len = static_cast<std::uint32_t>(std::min<std::size_t>(entry.read->destination.size() - entry.done, 1u << 30));
+				sqe.user_data = queue[i];
+
+				mRing->sqArray[index] = index;
+				++tail;
+			}
+
+			std::atomic_ref(*mRing->sqTail).store(tail, std::memory_order_release);
+			queue.erase(queue.begin(), queue.begin() + count);
+			unsubmitted += count;
+
+			// Returns early when interrupted or when only part of the queue was taken, the loop submits and waits again
+			int const submitted = static_cast<int>(syscall(__NR_io_uring_enter, mRing->fd, static_cast<unsigned>(unsubmitted), static_cast<unsigned>(inFlight + unsubmitted), IORING_ENTER_GETEVENTS, nullptr, 0));
+			if (submitted >= 0) {
+				inFlight += static_cast<std::size_t>(submitted);
+				unsubmitted -= static_cast<std::size_t>(submitted);
+			}
+			else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+				// The kernel never took these, pulling the tail back withdraws them. Reads in flight are still waited for
+				tail -= static_cast<unsigned>(unsubmitted);
+				std::atomic_ref(*mRing->sqTail).store(tail, std::memory_order_release);
+				unsubmitted = 0;
+				ringWorks = false;
+			}
+
+			unsigned head = std::atomic_ref(*mRing->cqHead).load(std::memory_order_relaxed);
+			unsigned const cqTail = std::atomic_ref(*mRing->cqTail).load(std::memory_order_acquire);
+
+			for (; head != cqTail; ++head) {
+				io_uring_cqe const& cqe = mRing->cqes[head & mRing->cqMask];
+				Pending& entry = pending[cqe.user_data];
+				--inFlight;
+
+				if (cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP) {
+					// IORING_OP_READ needs linux 5.6, older kernels take the thread path
+					ringWorks = false;
+				}
+				else if (cqe.res > 0) {
+					entry.done += static_cast<std::size_t>(cqe.res);
+					if (entry.done < entry.read->destination.size()) queue.push_back(cqe.user_data);
+					else entry.read->success = true;
+				}
+				else if (entry.read->destination.empty()) {
+					entry.read->success = cqe.res == 0;
+				}
+			}
+
+			std::atomic_ref(*mRing->cqHead).store(head, std::memory_order_release);
+		}
+
+		for (Pending const& entry : pending) close(entry.fd);
+		return ringWorks;
+	}
+#else
+	struct BatchFileReader::Ring final {};
+
+	BatchFileReader::BatchFileReader() = default;
+
+	bool BatchFileReader::read_ring(std::span<FileRead*>) {
+		return false;
+	}
+#endif
+
+	BatchFileReader::~BatchFileReader() noexcept = default;
+
+	void BatchFileReader::read(std::span<FileRead> aReads) {
+		std::vector<FileRead*> reads;
+		for (FileRead& read : aReads) reads.push_back(&read);
+
+		if (mRing && read_ring(reads)) return;
+
+		if (mRing) {
+			spdlog::warn("io_uring reads failed, falling back to threads");
+			mRing.reset();
+		}
+
+		// Ranges are split across a few threads, each one reads its share with plain blocking reads
+		unsigned const threadCount = std::min<unsigned>(std::max(std::thread::hardware_concurrency(), 1u), static_cast<unsigned>(aReads.size()));
+
+		auto read_share = [&](unsigned aFirst) {
+			for (std::size_t i = aFirst; i < aReads.size(); i += threadCount) {
+				aReads[i].success = read_file_range(aReads[i].path, aReads[i].offset, aReads[i].destination);
+			}
+		};
+
+		std::vector<std::jthread> threads;
+		for (unsigned i = 1; i < threadCount; ++i) threads.emplace_back(read_share, i);
+		if (threadCount > 0) read_share(0);
+	}
+
+	std::filesystem::path cooked_path(std::filesystem::path const& aSource, std::string_view aSuffix) {
+		std::filesystem::path path = "cooked" / aSource.relative_path();
+		path += aSuffix;
+		return path;
+	}
 
-		stream.seekg(0, std::ios::end);
-		std::string bytes(stream.tellg(), ' ');
-		stream.seekg(0, std::ios::beg);
-		stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+	bool is_cooked_up_to_date(std::filesystem::path const& aSource, std::filesystem::path const& aCooked) {
+		auto const cookedTime = vfs::last_write_time(aCooked);
+		if (!cookedTime) return false;
 
-		return bytes;
+		// A cooked file without its source is all there is to load
+		auto const sourceTime = vfs::last_write_time(aSource);
+		return !sourceTime || *cookedTime >= *sourceTime;
 	}
 }
\ No newline at end of file
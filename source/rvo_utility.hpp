@@ -2,17 +2,119 @@
 
 #include <vector>
 #include <optional>
+#include <span>
 #include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <utility>
 
 namespace rvo {
 	template<typename T> auto size_bytes(T const& data) noexcept { return sizeof(typename T::value_type) * data.size(); }
 
+	// 64 bit FNV-1a, chain calls by passing the previous hash as aHash
+	constexpr std::uint64_t kFnv1aBasis = 14695981039346656037ull;
+
+	constexpr std::uint64_t fnv1a(std::string_view aString, std::uint64_t aHash = kFnv1aBasis) noexcept {
+		for (char c : aString) {
+			aHash ^= static_cast<std::uint8_t>(c);
+			aHash *= 1099511628211ull;
+		}
+		return aHash;
+	}
+
+	constexpr std::uint64_t fnv1a(std::span<std::byte const> aBytes, std::uint64_t aHash = kFnv1aBasis) noexcept {
+		for (std::byte b : aBytes) {
+			aHash ^= static_cast<std::uint8_t>(b);
+			aHash *= 1099511628211ull;
+		}
+		return aHash;
+	}
+
 	std::optional<std::vector<std::byte>> read_file_bytes(std::filesystem::path const& aPath);
 	std::optional<std::string> read_file_string(std::filesystem::path const& aPath);
+	// Fills aDestination from aOffset, false when the file is missing or too short
+	bool read_file_range(std::filesystem::path const& aPath, std::size_t aOffset, std::span<std::byte> aDestination);
+
+	// Where derived data for aSource is cached, `cooked/<aSource><aSuffix>`
+	std::filesystem::path cooked_path(std::filesystem::path const& aSource, std::string_view aSuffix);
+	// True when aCooked exists and is at least as new as aSource, or aSource is gone, both are resolved through `rvo::vfs`
+	bool is_cooked_up_to_date(std::filesystem::path const& aSource, std::filesystem::path const& aCooked);
+
+	// Read only view of a whole file, the mapping lives as long as the object
+	class MappedFile final {
+	public:
+		constexpr MappedFile() noexcept = default;
+		// Invalid on failure, check with `operator bool`. Empty files are valid but map nothing
+		explicit MappedFile(std::filesystem::path const& aPath);
+		MappedFile(MappedFile const&) = delete;
+		MappedFile& operator=(MappedFile const&) = delete;
+		inline MappedFile(MappedFile&& aOther) noexcept { swap(aOther); }
+		inline MappedFile& operator=(MappedFile&& aOther) noexcept { swap(aOther); return *this; }
+		~MappedFile() noexcept;
+
+		inline void swap(MappedFile& aOther) noexcept {
+			std::swap(mData, aOther.mData);
+			std::swap(mSize, aOther.mSize);
+			std::swap(mMapping, aOther.mMapping);
+			std::swap(mValid, aOther.mValid);
+		}
+
+		std::span<std::byte const> bytes() const noexcept { return { mData, mSize }; }
+		explicit operator bool() const noexcept { return mValid; }
+	private:
+		std::byte const* mData = nullptr;
+		std::size_t mSize = 0;
+		void* mMapping = nullptr; // File mapping handle on windows
+		bool mValid = false;
+	};
+
+	// Whole file contents for consumers that only read them, a mapping for loose files or the decoded bytes of a packed one
+	class FileView final {
+	public:
+		FileView() = default;
+		explicit FileView(MappedFile aMapping) noexcept : mMapping(std::move(aMapping)) {}
+		explicit FileView(std::vector<std::byte> aStorage) noexcept : mStorage(std::move(aStorage)) {}
+
+		std::span<std::byte const> bytes() const noexcept { return mStorage.empty() ? mMapping.bytes() : std::span<std::byte const>(mStorage); }
+		std::string_view text() const noexcept { return { reinterpret_cast<char const*>(bytes().data()), bytes().size() }; }
+	private:
+		MappedFile mMapping;
+		std::vector<std::byte> mStorage;
+	};
+
+	// One range of a `BatchFileReader` batch, aDestination must stay valid until the batch returns
+	struct FileRead final {
+		std::filesystem::path path;
+		std::size_t offset = 0;
+		std::span<std::byte> destination;
+		bool success = false;
+	};
+
+	// Reads many ranges with as few syscalls as the platform allows
+	// On linux every batch is a single io_uring submission, elsewhere or when io_uring is unavailable a few threads share the batch
+	// Not thread safe, every loader thread owns its own
+	class BatchFileReader final {
+	public:
+		BatchFileReader();
+		BatchFileReader(BatchFileReader const&) = delete;
+		BatchFileReader& operator=(BatchFileReader const&) = delete;
+		~BatchFileReader() noexcept;
+
+		// Blocks until every read finished, a failed read only clears its own `success`
+		void read(std::span<FileRead> aReads);
+
+		bool uses_io_uring() const noexcept { return mRing != nullptr; }
+	private:
+		struct Ring;
+
+		bool read_ring(std::span<FileRead*> aReads);
+
+		std::unique_ptr<Ring> mRing;
+	};
 
 	struct StringMultiHash final {
 		using hash_type = std::hash<std::string_view>;
@@ -23,4 +125,41 @@ namespace rvo {
 	};
 
 	template<class V> using UnorderedStringMap = std::unordered_map<std::string, V, StringMultiHash, std::equal_to<>>;
+
+	// Budgeted round robin over groups, each group has `instances` and a `cursor` to the next one to visit
+	// Every instance is visited at most once per round, a round spread over several calls picks up at aGroupCursor
+	// aOutOfBudget(visited) is asked before every visit, aVisit(group, instance) returns false to swap remove the instance
+	// Returns how many instances were visited, aGroupCursor is back at 0 once a round completes
+	template<typename Group, typename Visit, typename OutOfBudget>
+	std::size_t visit_round_robin(std::vector<Group>& aGroups, std::size_t& aGroupCursor, Visit&& aVisit, OutOfBudget&& aOutOfBudget) {
+		std::size_t visited = 0;
+
+		// Groups before aGroupCursor already had their turn this round
+		for (std::size_t groupIndex = aGroupCursor; groupIndex < aGroups.size(); ++groupIndex) {
+			Group& group = aGroups[groupIndex];
+
+			// Only up to the end, instances before the cursor already ran this round
+			while (group.cursor < group.instances.size()) {
+				if (aOutOfBudget(visited)) {
+					aGroupCursor = groupIndex;
+					return visited;
+				}
+
+				++visited;
+				if (aVisit(group, group.instances[group.cursor])) {
+					++group.cursor;
+					continue;
+				}
+
+				// The last instance has not run this round yet, it takes the slot and is visited next
+				if (group.cursor + 1 != group.instances.size()) group.instances[group.cursor] = std::move(group.instances.back());
+				group.instances.pop_back();
+			}
+
+			group.cursor = 0;
+		}
+
+		aGroupCursor = 0;
+		return visited;
+	}
 }
\ No newline at end of file
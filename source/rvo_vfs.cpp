@@ -0,0 +1,171 @@
+#include "rvo_vfs.hpp"
+
+#include "rvo_pak.hpp"
+#include "rvo_utility.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
+
+namespace rvo::vfs {
+	namespace {
+		// Mounted in priority order, the last one is searched first
+		std::vector<Pak> gPaks;
+		// Loaders run on worker threads while paks may still be mounted
+		std::shared_mutex gMutex;
+
+		struct Found final {
+			Pak const* pak;
+			PakEntry const* entry;
+		};
+
+		std::optional<Found> find_packed(std::filesystem::path const& aPath) {
+			if (gPaks.empty()) return std::nullopt;
+
+			std::string const name = pak_name(aPath);
+			for (auto it = gPaks.rbegin(); it != gPaks.rend(); ++it) {
+				if (PakEntry const* entry = it->find(name)) return Found{ &*it, entry };
+			}
+
+			return std::nullopt;
+		}
+
+		bool is_loose(std::filesystem::path const& aPath) {
+			std::error_code error;
+			return std::filesystem::is_regular_file(aPath, error);
+		}
+	}
+
+	bool mount(std::filesystem::path const& aPak) {
+		auto optPak = Pak::open(aPak);
+		if (!optPak) return false;
+
+		spdlog::info("Mounted `{}` ({} files)", aPak.string(), optPak->entries().size());
+
+		std::unique_lock lock(gMutex);
+		gPaks.push_back(std::move(*optPak));
+		return true;
+	}
+
+	std::size_t mount_directory(std::filesystem::path const& aDirectory) {
+		std::vector<std::filesystem::path> paks;
+
+		std::error_code error;
+		for (auto const& file : std::filesystem::directory_iterator(aDirectory, error)) {
+			if (file.is_regular_file() && file.path().extension() == ".rvopak") paks.push_back(file.path());
+		}
+
+		std::ranges::sort(paks);
+		return std::ranges::count_if(paks, [](std::filesystem::path const& aPak) { return mount(aPak); });
+	}
+
+	void unmount_all() {
+		std::unique_lock lock(gMutex);
+		gPaks.clear();
+	}
+
+	bool exists(std::filesystem::path const& aPath) {
+		if (is_loose(aPath)) return true;
+
+		std::shared_lock lock(gMutex);
+		return find_packed(aPath).has_value();
+	}
+
+	std::optional<std::size_t> file_size(std::filesystem::path const& aPath) {
+		std::error_code error;
+		auto const size = std::filesystem::file_size(aPath, error);
+		if (!error) return static_cast<std::size_t>(size);
+
+		std::shared_lock lock(gMutex);
+		auto optFound = find_packed(aPath);
+		if (!optFound) return std::nullopt;
+
+		return static_cast<std::size_t>(optFound->entry->size);
+	}
+
+	std::optional<std::filesystem::file_time_type> last_write_time(std::filesystem::path const& aPath) {
+		std::error_code error;
+		auto const time = std::filesystem::last_write_time(aPath, error);
+		if (!error) return time;
+
+		std::shared_lock lock(gMutex);
+		auto optFound = find_packed(aPath);
+		if (!optFound) return std::nullopt;
+
+		return std::filesystem::file_time_type(std::filesystem::file_time_type::duration(optFound->entry->lastWriteTime));
+	}
+
+	std::optional<FileView> view(std::filesystem::path const& aPath) {
+		if (is_loose(aPath)) {
+			MappedFile file(aPath);
+			if (!file) return std::nullopt;
+			return FileView(std::move(file));
+		}
+
+		std::shared_lock lock(gMutex);
+		auto optFound = find_packed(aPath);
+		if (!optFound) return std::nullopt;
+
+		auto optBytes = optFound->pak->read(*optFound->entry);
+		if (!optBytes) return std::nullopt;
+		return FileView(std::move(*optBytes));
+	}
+
+	std::optional<std::vector<std::byte>> read_bytes(std::filesystem::path const& aPath) {
+		if (is_loose(aPath)) return rvo::read_file_bytes(aPath);
+
+		std::shared_lock lock(gMutex);
+		auto optFound = find_packed(aPath);
+		if (!optFound) return std::nullopt;
+
+		return optFound->pak->read(*optFound->entry);
+	}
+
+	std::optional<std::string> read_string(std::filesystem::path const& aPath) {
+		if (is_loose(aPath)) return rvo::read_file_string(aPath);
+
+		std::shared_lock lock(gMutex);
+		auto optFound = find_packed(aPath);
+		if (!optFound) return std::nullopt;
+
+		std::string string(optFound->entry->size, '\0');
+		if (!optFound->pak->read_range(*optFound->entry, 0, std::as_writable_bytes(std::span(string)))) return std::nullopt;
+		return string;
+	}
+
+	bool read_range(std::filesystem::path const& aPath, std::size_t aOffset, std::span<std::byte> aDestination) {
+		if (is_loose(aPath)) return rvo::read_file_range(aPath, aOffset, aDestination);
+
+		std::shared_lock lock(gMutex);
+		auto optFound = find_packed(aPath);
+		if (!optFound) return false;
+
+		return optFound->pak->read_range(*optFound->entry, aOffset, aDestination);
+	}
+
+	void read_ranges(std::span<FileRead> aReads, BatchFileReader& aReader) {
+		std::vector<FileRead> loose;
+		std::vector<std::size_t> looseIndices;
+
+		for (std::size_t i = 0; i < aReads.size(); ++i) {
+			FileRead& read = aReads[i];
+
+			if (is_loose(read.path)) {
+				loose.push_back(read);
+				looseIndices.push_back(i);
+				continue;
+			}
+
+			std::shared_lock lock(gMutex);
+			auto optFound = find_packed(read.path);
+			read.success = optFound && optFound->pak->read_range(*optFound->entry, read.offset, read.destination);
+		}
+
+		if (loose.empty()) return;
+
+		aReader.read(loose);
+		for (std::size_t i = 0; i < loose.size(); ++i) aReads[looseIndices[i]].success = loose[i].success;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "rvo_utility.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// Resolves asset paths against loose files under `working/` first, then the mounted paks
+// Loose files win so an edited asset overrides its packed copy during development
+namespace rvo::vfs {
+	// Later mounts take priority over earlier ones, false when aPak could not be opened
+	bool mount(std::filesystem::path const& aPak);
+	// Mounts every `.rvopak` in aDirectory in name order, returns how many were mounted
+	std::size_t mount_directory(std::filesystem::path const& aDirectory);
+	void unmount_all();
+
+	bool exists(std::filesystem::path const& aPath);
+	std::optional<std::size_t> file_size(std::filesystem::path const& aPath);
+	// Loose file time, or the time recorded when the file was packed
+	std::optional<std::filesystem::file_time_type> last_write_time(std::filesystem::path const& aPath);
+
+	// Zero copy for loose files, prefer it over `read_bytes` when the contents are only read
+	std::optional<FileView> view(std::filesystem::path const& aPath);
+	std::optional<std::vector<std::byte>> read_bytes(std::filesystem::path const& aPath);
+	std::optional<std::string> read_string(std::filesystem::path const& aPath);
+	// Fills aDestination from aOffset, false when the file is missing or too short
+	bool read_range(std::filesystem::path const& aPath, std::size_t aOffset, std::span<std::byte> aDestination);
+	// Loose ranges go through aReader as one batch, packed ranges are decoded from the mapped pak
+	void read_ranges(std::span<FileRead> aReads, BatchFileReader& aReader);
+}
\ No newline at end of file
@@ -0,0 +1,349 @@
+#include "rvo_virtual_texture.hpp"
+
+#include "rvo_utility.hpp"
+#include "rvo_vfs.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <iterator>
+
+namespace rvo {
+	namespace {
+		constexpr std::uint32_t kFeedbackValid = 1u << 31;
+		constexpr std::uint32_t kFeedbackIdShift = 26;
+	}
+
+	VirtualTexture::VirtualTexture(std::filesystem::path aPath, VirtualTextureHeader const& aHeader, std::uint32_t aId)
+		: mPath(std::move(aPath)), mHeader(aHeader), mId(aId) {
+		mAtlas = { {
+				.levels = 1,
+				.internalFormat = block_internal_format(BlockFormat::BC1, mHeader.srgb != 0),
+				.width = static_cast<GLsizei>(kAtlasPages * kVirtualTileSize),
+				.height = static_cast<GLsizei>(kAtlasPages * kVirtualTileSize),
+				.minFilter = GL_LINEAR,
+				.magFilter = GL_LINEAR,
+				.wrap = GL_CLAMP_TO_EDGE,
+				.anisotropy = 1.0f, // The border only covers a bilinear footprint
+			} };
+
+		mPageTable = { {
+				.levels = static_cast<GLsizei>(mHeader.levels),
+				.internalFormat = GL_RGBA8UI,
+				.width = static_cast<GLsizei>(mHeader.pages),
+				.height = static_cast<GLsizei>(mHeader.pages),
+				.minFilter = GL_NEAREST_MIPMAP_NEAREST,
+				.magFilter = GL_NEAREST,
+				.wrap = GL_REPEAT,
+				.anisotropy = 1.0f,
+			} };
+
+		for (std::uint32_t level = 0; level < mHeader.levels; ++level) {
+			glClearTexImage(mPageTable.handle(), static_cast<GLint>(level), GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, nullptr);
+		}
+
+		mSlots.resize(static_cast<std::size_t>(kAtlasPages) * kAtlasPages);
+
+		std::uint32_t const root = make_page(mHeader.levels - 1, 0, 0);
+		std::vector<std::byte> tile(mHeader.tileBytes);
+
+		if (rvo::vfs::read_range(mPath, mHeader.tile_offset(mHeader.levels - 1, 0, 0), tile)) {
+			upload(root, 0, tile, 0);
+			mSlots[0].pinned = true;
+		}
+		else {
+			spdlog::error("Failed to read the last level of `{}`", mPath.string());
+		}
+	}
+
+	bool VirtualTexture::touch(std::uint32_t aPage, std::uint64_t aFrame) {
+		auto it = mResident.find(aPage);
+		if (it == mResident.end()) return false;
+
+		mSlots[it->second].lastUsedFrame = aFrame;
+		return true;
+	}
+
+	std::optional<std::size_t> VirtualTexture::allocate(std::uint64_t aOldestEvictable) {
+		std::optional<std::size_t> best;
+
+		for (std::size_t i = 0; i < mSlots.size(); ++i) {
+			Slot const& slot = mSlots[i];
+			if (!slot.used) return i;
+			if (slot.pinned || slot.lastUsedFrame >= aOldestEvictable) continue;
+			if (!best || slot.lastUsedFrame < mSlots[*best].lastUsedFrame) best = i;
+		}
+
+		if (best) {
+			write_page_table(mSlots[*best].page, { 0, 0, 0, 0 });
+			mResident.erase(mSlots[*best].page);
+			mSlots[*best].used = false;
+		}
+
+		return best;
+	}
+
+	void VirtualTexture::upload(std::uint32_t aPage, std::size_t aSlot, std::span<std::byte const> aTile, std::uint64_t aFrame) {
+		std::uint32_t const x = static_cast<std::uint32_t>(aSlot % kAtlasPages);
+		std::uint32_t const y = static_cast<std::uint32_t>(aSlot / kAtlasPages);
+
+		glCompressedTextureSubImage2D(mAtlas.handle(), 0, x * kVirtualTileSize, y * kVirtualTileSize, kVirtualTileSize, kVirtualTileSize, block_internal_format(BlockFormat::BC1, mHeader.srgb != 0), static_cast<GLsizei>(aTile.size()), aTile.data());
+		write_page_table(aPage, { static_cast<std::uint8_t>(x), static_cast<std::uint8_t>(y), 0, 255 });
+
+		mSlots[aSlot] = { .page = aPage, .lastUsedFrame = aFrame, .used = true };
+		mResident[aPage] = aSlot;
+	}
+
+	void VirtualTexture::write_page_table(std::uint32_t aPage, std::array<std::uint8_t, 4> const& aEntry) const {
+		glTextureSubImage2D(mPageTable.handle(), static_cast<GLint>(page_level(aPage)), static_cast<GLint>(page_x(aPage)), static_cast<GLint>(page_y(aPage)), 1, 1, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, aEntry.data());
+	}
+
+	VirtualTextureSystem::VirtualTextureSystem() {
+		mWorker = std::jthread([this](std::stop_token aStopToken) { worker(aStopToken); });
+	}
+
+	VirtualTextureSystem::~VirtualTextureSystem() noexcept {
+		mWorker = {};
+
+		for (Readback& readback : mReadbacks) {
+			if (readback.fence) glDeleteSync(readback.fence);
+		}
+	}
+
+	std::shared_ptr<VirtualTexture> VirtualTextureSystem::load(std::filesystem::path const& aSource, std::uint32_t aTiles, bool aSrgb) {
+		auto const cooked = rvo::cooked_path(aSource, fmt::format(".{}{}.rvovt", aTiles, aSrgb ? "" : ".linear"));
+
+		if (!rvo::is_cooked_up_to_date(aSource, cooked) && !rvo::cook_virtual_texture(aSource, cooked, aTiles, aSrgb)) {
+			return nullptr;
+		}
+
+		auto optHeader = rvo::read_virtual_texture_header(cooked);
+		if (!optHeader) return nullptr;
+
+		// The id is written into the feedback, it has to fit its bits
+		auto it = std::ranges::find_if(mTextures, [](std::weak_ptr<VirtualTexture> const& aTexture) { return aTexture.expired(); });
+		if (it == mTextures.end()) {
+			spdlog::error("More than {} virtual textures are alive, `{}` is not loaded", kMaxTextures, aSource.string());
+			return nullptr;
+		}
+
+		auto texture = std::make_shared<VirtualTexture>(cooked, *optHeader, static_cast<std::uint32_t>(it - mTextures.begin()));
+		*it = texture;
+		return texture;
+	}
+
+	bool VirtualTextureSystem::active() const noexcept {
+		return std::ranges::any_of(mTextures, [](std::weak_ptr<VirtualTexture> const& aTexture) { return !aTexture.expired(); });
+	}
+
+	void VirtualTextureSystem::begin_frame(glm::ivec2 aTargetSize) {
+		if (!active()) return;
+
+		glm::ivec2 const size = (aTargetSize + (kFeedbackScale - 1)) / kFeedbackScale;
+
+		if (size != mFeedbackSize) {
+			mFeedbackSize = size;
+			mFeedback = { {
+					.levels = 1,
+					.internalFormat = GL_R32UI,
+					.width = size.x,
+					.height = size.y,
+					.minFilter = GL_NEAREST,
+					.magFilter = GL_NEAREST,
+					.wrap = GL_CLAMP_TO_EDGE,
+					.anisotropy = 1.0f,
+				} };
+		}
+
+		glClearTexImage(mFeedback.handle(), 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+		glBindImageTexture(0, mFeedback.handle(), 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32UI);
+	}
+
+	void VirtualTextureSystem::bind(VirtualTexture const& aTexture, ShaderProgram& aProgram) const {
+		aTexture.mPageTable.bind(1);
+		aTexture.mAtlas.bind(2);
+
+		aProgram.push_1i("uVirtualPages"_u, static_cast<int>(aTexture.mHeader.pages));
+		aProgram.push_1i("uVirtualLevels"_u, static_cast<int>(aTexture.mHeader.levels));
+		aProgram.push_1i("uVirtualAtlasPages"_u, static_cast<int>(VirtualTexture::kAtlasPages));
+		aProgram.push_1i("uVirtualId"_u, static_cast<int>(aTexture.mId));
+		aProgram.push_1i("uVirtualFeedbackOffset"_u, static_cast<int>(mFrame % (kFeedbackScale * kFeedbackScale)));
+	}
+
+	void VirtualTextureSystem::end_frame() {
+		if (!active()) return;
+
+		// Pages stay resident for at least a full rotation of the feedback pixels, plus the readback latency
+		constexpr std::uint64_t kMinimumAge = kFeedbackScale * kFeedbackScale + 2;
+		std::uint64_t const oldestEvictable = mFrame > kMinimumAge ? mFrame - kMinimumAge : 0;
+
+		std::vector<std::unique_ptr<Job>> finished;
+		{
+			std::scoped_lock lock(mMutex);
+			while (!mCompleted.empty() && finished.size() < kMaxUploadsPerFrame) {
+				finished.push_back(std::move(mCompleted.front()));
+				mCompleted.pop_front();
+			}
+		}
+
+		for (auto& job : finished) {
+			--mInFlight;
+
+			auto texture = job->texture.lock();
+			if (!texture) continue;
+
+			texture->mLoading.erase(job->page);
+
+			if (!job->success) {
+				spdlog::warn("Failed to read page {} of `{}`", job->page, job->path.string());
+				continue;
+			}
+
+			// A full cache drops the page, feedback asks for it again once something can be evicted
+			if (auto slot = texture->allocate(oldestEvictable)) {
+				texture->upload(job->page, *slot, job->tile, mFrame);
+			}
+		}
+
+		for (Readback& readback : mReadbacks) {
+			if (!readback.fence) continue;
+
+			GLenum const status = glClientWaitSync(readback.fence, 0, 0);
+			if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) continue;
+
+			glDeleteSync(readback.fence);
+			readback.fence = nullptr;
+
+			std::size_t const count = static_cast<std::size_t>(readback.size.x) * readback.size.y;
+			auto const* feedback = static_cast<std::uint32_t const*>(glMapNamedBufferRange(readback.buffer.handle(), 0, count * sizeof(std::uint32_t), GL_MAP_READ_BIT));
+			process_feedback({ feedback, count });
+			glUnmapNamedBuffer(readback.buffer.handle());
+		}
+
+		// Read this frame's feedback back without stalling, skipped while both buffers are in flight
+		Readback& readback = mReadbacks[mReadbackIndex];
+		if (!readback.fence) {
+			std::size_t const bytes = static_cast<std::size_t>(mFeedbackSize.x) * mFeedbackSize.y * sizeof(std::uint32_t);
+
+			if (readback.size != mFeedbackSize) {
+				readback.size = mFeedbackSize;
+				readback.buffer = { {
+						.data = std::span(static_cast<std::byte const*>(nullptr), bytes),
+						.flags = GL_MAP_READ_BIT | GL_CLIENT_STORAGE_BIT,
+					} };
+			}
+
+			glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer.handle());
+			glGetTextureImage(mFeedback.handle(), 0, GL_RED_INTEGER, GL_UNSIGNED_INT, static_cast<GLsizei>(bytes), nullptr);
+			glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+			readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+			mReadbackIndex = (mReadbackIndex + 1) % mReadbacks.size();
+		}
+
+		++mFrame;
+	}
+
+	void VirtualTextureSystem::process_feedback(std::span<std::uint32_t const> aFeedback) {
+		std::unordered_set<std::uint32_t> requests;
+		for (std::uint32_t value : aFeedback) {
+			if (value & kFeedbackValid) requests.insert(value & ~kFeedbackValid);
+		}
+
+		struct Missing final {
+			VirtualTexture* texture;
+			std::uint32_t page;
+		};
+
+		std::vector<Missing> missing;
+		std::vector<std::shared_ptr<VirtualTexture>> alive;
+
+		for (std::uint32_t request : requests) {
+			auto texture = mTextures[request >> kFeedbackIdShift].lock();
+			if (!texture) continue;
+
+			std::uint32_t const page = request & ((1u << kFeedbackIdShift) - 1);
+			std::uint32_t const level = VirtualTexture::page_level(page);
+
+			// Stale texels may still name a texture that died and had its id reused
+			bool const valid = level < texture->mHeader.levels && VirtualTexture::page_x(page) < texture->mHeader.pages_at(level) && VirtualTexture::page_y(page) < texture->mHeader.pages_at(level);
+			if (!valid) continue;
+
+			// Ancestors stay in use too, sampling falls back to them while finer pages load
+			for (std::uint32_t ancestor = level; ancestor < texture->mHeader.levels; ++ancestor) {
+				std::uint32_t const shift = ancestor - level;
+				std::uint32_t const parent = VirtualTexture::make_page(ancestor, VirtualTexture::page_x(page) >> shift, VirtualTexture::page_y(page) >> shift);
+
+				if (texture->touch(parent, mFrame) || texture->mLoading.contains(parent)) continue;
+
+				texture->mLoading.insert(parent);
+				missing.push_back({ texture.get(), parent });
+			}
+
+			alive.push_back(std::move(texture));
+		}
+
+		// Coarse pages first, they cover the most screen and unblock the finer ones
+		std::ranges::sort(missing, std::greater{}, [](Missing const& aMissing) { return VirtualTexture::page_level(aMissing.page); });
+
+		std::size_t issued = 0;
+
+		{
+			std::scoped_lock lock(mMutex);
+
+			for (Missing const& request : missing) {
+				if (mInFlight >= kMaxPendingReads) {
+					// Forget the rest, they are requested again by later feedback
+					request.texture->mLoading.erase(request.page);
+					continue;
+				}
+
+				VirtualTextureHeader const& header = request.texture->mHeader;
+				std::uint32_t const page = request.page;
+
+				mPending.push_back(std::make_unique<Job>(Job{
+						.texture = mTextures[request.texture->mId],
+						.path = request.texture->mPath,
+						.page = page,
+						.offset = header.tile_offset(VirtualTexture::page_level(page), VirtualTexture::page_x(page), VirtualTexture::page_y(page)),
+						.tile = std::vector<std::byte>(header.tileBytes),
+					}));
+
+				++mInFlight;
+				++issued;
+			}
+		}
+
+		if (issued > 0) mCondition.notify_one();
+	}
+
+	void VirtualTextureSystem::worker(std::stop_token aStopToken) {
+		rvo::BatchFileReader reader;
+
+		while (true) {
+			std::vector<std::unique_ptr<Job>> jobs;
+
+			// All pages requested so far go out as one batch
+			{
+				std::unique_lock lock(mMutex);
+				if (!mCondition.wait(lock, aStopToken, [this] { return !mPending.empty(); })) return;
+
+				jobs.assign(std::make_move_iterator(mPending.begin()), std::make_move_iterator(mPending.end()));
+				mPending.clear();
+			}
+
+			std::vector<rvo::FileRead> reads;
+			reads.reserve(jobs.size());
+			for (auto& job : jobs) reads.push_back({ .path = job->path, .offset = job->offset, .destination = job->tile });
+
+			rvo::vfs::read_ranges(reads, reader);
+
+			std::scoped_lock lock(mMutex);
+			for (std::size_t i = 0; i < jobs.size(); ++i) {
+				jobs[i]->success = reads[i].success;
+				mCompleted.push_back(std::move(jobs[i]));
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "rvo_gfx.hpp"
+#include "gfx/rvo_virtual_texture_cook.hpp"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace rvo {
+	// Page table and page cache of one virtual texture, residency is driven by `VirtualTextureSystem`
+	class VirtualTexture final {
+	public:
+		// Per side, the cache holds kAtlasPages² pages no matter how large the virtual texture is
+		static constexpr std::uint32_t kAtlasPages = 32;
+
+		// Packed page coordinate, also the low bits of a feedback texel. See shaders/include/virtual_texture.glsl
+		static constexpr std::uint32_t make_page(std::uint32_t aLevel, std::uint32_t aX, std::uint32_t aY) noexcept { return aX | aY << 11 | aLevel << 22; }
+		static constexpr std::uint32_t page_x(std::uint32_t aPage) noexcept { return aPage & 0x7FF; }
+		static constexpr std::uint32_t page_y(std::uint32_t aPage) noexcept { return aPage >> 11 & 0x7FF; }
+		static constexpr std::uint32_t page_level(std::uint32_t aPage) noexcept { return aPage >> 22 & 0xF; }
+
+		// Uploads the single page of the last level, it stays resident so sampling always has a fallback
+		VirtualTexture(std::filesystem::path aPath, VirtualTextureHeader const& aHeader, std::uint32_t aId);
+
+		VirtualTextureHeader const& header() const noexcept { return mHeader; }
+		std::filesystem::path const& path() const noexcept { return mPath; }
+		std::uint32_t id() const noexcept { return mId; }
+		std::size_t resident_pages() const noexcept { return mResident.size(); }
+	private:
+		friend class VirtualTextureSystem;
+
+		struct Slot final {
+			std::uint32_t page;
+			std::uint64_t lastUsedFrame = 0;
+			bool used = false;
+			bool pinned = false;
+		};
+
+		// Marks the page as used this frame, false when it is not resident
+		bool touch(std::uint32_t aPage, std::uint64_t aFrame);
+		// Frees a slot if needed by evicting the page unused for the longest, but never one used since aOldestEvictable
+		std::optional<std::size_t> allocate(std::uint64_t aOldestEvictable);
+		void upload(std::uint32_t aPage, std::size_t aSlot, std::span<std::byte const> aTile, std::uint64_t aFrame);
+		void write_page_table(std::uint32_t aPage, std::array<std::uint8_t, 4> const& aEntry) const;
+
+		std::filesystem::path mPath;
+		VirtualTextureHeader mHeader;
+		std::uint32_t mId;
+
+		Texture mAtlas;
+		Texture mPageTable; // One level per virtual level, rgba8ui: atlas x, atlas y, unused, resident
+		std::vector<Slot> mSlots;
+		std::unordered_map<std::uint32_t, std::size_t> mResident; // Page to slot
+		std::unordered_set<std::uint32_t> mLoading;
+	};
+
+	// Reads the feedback written by virtual textured surfaces and streams the pages they asked for
+	class VirtualTextureSystem final {
+	public:
+		// One pixel out of each kFeedbackScale² block writes feedback per frame, rotating through all of them
+		static constexpr int kFeedbackScale = 8;
+		static constexpr std::size_t kMaxTextures = 32;
+		static constexpr std::size_t kMaxUploadsPerFrame = 16;
+		static constexpr std::size_t kMaxPendingReads = 64;
+
+		VirtualTextureSystem();
+		VirtualTextureSystem(VirtualTextureSystem const&) = delete;
+		VirtualTextureSystem& operator=(VirtualTextureSystem const&) = delete;
+		~VirtualTextureSystem() noexcept;
+
+		// Cooks aSource repeated aTiles times when needed, nullptr on failure
+		std::shared_ptr<VirtualTexture> load(std::filesystem::path const& aSource, std::uint32_t aTiles, bool aSrgb = true);
+
+		// Clears and binds the feedback image, call before the geometry pass
+		void begin_frame(glm::ivec2 aTargetSize);
+		// Binds aTexture to units 1 and 2 and sets the uniforms of shaders/include/virtual_texture.glsl
+		void bind(VirtualTexture const& aTexture, ShaderProgram& aProgram) const;
+		// Uploads finished reads, consumes feedback from earlier frames and starts reading back this one
+		void end_frame();
+	private:
+		struct Job final {
+			std::weak_ptr<VirtualTexture> texture;
+			std::filesystem::path path;
+			std::uint32_t page;
+			std::size_t offset;
+			std::vector<std::byte> tile;
+			bool success = false;
+		};
+
+		struct Readback final {
+			Buffer buffer;
+			glm::ivec2 size{};
+			GLsync fence = nullptr;
+		};
+
+		void worker(std::stop_token aStopToken);
+		void process_feedback(std::span<std::uint32_t const> aFeedback);
+		bool active() const noexcept;
+
+		std::array<std::weak_ptr<VirtualTexture>, kMaxTextures> mTextures;
+		std::uint64_t mFrame = 0;
+
+		Texture mFeedback;
+		glm::ivec2 mFeedbackSize{};
+		std::array<Readback, 2> mReadbacks;
+		std::size_t mReadbackIndex = 0;
+
+		std::mutex mMutex;
+		std::condition_variable_any mCondition;
+		std::deque<std::unique_ptr<Job>> mPending;
+		std::deque<std::unique_ptr<Job>> mCompleted;
+		std::size_t mInFlight = 0;
+
+		// Last so the worker is joined before anything it touches is destroyed
+		std::jthread mWorker;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,301 @@
+#include "rvo_world.hpp"
+
+#include "rvo_components.hpp"
+#include "rvo_vfs.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <utility>
+
+namespace rvo {
+	namespace {
+		std::filesystem::path cell_path(std::filesystem::path const& aDirectory, glm::ivec2 aCoord) {
+			return aDirectory / fmt::format("cell_{}_{}.rvoscene", aCoord.x, aCoord.y);
+		}
+
+		// Lights reach everything and large meshes like the terrain would pop in and out with a single cell
+		bool is_global(entt::registry const& aRegistry, entt::entity aEntity, GameObject const& aGameObject, float aCellSize) {
+			if (aRegistry.all_of<DirectionalLight>(aEntity)) return true;
+
+			Mesh const* mesh = nullptr;
+			if (auto* meshRenderer = aRegistry.try_get<MeshRenderer>(aEntity)) mesh = meshRenderer->mMesh.get();
+			else if (auto* instance = aRegistry.try_get<PrefabInstance>(aEntity)) mesh = instance->mPrefab->mMesh.get();
+			if (!mesh) return false;
+
+			glm::vec3 const scale = glm::abs(aGameObject.mTransform.scale);
+			return mesh->bounding_sphere().w * glm::max(scale.x, glm::max(scale.y, scale.z)) > aCellSize * 0.5f;
+		}
+
+		void destroy_instance(entt::registry& aRegistry, SceneInstance const& aInstance) {
+			// Entities may have been deleted in the editor since
+			for (entt::entity entity : aInstance.entities) {
+				if (aRegistry.valid(entity)) aRegistry.destroy(entity);
+			}
+		}
+	}
+
+	bool save_world(std::filesystem::path const& aDirectory, entt::registry const& aRegistry, AssetManager const& aAssetManager, float aCellSize) {
+		if (!(aCellSize > 0.0f)) {
+			spdlog::error("World cell size must be positive");
+			return false;
+		}
+
+		std::vector<entt::entity> global;
+		std::map<std::pair<int, int>, std::vector<entt::entity>> cells;
+
+		for (entt::entity entity : aRegistry.view<GameObject const>()) {
+			GameObject const& gameObject = aRegistry.get<GameObject>(entity);
+
+			if (is_global(aRegistry, entity, gameObject, aCellSize)) {
+				global.push_back(entity);
+				continue;
+			}
+
+			glm::ivec2 const coord(glm::floor(glm::vec2(gameObject.mTransform.position.x, gameObject.mTransform.position.z) / aCellSize));
+			cells[{ coord.x, coord.y }].push_back(entity);
+		}
+
+		// Cells of an earlier save are not in the new manifest, remove them so the directory only holds this world
+		std::error_code error;
+		std::filesystem::create_directories(aDirectory, error);
+		for (auto const& entry : std::filesystem::directory_iterator(aDirectory, error)) {
+			if (entry.path().extension() == ".rvoscene") std::filesystem::remove(entry.path(), error);
+		}
+
+		if (!write_scene(aDirectory / "global.rvoscene", aRegistry, global, aAssetManager)) return false;
+
+		std::vector<glm::ivec2> coords;
+		for (auto const& [coord, entities] : cells) {
+			coords.emplace_back(coord.first, coord.second);
+			if (!write_scene(cell_path(aDirectory, coords.back()), aRegistry, entities, aAssetManager)) return false;
+		}
+
+		// The manifest goes last, its time is what marks the world as up to date
+		WorldFileHeader header;
+		header.cellSize = aCellSize;
+		header.cellCount = static_cast<std::uint32_t>(coords.size());
+
+		std::filesystem::path const manifest = aDirectory / "world.rvoworld";
+		std::ofstream stream(manifest, std::ios::binary);
+		if (!stream) {
+			spdlog::error("Failed to open `{}` for writing", manifest.string());
+			return false;
+		}
+
+		stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+		stream.write(reinterpret_cast<char const*>(coords.data()), coords.size() * sizeof(glm::ivec2));
+
+		spdlog::info("Saved world `{}` ({} cells, {} global entities)", aDirectory.string(), coords.size(), global.size());
+		return static_cast<bool>(stream);
+	}
+
+	WorldStreamer::WorldStreamer() {
+		mWorker = std::jthread([this](std::stop_token aStopToken) { worker(aStopToken); });
+	}
+
+	WorldStreamer::~WorldStreamer() noexcept {
+		mWorker = {};
+	}
+
+	bool WorldStreamer::open(std::filesystem::path const& aDirectory, entt::registry& aRegistry, AssetManager& aAssetManager) {
+		close();
+
+		std::filesystem::path const manifest = aDirectory / "world.rvoworld";
+		auto optFile = vfs::view(manifest);
+		if (!optFile) return false;
+
+		std::span<std::byte const> const bytes = optFile->bytes();
+
+		WorldFileHeader header;
+		if (bytes.size() >= sizeof(header)) std::memcpy(&header, bytes.data(), sizeof(header));
+
+		bool const valid = bytes.size() >= sizeof(header)
+			&& std::memcmp(header.magic, WorldFileHeader().magic, sizeof(header.magic)) == 0
+			&& header.cellSize > 0.0f
+			&& bytes.size() == sizeof(header) + std::size_t(header.cellCount) * sizeof(glm::ivec2);
+
+		if (!valid) {
+			spdlog::error("`{}` is not a world", manifest.string());
+			return false;
+		}
+
+		auto optGlobal = read_scene(aDirectory / "global.rvoscene");
+		if (!optGlobal) return false;
+
+		mDirectory = aDirectory;
+		mRegistry = &aRegistry;
+		mAssetManager = &aAssetManager;
+		mCellSize = header.cellSize;
+		mGlobal = instantiate_scene(std::move(*optGlobal), aRegistry, aAssetManager);
+
+		std::vector<glm::ivec2> coords(header.cellCount);
+		std::memcpy(coords.data(), bytes.data() + sizeof(header), coords.size() * sizeof(glm::ivec2));
+		for (glm::ivec2 coord : coords) mCells.emplace(key_of(coord), Cell{ .coord = coord });
+
+		spdlog::info("Opened world `{}` ({} cells, {} global entities)", aDirectory.string(), mCells.size(), mGlobal.entities.size());
+		return true;
+	}
+
+	void WorldStreamer::close() {
+		if (!mRegistry) return;
+
+		{
+			std::scoped_lock lock(mMutex);
+			mPending.clear();
+			mCompleted.clear();
+		}
+
+		// A read still running on the worker finishes with the old generation and is dropped in update
+		++mGeneration;
+
+		for (std::uint64_t key : mActive) {
+			if (auto& instance = mCells.at(key).instance) destroy_instance(*mRegistry, *instance);
+		}
+		destroy_instance(*mRegistry, mGlobal);
+
+		mGlobal = {};
+		mCells.clear();
+		mActive.clear();
+		mLoadedCells = 0;
+		mFailedCells = 0;
+		mRegistry = nullptr;
+		mAssetManager = nullptr;
+	}
+
+	void WorldStreamer::update(glm::vec3 const& aCamera) {
+		if (!mRegistry) return;
+
+		glm::vec2 const camera(aCamera.x, aCamera.z);
+
+		// Finished reads, only a few cells are instantiated per update and the rest wait for the next one
+		std::deque<std::unique_ptr<Job>> finished;
+		{
+			std::scoped_lock lock(mMutex);
+			finished.swap(mCompleted);
+		}
+
+		std::size_t instantiated = 0;
+		while (!finished.empty()) {
+			Job& job = *finished.front();
+
+			auto it = mCells.find(job.key);
+			if (job.generation != mGeneration || it == mCells.end()) {
+				finished.pop_front();
+				continue;
+			}
+
+			Cell& cell = it->second;
+			if (!job.data) {
+				// read_scene logged why, once is enough
+				cell.failed = true;
+				++mFailedCells;
+			}
+
+			if (!cell.wanted || !job.data) {
+				cell.loading = false;
+				finished.pop_front();
+				continue;
+			}
+
+			if (instantiated == kMaxInstancesPerUpdate) break;
+
+			cell.instance = instantiate_scene(std::move(*job.data), *mRegistry, *mAssetManager);
+			cell.loading = false;
+			++mLoadedCells;
+			++instantiated;
+			finished.pop_front();
+		}
+
+		if (!finished.empty()) {
+			std::scoped_lock lock(mMutex);
+			mCompleted.insert(mCompleted.begin(), std::make_move_iterator(finished.begin()), std::make_move_iterator(finished.end()));
+		}
+
+		// Unloading uses the larger radius so a camera on a cell border does not load and unload it every frame
+		float const unloadRadius = glm::max(mUnloadRadius, mLoadRadius);
+		for (std::uint64_t key : mActive) {
+			Cell& cell = mCells.at(key);
+			if (distance_to(cell, camera) <= unloadRadius) continue;
+
+			cell.wanted = false;
+			if (cell.instance) unload(cell);
+		}
+
+		std::erase_if(mActive, [this](std::uint64_t aKey) {
+			Cell const& cell = mCells.at(aKey);
+			return !cell.instance && !cell.loading;
+		});
+
+		// Only the cells under the load radius are looked up, not every cell of the world
+		glm::ivec2 const first(glm::floor((camera - mLoadRadius) / mCellSize));
+		glm::ivec2 const last(glm::floor((camera + mLoadRadius) / mCellSize));
+
+		std::size_t requested = 0;
+		for (int y = first.y; y <= last.y; ++y) {
+			for (int x = first.x; x <= last.x; ++x) {
+				auto it = mCells.find(key_of({ x, y }));
+				if (it == mCells.end()) continue;
+
+				Cell& cell = it->second;
+				if (distance_to(cell, camera) > mLoadRadius) continue;
+
+				cell.wanted = true;
+				if (cell.instance || cell.loading || cell.failed) continue;
+
+				cell.loading = true;
+				mActive.push_back(it->first);
+
+				std::scoped_lock lock(mMutex);
+				mPending.push_back(std::make_unique<Job>(Job{
+					.path = cell_path(mDirectory, cell.coord),
+					.key = it->first,
+					.generation = mGeneration,
+				}));
+				++requested;
+			}
+		}
+
+		if (requested > 0) mCondition.notify_one();
+	}
+
+	std::uint64_t WorldStreamer::key_of(glm::ivec2 aCoord) noexcept {
+		return std::uint64_t(static_cast<std::uint32_t>(aCoord.x)) << 32 | static_cast<std::uint32_t>(aCoord.y);
+	}
+
+	float WorldStreamer::distance_to(Cell const& aCell, glm::vec2 aCamera) const noexcept {
+		glm::vec2 const min = glm::vec2(aCell.coord) * mCellSize;
+		return glm::distance(aCamera, glm::clamp(aCamera, min, min + mCellSize));
+	}
+
+	void WorldStreamer::unload(Cell& aCell) {
+		destroy_instance(*mRegistry, *aCell.instance);
+
+		// The last references to assets only this cell used go here
+		aCell.instance.reset();
+		--mLoadedCells;
+	}
+
+	void WorldStreamer::worker(std::stop_token aStopToken) {
+		while (true) {
+			std::unique_ptr<Job> job;
+
+			{
+				std::unique_lock lock(mMutex);
+				if (!mCondition.wait(lock, aStopToken, [this] { return !mPending.empty(); })) return;
+
+				job = std::move(mPending.front());
+				mPending.pop_front();
+			}
+
+			job->data = read_scene(job->path);
+
+			std::scoped_lock lock(mMutex);
+			mCompleted.push_back(std::move(job));
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "rvo_asset_manager.hpp"
+#include "rvo_scene.hpp"
+
+#include <entt/entt.hpp>
+
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace rvo {
+	// Header of `world.rvoworld`, followed by one ivec2 per cell
+	// Every cell is `cell_{x}_{z}.rvoscene` next to it, `global.rvoscene` holds what is always loaded
+	struct WorldFileHeader final {
+		char magic[4] = { 'R', 'W', 'D', '1' };
+		float cellSize = 0.0f;
+		std::uint32_t cellCount = 0;
+	};
+
+	static_assert(sizeof(WorldFileHeader) == 12);
+
+	// Splits every GameObject into a grid of aCellSize cells on the xz plane by position
+	// Lights and anything whose bounds reach past half a cell go to the global cell instead
+	bool save_world(std::filesystem::path const& aDirectory, entt::registry const& aRegistry, AssetManager const& aAssetManager, float aCellSize);
+
+	// Keeps the cells of a saved world loaded while they are near the camera
+	// Cells are read on a worker thread and instantiated on the main thread, their assets are pinned only while they are loaded
+	class WorldStreamer final {
+	public:
+		// Cells made per update at most, instantiating also loads their assets
+		static constexpr std::size_t kMaxInstancesPerUpdate = 2;
+
+		WorldStreamer();
+		WorldStreamer(WorldStreamer const&) = delete;
+		WorldStreamer& operator=(WorldStreamer const&) = delete;
+		~WorldStreamer() noexcept;
+
+		// Loads the global cell right away, the others follow from update
+		bool open(std::filesystem::path const& aDirectory, entt::registry& aRegistry, AssetManager& aAssetManager);
+		// Destroys every entity the world made and drops reads still in flight
+		void close();
+		bool is_open() const noexcept { return mRegistry != nullptr; }
+
+		// Cells closer than mLoadRadius are requested, loaded cells stay until they are further than mUnloadRadius
+		void update(glm::vec3 const& aCamera);
+
+		std::size_t cells() const noexcept { return mCells.size(); }
+		std::size_t loaded_cells() const noexcept { return mLoadedCells; }
+		std::size_t loading_cells() const noexcept { return mActive.size() - mLoadedCells; }
+		std::size_t failed_cells() const noexcept { return mFailedCells; }
+
+		float mLoadRadius = 96.0f;
+		float mUnloadRadius = 128.0f;
+	private:
+		struct Cell final {
+			glm::ivec2 coord;
+			std::optional<SceneInstance> instance;
+			bool loading = false;
+			bool wanted = false; // Cleared when the camera moves away while loading, the read is thrown away then
+			bool failed = false; // The file is missing or invalid, it is not read again until the world is opened again
+		};
+
+		struct Job final {
+			std::filesystem::path path;
+			std::uint64_t key;
+			std::uint64_t generation;
+			std::optional<SceneData> data;
+		};
+
+		static std::uint64_t key_of(glm::ivec2 aCoord) noexcept;
+		float distance_to(Cell const& aCell, glm::vec2 aCamera) const noexcept;
+		void unload(Cell& aCell);
+		void worker(std::stop_token aStopToken);
+
+		std::filesystem::path mDirectory;
+		entt::registry* mRegistry = nullptr;
+		AssetManager* mAssetManager = nullptr;
+		float mCellSize = 0.0f;
+
+		SceneInstance mGlobal;
+		std::unordered_map<std::uint64_t, Cell> mCells;
+		std::vector<std::uint64_t> mActive; // Cells loaded or loading
+		std::size_t mLoadedCells = 0;
+		std::size_t mFailedCells = 0;
+		std::uint64_t mGeneration = 0; // Bumped by close so reads of a previous world are dropped
+
+		std::mutex mMutex;
+		std::condition_variable_any mCondition;
+		std::deque<std::unique_ptr<Job>> mPending;
+		std::deque<std::unique_ptr<Job>> mCompleted;
+
+		// Last so the worker is joined before anything it touches is destroyed
+		std::jthread mWorker;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "rvo_utility.hpp"
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+	struct Instance final {
+		int id;
+		int runs = 0;
+	};
+
+	struct Type final {
+		std::vector<Instance> instances;
+		std::size_t cursor = 0;
+	};
+
+	int gFailures = 0;
+
+	void check(bool aCondition, char const* aWhat) {
+		if (aCondition) return;
+		std::printf("FAILED: %s\n", aWhat);
+		++gFailures;
+	}
+
+	Type make_type(int aFirstId, int aCount) {
+		Type type;
+		for (int i = 0; i < aCount; ++i) type.instances.push_back({ aFirstId + i });
+		return type;
+	}
+
+	// Two script types where the first has more instances than fit in one update's budget
+	void test_large_type_does_not_starve_the_next() {
+		std::vector<Type> types = { make_type(0, 10), make_type(100, 3) };
+		std::size_t typeCursor = 0;
+		constexpr std::size_t kBudget = 4;
+
+		auto visit = [](Type&, Instance& aInstance) { ++aInstance.runs; return true; };
+		auto out_of_budget = [&](std::size_t aVisited) { return aVisited >= kBudget; };
+
+		// 13 instances at 4 per update, the round completes in the fourth
+		for (int update = 0; update < 4; ++update) rvo::visit_round_robin(types, typeCursor, visit, out_of_budget);
+
+		for (Instance const& instance : types[0].instances) check(instance.runs == 1, "every instance of the large type ran once");
+		for (Instance const& instance : types[1].instances) check(instance.runs == 1, "every instance of the small type ran once");
+		check(typeCursor == 0, "the round completed");
+	}
+
+	void test_removed_instances_do_not_skip_others() {
+		std::vector<Type> types = { make_type(0, 6) };
+		std::size_t typeCursor = 0;
+
+		// Even ids finish on their first run and are removed
+		std::size_t const visited = rvo::visit_round_robin(types, typeCursor, [](Type&, Instance& aInstance) {
+			++aInstance.runs;
+			return aInstance.id % 2 != 0;
+		}, [](std::size_t) { return false; });
+
+		check(visited == 6, "every instance was visited once");
+		check(types[0].instances.size() == 3, "finished instances were removed");
+		for (Instance const& instance : types[0].instances) check(instance.id % 2 != 0 && instance.runs == 1, "remaining instances ran once");
+	}
+}
+
+int main() {
+	test_large_type_does_not_starve_the_next();
+	test_removed_instances_do_not_skip_others();
+
+	if (gFailures == 0) std::printf("All tests passed\n");
+	return gFailures == 0 ? 0 : 1;
+}
\ No newline at end of file
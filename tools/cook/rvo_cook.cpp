@@ -0,0 +1,349 @@
+// rvo-cook, converts everything under `working/` into the cooked forms the game loads
+// Usage: rvo-cook [--working <dir>] [--jobs <n>] [--force] [--pak <file>]
+
+#include "rvo_lua.hpp"
+#include "rvo_utility.hpp"
+#include "rvo_vfs.hpp"
+#include "rvo_pak.hpp"
+#include "gfx/rvo_texture_cook.hpp"
+#include "gfx/rvo_virtual_texture_cook.hpp"
+#include "gfx/rvo_mesh_cook.hpp"
+#include "gfx/rvo_shader_cook.hpp"
+
+#include <spdlog/spdlog.h>
+
+#include <lua.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace rvo {
+	namespace {
+		// Bump a version to recook everything of that kind after its output format or conversion changes
+		constexpr std::string_view kTextureVersion = "texture-1";
+		constexpr std::string_view kVirtualTextureVersion = "virtual-texture-1";
+		constexpr std::string_view kMeshVersion = "mesh-1";
+		constexpr std::string_view kShaderVersion = "shader-2";
+
+		constexpr char const* kManifestPath = "cooked/manifest.txt";
+
+		struct Job final {
+			std::string version;
+			std::filesystem::path source;
+			std::filesystem::path output;
+			// Returns every file the output was built from, the source included, empty on failure
+			std::function<std::vector<std::filesystem::path>()> cook;
+		};
+
+		// What an output was last built from, `output version (input hash)*` per line
+		struct ManifestEntry final {
+			std::string version;
+			std::vector<std::pair<std::string, std::uint64_t>> inputs;
+		};
+
+		using Manifest = std::unordered_map<std::string, ManifestEntry>;
+
+		Manifest read_manifest() {
+			Manifest manifest;
+
+			auto optText = read_file_string(kManifestPath);
+			if (!optText) return manifest;
+
+			std::istringstream stream(*optText);
+			for (std::string line; std::getline(stream, line);) {
+				std::istringstream fields(line);
+				std::string output;
+				ManifestEntry entry;
+				if (!(fields >> output >> entry.version)) continue;
+
+				std::string input, hash;
+				while (fields >> input >> hash) {
+					std::uint64_t value = 0;
+					std::from_chars(hash.data(), hash.data() + hash.size(), value, 16);
+					entry.inputs.emplace_back(std::move(input), value);
+				}
+
+				manifest[std::move(output)] = std::move(entry);
+			}
+
+			return manifest;
+		}
+
+		bool write_manifest(Manifest const& aManifest) {
+			std::vector<std::string const*> outputs;
+			for (auto const& [output, entry] : aManifest) outputs.push_back(&output);
+			std::ranges::sort(outputs, {}, [](std::string const* aOutput) { return *aOutput; });
+
+			std::ofstream stream(kManifestPath, std::ios::binary);
+			for (std::string const* output : outputs) {
+				ManifestEntry const& entry = aManifest.at(*output);
+				stream << *output << ' ' << entry.version;
+				for (auto const& [input, hash] : entry.inputs) stream << ' ' << input << ' ' << std::hex << hash << std::dec;
+				stream << '\n';
+			}
+
+			return static_cast<bool>(stream);
+		}
+
+		// Content hashes, shared includes are hashed once per run
+		class HashCache final {
+		public:
+			std::optional<std::uint64_t> get(std::filesystem::path const& aPath) {
+				std::string const key = pak_name(aPath);
+
+				{
+					std::scoped_lock lock(mMutex);
+					if (auto it = mHashes.find(key); it != mHashes.end()) return it->second;
+				}
+
+				MappedFile file(aPath);
+				if (!file) return std::nullopt;
+
+				std::uint64_t const hash = fnv1a(file.bytes());
+
+				std::scoped_lock lock(mMutex);
+				return mHashes.emplace(key, hash).first->second;
+			}
+		private:
+			std::mutex mMutex;
+			std::unordered_map<std::string, std::uint64_t> mHashes;
+		};
+
+		bool is_image(std::filesystem::path const& aPath) {
+			static std::unordered_set<std::string> const kExtensions = { ".png", ".jpg", ".jpeg", ".tga", ".bmp" };
+			return kExtensions.contains(aPath.extension().string());
+		}
+
+		// Virtual textures are only known through the materials that use them
+		// Materials run in the same sandbox the game gives them, the stack is restored to top on every path
+		void discover_virtual_textures(lua_State* L, std::filesystem::path const& aMaterial, std::vector<Job>& aJobs) {
+			int const top = lua_gettop(L);
+
+			if (!run_lua_file(L, aMaterial, 1)) {
+				spdlog::warn("Failed to evaluate material `{}`: {}", aMaterial.generic_string(), lua_tostring(L, -1));
+				lua_settop(L, top);
+				return;
+			}
+
+			if (lua_istable(L, -1) && lua_getfield(L, -1, "virtualTexture") == LUA_TTABLE) {
+				lua_getfield(L, -1, "source");
+				lua_getfield(L, -2, "tiles");
+
+				if (lua_isstring(L, -2)) {
+					std::filesystem::path const source = lua_tostring(L, -2);
+					lua_Integer const tiles = lua_isinteger(L, -1) ? lua_tointeger(L, -1) : 1;
+					std::uint32_t const repeat = static_cast<std::uint32_t>(tiles > 0 ? tiles : 1);
+					auto const output = cooked_path(source, fmt::format(".{}.rvovt", repeat));
+
+					bool const known = std::ranges::any_of(aJobs, [&](Job const& aJob) { return aJob.output == output; });
+					if (!known) {
+						aJobs.push_back({ std::string(kVirtualTextureVersion), source, output, [=] {
+							return cook_virtual_texture(source, output, repeat, true) ? std::vector{ source } : std::vector<std::filesystem::path>();
+						} });
+					}
+				}
+			}
+
+			lua_settop(L, top);
+		}
+
+		std::vector<Job> discover_jobs() {
+			std::vector<Job> jobs;
+			std::vector<std::filesystem::path> materials;
+
+			std::error_code error;
+			for (auto it = std::filesystem::recursive_directory_iterator(".", error); it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+				std::filesystem::path const path = std::filesystem::path(pak_name(it->path()));
+
+				if (it->is_directory() && path == "cooked") {
+					it.disable_recursion_pending();
+					continue;
+				}
+
+				if (!it->is_regular_file()) continue;
+
+				if (is_image(path)) {
+					auto const output = cooked_path(path, ".ktx2");
+					jobs.push_back({ std::string(kTextureVersion), path, output, [=] {
+						return cook_texture(path, output, true) ? std::vector{ path } : std::vector<std::filesystem::path>();
+					} });
+				}
+				else if (path.extension() == ".ply") {
+					auto const output = cooked_path(path, ".rvomesh");
+					jobs.push_back({ std::string(kMeshVersion), path, output, [=] {
+						return cook_mesh(path, output) ? std::vector{ path } : std::vector<std::filesystem::path>();
+					} });
+				}
+				else if (path.extension() == ".glsl" && !pak_name(path).starts_with("shaders/include/")) {
+					auto const output = cooked_path(path, ".rvoshader");
+					jobs.push_back({ std::string(kShaderVersion), path, output, [=] {
+						auto optSource = preprocess_shader(path);
+						if (!optSource || !write_shader_source(output, *optSource)) return std::vector<std::filesystem::path>();
+
+						std::vector<std::filesystem::path> inputs = { path };
+						inputs.insert(inputs.end(), optSource->dependencies.begin(), optSource->dependencies.end());
+						return inputs;
+					} });
+				}
+				else if (path.extension() == ".lua" && pak_name(path).starts_with("materials/")) {
+					materials.push_back(path);
+				}
+			}
+
+			// A handful of files then thrown away
+			LuaState lua(LuaAllocation::kArena);
+			for (auto const& material : materials) discover_virtual_textures(lua.get(), material, jobs);
+
+			// Virtual textures take the longest, start them first so they overlap everything else
+			std::ranges::stable_sort(jobs, std::greater{}, [](Job const& aJob) { return aJob.version == kVirtualTextureVersion; });
+			return jobs;
+		}
+
+		// Lets the runtime's timestamp check accept an output whose inputs were touched but not changed
+		void touch_if_older(std::filesystem::path const& aOutput, std::vector<std::pair<std::string, std::uint64_t>> const& aInputs) {
+			std::error_code error;
+			auto const outputTime = std::filesystem::last_write_time(aOutput, error);
+			if (error) return;
+
+			for (auto const& [input, hash] : aInputs) {
+				if (std::filesystem::last_write_time(input, error) > outputTime && !error) {
+					std::filesystem::last_write_time(aOutput, std::filesystem::file_time_type::clock::now(), error);
+					return;
+				}
+			}
+		}
+
+		// Everything the game reads, sources that have a cooked form are left out
+		bool write_runtime_pak(std::filesystem::path const& aPak, std::vector<Job> const& aJobs) {
+			std::unordered_set<std::string> replaced;
+			for (Job const& job : aJobs) {
+				if (job.version == kTextureVersion || job.version == kMeshVersion) replaced.insert(pak_name(job.source));
+			}
+
+			std::vector<std::filesystem::path> files;
+			std::error_code error;
+			for (auto it = std::filesystem::recursive_directory_iterator(".", error); it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+				if (!it->is_regular_file()) continue;
+
+				std::string const name = pak_name(it->path());
+				bool const skip = replaced.contains(name)
+					|| name == kManifestPath
+					|| name == "log.txt"
+					|| it->path().extension() == ".rvopak";
+
+				if (!skip) files.emplace_back(name);
+			}
+
+			std::ranges::sort(files);
+			return write_pak(aPak, ".", files);
+		}
+	}
+}
+
+int main(int argc, char* argv[]) {
+	using namespace rvo;
+
+	std::filesystem::path working = ".";
+	std::filesystem::path pak;
+	unsigned jobCount = std::max(std::thread::hardware_concurrency(), 1u);
+	bool force = false;
+
+	for (int i = 1; i < argc; ++i) {
+		std::string_view const arg = argv[i];
+
+		if (arg == "--working" && i + 1 < argc) working = argv[++i];
+		else if (arg == "--pak" && i + 1 < argc) pak = std::filesystem::absolute(argv[++i]);
+		else if (arg == "--jobs" && i + 1 < argc) jobCount = std::max(std::atoi(argv[++i]), 1);
+		else if (arg == "--force") force = true;
+		else {
+			spdlog::error("Unknown argument `{}`", arg);
+			spdlog::info("Usage: rvo-cook [--working <dir>] [--jobs <n>] [--force] [--pak <file>]");
+			return 1;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::current_path(working, error);
+	if (error) {
+		spdlog::error("Cannot enter `{}`: {}", working.string(), error.message());
+		return 1;
+	}
+
+	auto const start = std::chrono::steady_clock::now();
+
+	std::vector<Job> const jobs = discover_jobs();
+	Manifest manifest = force ? Manifest() : read_manifest();
+	Manifest updated;
+
+	HashCache hashes;
+	std::mutex mutex;
+	std::atomic_size_t next = 0;
+	std::atomic_size_t cooked = 0, skipped = 0, failed = 0;
+
+	auto up_to_date = [&](Job const& aJob) {
+		auto it = manifest.find(pak_name(aJob.output));
+		if (it == manifest.end() || it->second.version != aJob.version || !std::filesystem::exists(aJob.output)) return false;
+
+		return std::ranges::all_of(it->second.inputs, [&](auto const& aInput) { return hashes.get(aInput.first) == aInput.second; });
+	};
+
+	auto worker = [&] {
+		for (std::size_t i; (i = next++) < jobs.size();) {
+			Job const& job = jobs[i];
+			std::string const output = pak_name(job.output);
+
+			if (up_to_date(job)) {
+				touch_if_older(job.output, manifest.at(output).inputs);
+
+				std::scoped_lock lock(mutex);
+				updated[output] = manifest.at(output);
+				++skipped;
+				continue;
+			}
+
+			std::vector<std::filesystem::path> const inputs = job.cook();
+			if (inputs.empty()) {
+				spdlog::error("Failed to cook `{}`", job.source.generic_string());
+				++failed;
+				continue;
+			}
+
+			ManifestEntry entry{ job.version };
+			for (auto const& input : inputs) {
+				if (auto hash = hashes.get(input)) entry.inputs.emplace_back(pak_name(input), *hash);
+			}
+
+			std::scoped_lock lock(mutex);
+			updated[output] = std::move(entry);
+			++cooked;
+		}
+	};
+
+	{
+		std::vector<std::jthread> threads;
+		for (unsigned i = 1; i < jobCount; ++i) threads.emplace_back(worker);
+		worker();
+	}
+
+	std::filesystem::create_directories("cooked", error);
+	if (!write_manifest(updated)) spdlog::error("Failed to write `{}`", kManifestPath);
+
+	auto const seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	spdlog::info("Cooked {}, up to date {}, failed {} in {:.2f}s on {} threads", cooked.load(), skipped.load(), failed.load(), seconds, jobCount);
+
+	if (!pak.empty() && !write_runtime_pak(pak, jobs)) return 1;
+	return failed ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+-- One row of pines along z, chunk.x picks the row
+return function(chunk)
+    local positions, scales = {}, {}
+
+    for z = 0, chunk.length - 1 do
+        local scaleFactor = math.random(80, 120) / 100.0
+
+        table.insert(positions, chunk.x * chunk.spacing - 100.0 + math.random(-5, 5))
+        table.insert(positions, 0.0)
+        table.insert(positions, z * chunk.spacing - 100.0 + math.random(-5, 5))
+        table.insert(scales, scaleFactor)
+    end
+
+    rvo.spawn_many("meshes/pine.ply", "materials/pine.lua", positions, scales, "Tree " .. chunk.x)
+end
\ No newline at end of file
@@ -0,0 +1,15 @@
+-- One column of minions, foxes and yeens alternate like a checkerboard
+return function(chunk)
+    local foxes, yeens = {}, {}
+
+    for z = 0, chunk.length - 1 do
+        local positions = (chunk.x + z) % 2 == 0 and foxes or yeens
+
+        table.insert(positions, chunk.x * 3.0 - 30.0)
+        table.insert(positions, 0.0)
+        table.insert(positions, z * 6.0 - 30.0)
+    end
+
+    rvo.spawn_many("meshes/fox.ply", "materials/fox.lua", foxes, nil, "Fox " .. chunk.x, "scripts/hop.lua")
+    rvo.spawn_many("meshes/yeen.ply", "materials/yeen.lua", yeens, nil, "Yeen " .. chunk.x)
+end
\ No newline at end of file
@@ -1,4 +1,6 @@
 return {
     shaderProgram = "shaders/terrain.glsl",
+    keywords = { "NO_TILE" },
     texture = "textures/grass.png",
+    textureTiling = 100,
 }
\ No newline at end of file
@@ -0,0 +1,8 @@
+return {
+    shaderProgram = "shaders/terrain_virtual.glsl",
+    virtualTexture = {
+        source = "textures/grass.png",
+        -- Stand-in for a painted albedo, 32 * 256 texels gives a 64x64 page virtual texture
+        tiles = 32,
+    },
+}
\ No newline at end of file
@@ -1,99 +1,40 @@
-local sceneTable = {
-    {
-        GameObject = {
-            name = "Terrain",
-        },
-        MeshRenderer = {
-            mesh = "meshes/terrain.ply",
-            material = "materials/terrain.lua",
-        },
-    },
-    {
-        GameObject = {
-            name = "Blue Light",
-            transform = {
-                position = { -8.0, 5.0, -20.0 },
-            },
-        },
-        MeshRenderer = {
-            mesh = "meshes/cube.ply",
-            material = "materials/light_blue.lua",
-        },
-    },
-    {
-        GameObject = {
-            name = "Red Light",
-            transform = {
-                position = { -10.0, 2.0, 10.0 },
-            },
-        },
-        MeshRenderer = {
-            mesh = "meshes/cube.ply",
-            material = "materials/light_red.lua",
-        },
-    },
-    {
-        GameObject = {
-            name = "Green Light",
-            transform = {
-                position = { 30.0, 8.0, 2.0 },
-            },
-        },
-        MeshRenderer = {
-            mesh = "meshes/cube.ply",
-            material = "materials/light_green.lua",
-        },
-    },
+rvo.spawn{
+    name = "Terrain",
+    mesh = "meshes/terrain.ply",
+    material = "materials/terrain.lua",
 }
 
-local x, z
-
-for x = 0, 10 do
-    for z = 0, 10 do
-        local scaleFactor = math.random(80, 120) / 100.0
-         table.insert(sceneTable, {
-            GameObject = {
-                name = "Tree " .. x .. "_" .. z,
+rvo.spawn{
+    name = "Blue Light",
+    position = { -8.0, 5.0, -20.0 },
+    mesh = "meshes/cube.ply",
+    material = "materials/light_blue.lua",
+}
 
-                transform = {
-                    position = { x * 20.0 - 100.0 + math.random(-5, 5), 0.0, z * 20.0 - 100.0 + math.random(-5, 5)},
-                    scale = { scaleFactor, scaleFactor, scaleFactor }
-                },
-            },
-            MeshRenderer = {
-                mesh = "meshes/pine.ply",
-                material = "materials/pine.lua",
-            },
-        })
-    end
-end
+rvo.spawn{
+    name = "Red Light",
+    position = { -10.0, 2.0, 10.0 },
+    mesh = "meshes/cube.ply",
+    material = "materials/light_red.lua",
+}
 
-for x = 0, 20 do
-    for z = 0, 10 do
-        local mesh, material
+rvo.spawn{
+    name = "Green Light",
+    position = { 30.0, 8.0, 2.0 },
+    mesh = "meshes/cube.ply",
+    material = "materials/light_green.lua",
+}
 
-        if (x + z) % 2 == 0 then
-            mesh = "meshes/fox.ply"
-            material = "materials/fox.lua"
-        else
-            mesh = "meshes/yeen.ply"
-            material = "materials/yeen.lua"
-        end
+-- Every row and column is independent, so they are generated in parallel
+local rows, columns = {}, {}
 
-        table.insert(sceneTable, {
-            GameObject = {
-                name = "Minion " .. x .. "_" .. z,
+for x = 0, 10 do
+    table.insert(rows, { x = x, length = 11, spacing = 20.0 })
+end
 
-                transform = {
-                    position = { x * 3.0 - 30.0, 0.0, z * 6.0 - 30.0 },
-                },
-            },
-            MeshRenderer = {
-                mesh = mesh,
-                material = material,
-            },
-        })
-    end
+for x = 0, 20 do
+    table.insert(columns, { x = x, length = 11 })
 end
 
-return sceneTable
\ No newline at end of file
+rvo.generate("generators/forest.lua", rows, 1)
+rvo.generate("generators/minions.lua", columns, 2)
\ No newline at end of file
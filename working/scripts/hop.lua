@@ -0,0 +1,12 @@
+-- Hops in place, out of step with its neighbours
+return function(self, dt)
+    local ground = self.y
+    local phase = (self.x + self.z) * 0.5
+    local time = 0.0
+
+    while true do
+        time = time + dt
+        self.y = ground + math.abs(math.sin(time * 4.0 + phase)) * 0.25
+        dt = coroutine.yield()
+    end
+end
\ No newline at end of file
@@ -1,6 +1,8 @@
 #inject
 #include "fullscreen.vert.glsl"
 
+#pragma RVO_KEYWORDS REMOVE_NON_HDR
+
 #ifdef RVO_FRAG
 // This shader performs downsampling on a texture,
 // as taken from Call Of Duty method, presented at ACM Siggraph 2014.
@@ -64,7 +66,6 @@ void main(void) {
     vec3 m = texture(srcTexture, vec2(texCoord.x + x, texCoord.y - y)).rgb;
 
     if (uBasePass == 1) {
-        //#define REMOVE_NON_HDR
         #ifdef REMOVE_NON_HDR
         if (RGBToLuminance(a) < 1.0) a = vec3(0.0);
         if (RGBToLuminance(b) < 1.0) b = vec3(0.0);
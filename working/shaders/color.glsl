@@ -4,11 +4,7 @@
 
 #include "engine_data.glsl"
 
-layout(location = 0) in vec3 iPosition;
-layout(location = 1) in vec3 iNormal;
-layout(location = 2) in vec2 iTexCoord;
-
-layout(location = 12) in mat4 uTransform;
+#include "standard_vertex.glsl"
 
 void main(void) {
     gl_Position = gProjection * gView * uTransform * vec4(iPosition, 1.0);
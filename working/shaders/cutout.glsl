@@ -1,20 +1,17 @@
 #inject
 
 #pragma RVO_NO_BACKFACE_CULL
+#pragma RVO_NO_DEPTH_PREPASS
 
 #ifdef RVO_VERT
 
 #include "engine_data.glsl"
 
-layout(location = 0) in vec3 iPosition;
-layout(location = 1) in vec3 iNormal;
-layout(location = 2) in vec2 iTexCoord;
+#include "standard_vertex.glsl"
 
 out vec2 vTexCoord;
 out vec3 vNormal;
 
-layout(location = 12) in mat4 uTransform;
-
 void main(void) {
     vec4 worldSpace = uTransform * vec4(iPosition, 1.0);
     worldSpace.x += sin(gTime + worldSpace.x) * 0.1;
@@ -23,7 +20,7 @@ void main(void) {
 
     gl_Position = gProjection * gView * worldSpace;
     vTexCoord = iTexCoord;
-    vNormal = mat3(uTransform) * iNormal;
+    vNormal = mat3(uTransform) * rvo_vertex_normal();
 }
 
 #endif
@@ -0,0 +1,24 @@
+#inject
+
+#ifdef RVO_VERT
+
+#include "engine_data.glsl"
+
+// Only the position stream is bound, see `rvo::Mesh::bind_depth`
+layout(location = 0) in vec3 iPosition;
+
+layout(location = 12) in mat4 uTransform;
+
+invariant gl_Position;
+
+void main(void) {
+    gl_Position = gProjection * gView * uTransform * vec4(iPosition, 1.0);
+}
+
+#endif
+
+#ifdef RVO_FRAG
+
+void main(void) {}
+
+#endif
\ No newline at end of file
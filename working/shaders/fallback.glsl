@@ -0,0 +1,32 @@
+#inject
+
+// Drawn in place of a material whose shader is still compiling, see `rvo::Renderer::render_scene`
+
+#ifdef RVO_VERT
+
+#include "engine_data.glsl"
+
+#include "standard_vertex.glsl"
+
+out vec3 vNormal;
+
+void main(void) {
+    gl_Position = gProjection * gView * uTransform * vec4(iPosition, 1.0);
+    vNormal = transpose(inverse(mat3(uTransform))) * rvo_vertex_normal();
+}
+
+#endif
+
+#ifdef RVO_FRAG
+
+in vec3 vNormal;
+
+layout (location = 0) out vec4 oColor;
+layout (location = 1) out vec4 oNormal;
+
+void main(void) {
+    oColor = vec4(0.5, 0.5, 0.5, 1.0);
+    oNormal = vec4(normalize(vNormal) * 0.5 + 0.5, 1.0);
+}
+
+#endif
\ No newline at end of file
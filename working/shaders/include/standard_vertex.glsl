@@ -0,0 +1,20 @@
+// Vertex layout produced by `rvo::Mesh`, positions may be quantized but that is folded into uTransform
+layout(location = 0) in vec3 iPosition;
+layout(location = 1) in vec2 iNormal; // Octahedral encoded
+layout(location = 2) in vec2 iTexCoord;
+
+layout(location = 12) in mat4 uTransform;
+
+// Must match the depth prepass exactly, see depth.glsl
+invariant gl_Position;
+
+vec3 rvo_oct_decode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
+
+vec3 rvo_vertex_normal() {
+    return rvo_oct_decode(iNormal);
+}
\ No newline at end of file
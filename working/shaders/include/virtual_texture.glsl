@@ -0,0 +1,50 @@
+// Sampling side of VirtualTextureSystem, see source/rvo_virtual_texture.hpp
+// These must match kFeedbackScale, kVirtualPageSize and kVirtualPageBorder
+#define RVO_VT_FEEDBACK_SCALE 8
+#define RVO_VT_PAGE_SIZE 128.0
+#define RVO_VT_PAGE_BORDER 4.0
+#define RVO_VT_TILE_SIZE (RVO_VT_PAGE_SIZE + RVO_VT_PAGE_BORDER * 2.0)
+
+layout (binding = 1) uniform usampler2D tVirtualPageTable;
+layout (binding = 2) uniform sampler2D tVirtualAtlas;
+layout (r32ui, binding = 0) uniform writeonly uimage2D iVirtualFeedback;
+
+uniform int uVirtualPages;
+uniform int uVirtualLevels;
+uniform int uVirtualAtlasPages;
+uniform int uVirtualId;
+uniform int uVirtualFeedbackOffset;
+
+// The virtual texture repeats outside of 0..1
+vec4 rvo_virtual_texture(vec2 uv) {
+    vec2 texels = uv * float(uVirtualPages) * RVO_VT_PAGE_SIZE;
+    vec2 dx = dFdx(texels);
+    vec2 dy = dFdy(texels);
+    float lod = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1e-8));
+    int wanted = clamp(int(floor(lod)), 0, uVirtualLevels - 1);
+
+    uv = fract(uv);
+
+    // One pixel per block reports the page it wants, packed like VirtualTexture::make_page
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 cell = pixel % RVO_VT_FEEDBACK_SCALE;
+    if (cell.x + cell.y * RVO_VT_FEEDBACK_SCALE == uVirtualFeedbackOffset) {
+        int pages = max(uVirtualPages >> wanted, 1);
+        uvec2 page = uvec2(min(ivec2(uv * float(pages)), ivec2(pages - 1)));
+        imageStore(iVirtualFeedback, pixel / RVO_VT_FEEDBACK_SCALE, uvec4(page.x | page.y << 11 | uint(wanted) << 22 | uint(uVirtualId) << 26 | 1u << 31));
+    }
+
+    // Finest resident page at or above the wanted level, the last level is always resident
+    int level = wanted;
+    uvec4 entry = uvec4(0);
+
+    for (; level < uVirtualLevels; ++level) {
+        int pages = max(uVirtualPages >> level, 1);
+        entry = texelFetch(tVirtualPageTable, min(ivec2(uv * float(pages)), ivec2(pages - 1)), level);
+        if (entry.a != 0u) break;
+    }
+
+    vec2 inPage = fract(uv * float(max(uVirtualPages >> level, 1)));
+    vec2 atlasTexel = vec2(entry.xy) * RVO_VT_TILE_SIZE + RVO_VT_PAGE_BORDER + inPage * RVO_VT_PAGE_SIZE;
+    return textureLod(tVirtualAtlas, atlasTexel / (float(uVirtualAtlasPages) * RVO_VT_TILE_SIZE), 0.0);
+}
\ No newline at end of file
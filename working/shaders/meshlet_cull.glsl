@@ -0,0 +1,92 @@
+#inject
+
+#pragma RVO_COMPUTE
+
+#ifdef RVO_COMP
+
+// One workgroup per meshlet, invocation 0 tests the bounds and the rest copy one triangle each
+layout(local_size_x = 128) in;
+
+// Matches `rvo::Meshlet`
+struct Meshlet {
+    vec4 sphere;
+    vec4 cone;
+    uint firstIndex;
+    uint triangleCount;
+    uint padding[2];
+};
+
+// Matches `rvo::DrawElementsIndirectCommand`
+layout(std430, binding = 0) readonly buffer Meshlets { Meshlet bMeshlets[]; };
+layout(std430, binding = 1) readonly buffer SourceIndices { uint bSourceIndices[]; };
+layout(std430, binding = 2) writeonly buffer CulledIndices { uint bCulledIndices[]; };
+layout(std430, binding = 3) buffer DrawCommand {
+    uint bCount;
+    uint bInstanceCount;
+    uint bFirstIndex;
+    int bBaseVertex;
+    uint bBaseInstance;
+};
+
+uniform mat4 uModel;
+uniform vec4 uFrustum[6]; // World space, normalized, pointing inwards
+uniform vec3 uCameraPosition;
+uniform int uConeCulling;
+uniform int uIndexSize16;
+uniform int uMeshletCount;
+
+shared bool sVisible;
+shared uint sBase;
+
+uint fetch_index(uint i) {
+    if (uIndexSize16 == 0) return bSourceIndices[i];
+
+    uint word = bSourceIndices[i >> 1];
+    return (i & 1u) == 0u ? (word & 0xFFFFu) : (word >> 16);
+}
+
+void main(void) {
+    uint meshletIndex = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+    if (meshletIndex >= uint(uMeshletCount)) return;
+
+    Meshlet meshlet = bMeshlets[meshletIndex];
+
+    if (gl_LocalInvocationIndex == 0u) {
+        vec3 center = (uModel * vec4(meshlet.sphere.xyz, 1.0)).xyz;
+        float scale = max(length(uModel[0].xyz), max(length(uModel[1].xyz), length(uModel[2].xyz)));
+        float radius = meshlet.sphere.w * scale;
+
+        bool visible = true;
+
+        for (int i = 0; i < 6; ++i) {
+            if (dot(uFrustum[i].xyz, center) + uFrustum[i].w < -radius) visible = false;
+        }
+
+        if (visible && uConeCulling != 0) {
+            vec3 axis = normalize(transpose(inverse(mat3(uModel))) * meshlet.cone.xyz);
+            vec3 toCenter = center - uCameraPosition;
+
+            if (dot(toCenter, axis) >= meshlet.cone.w * length(toCenter) + radius) visible = false;
+        }
+
+        sVisible = visible;
+        if (visible) sBase = atomicAdd(bCount, meshlet.triangleCount * 3u);
+    }
+
+    barrier();
+
+    if (!sVisible) return;
+
+    uint triangle = gl_LocalInvocationIndex;
+
+    if (triangle < meshlet.triangleCount) {
+        uint src = meshlet.firstIndex + triangle * 3u;
+        uint dst = sBase + triangle * 3u;
+
+        bCulledIndices[dst + 0u] = fetch_index(src + 0u);
+        bCulledIndices[dst + 1u] = fetch_index(src + 1u);
+        bCulledIndices[dst + 2u] = fetch_index(src + 2u);
+    }
+}
+
+#endif
\ No newline at end of file
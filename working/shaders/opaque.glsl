@@ -4,19 +4,15 @@
 
 #include "engine_data.glsl"
 
-layout(location = 0) in vec3 iPosition;
-layout(location = 1) in vec3 iNormal;
-layout(location = 2) in vec2 iTexCoord;
+#include "standard_vertex.glsl"
 
 out vec2 vTexCoord;
 out vec3 vNormal;
 
-layout (location = 12) in mat4 uTransform;
-
 void main(void) {
     gl_Position = gProjection * gView * uTransform * vec4(iPosition, 1.0);
     vTexCoord = iTexCoord;
-    vNormal = transpose(inverse(mat3(uTransform))) * iNormal;
+    vNormal = transpose(inverse(mat3(uTransform))) * rvo_vertex_normal();
 }
 
 #endif
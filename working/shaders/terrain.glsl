@@ -1,29 +1,31 @@
 #inject
 
+#pragma RVO_KEYWORDS NO_TILE
+
 #ifdef RVO_VERT
 
 #include "engine_data.glsl"
 
-layout(location = 0) in vec3 iPosition;
-layout(location = 1) in vec3 iNormal;
-layout(location = 2) in vec2 iTexCoord;
+#include "standard_vertex.glsl"
 
 out vec2 vTexCoord;
 out vec3 vNormal;
 
-layout(location = 12) in mat4 uTransform;
+uniform float uTextureTiling;
 
 void main(void) {
     gl_Position = gProjection * gView * uTransform * vec4(iPosition, 1.0);
-    vTexCoord = iTexCoord * 100.0;
-    vNormal = mat3(uTransform) * iNormal;
+    vTexCoord = iTexCoord * uTextureTiling;
+    vNormal = mat3(uTransform) * rvo_vertex_normal();
 }
 
 #endif
 
 #ifdef RVO_FRAG
 
+#ifdef NO_TILE
 #include "texture_no_tile.glsl"
+#endif
 
 in vec2 vTexCoord;
 in vec3 vNormal;
@@ -34,7 +36,11 @@ layout (location = 1) out vec4 oNormal;
 layout (binding = 0) uniform sampler2D tAlbedo;
 
 void main(void) {
+#ifdef NO_TILE
     oColor = rvo_texture_no_tile(tAlbedo, vTexCoord);
+#else
+    oColor = texture(tAlbedo, vTexCoord);
+#endif
     oNormal = vec4(normalize(vNormal) * 0.5 + 0.5, 1.0);
 }
 
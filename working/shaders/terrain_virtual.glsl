@@ -0,0 +1,38 @@
+#inject
+
+#ifdef RVO_VERT
+
+#include "engine_data.glsl"
+
+#include "standard_vertex.glsl"
+
+out vec2 vTexCoord;
+out vec3 vNormal;
+
+void main(void) {
+    gl_Position = gProjection * gView * uTransform * vec4(iPosition, 1.0);
+    vTexCoord = iTexCoord;
+    vNormal = mat3(uTransform) * rvo_vertex_normal();
+}
+
+#endif
+
+#ifdef RVO_FRAG
+
+#include "virtual_texture.glsl"
+
+// Only surviving fragments write feedback
+layout (early_fragment_tests) in;
+
+in vec2 vTexCoord;
+in vec3 vNormal;
+
+layout (location = 0) out vec4 oColor;
+layout (location = 1) out vec4 oNormal;
+
+void main(void) {
+    oColor = rvo_virtual_texture(vTexCoord);
+    oNormal = vec4(normalize(vNormal) * 0.5 + 0.5, 1.0);
+}
+
+#endif
\ No newline at end of file